@@ -0,0 +1,219 @@
+// AsyncResolveBench.cpp :
+// Benchmark of CSubstAsyncResolver, resolving the fields of one template by a fake provider
+// with injected latency ( like a database lookup ), one field after another and concurrently.
+// The last run is given a timeout shorter than the latency of the slowest fields,
+// which are rendered as the placeholder then.
+//
+// The benchmark does not need MFC; to build and run it on Linux:
+//   g++ -O2 -std=c++14 -pthread -I../SubstLib AsyncResolveBench.cpp -o AsyncResolveBench
+//   ./AsyncResolveBench [latency_ms [threads]]
+//
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDE FILES
+/////////////////////////////////////////////////////////////////////////////
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "SubstAsyncResolver.h"
+#include "SubstBatchRender.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// PRIVATE SYMBOLS
+/////////////////////////////////////////////////////////////////////////////
+
+enum tagBenchFields
+{
+    IdField_Customer,
+    IdField_Balance,
+    IdField_LastOrder,
+    IdField_Rating,
+    IdField_Manager,
+    IdField_Branch,
+    IdField_Weather,
+    IdField_Count
+};
+
+typedef std::wstring tString;
+typedef CSubstAsyncResolver<wchar_t, tagBenchFields> tResolver;
+typedef CSubstRenderTemplate<wchar_t, tagBenchFields> tTemplate;
+
+static wchar_t const* const s_szPlaceholder = L"(n/a)";
+
+// The provider sleeping for the given latency; the "weather" takes four times as long
+class CSlowProvider : public ISubstAsyncValueProvider<wchar_t, tagBenchFields>
+{
+protected:
+    unsigned          m_nLatencyMs;
+    std::atomic<int>  m_nCalls;
+
+public:
+    CSlowProvider(unsigned nLatencyMs) : m_nLatencyMs(nLatencyMs), m_nCalls(0)
+    { }
+
+    int GetCalls() const
+    { return m_nCalls; }
+
+    virtual bool ResolveText(tagBenchFields key, tString &strText)
+    {
+        static wchar_t const* const texts[IdField_Count] = {
+            L"Anna Novakova", L"1 234.50 EUR", L"2026-09-30", L"AA", L"Cyril Dvorak", L"Brno", L"sunny" };
+
+        m_nCalls++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(
+            (IdField_Weather == key) ? 4 * m_nLatencyMs : m_nLatencyMs));
+        strText = texts[key];
+        return true;
+    }
+};
+
+// The source of one record, with the values resolved
+class CResolvedSource : public ISubstRecordSource<wchar_t, tagBenchFields>
+{
+protected:
+    std::vector<tResolver::tResult> const& m_results;
+
+public:
+    CResolvedSource(std::vector<tResolver::tResult> const& results) : m_results(results)
+    { }
+
+    virtual size_t GetRecordCount() const
+    { return 1; }
+
+    virtual wchar_t const* GetFieldValue(size_t, tagBenchFields id, size_t &nLength) const
+    {
+        tResolver::tResult const& result = m_results[id];
+
+        if (tResolver::eStateResolved == result.state)
+        {
+            nLength = result.strText.size();
+            return result.strText.c_str();
+        }
+        nLength = wcslen(s_szPlaceholder);
+        return s_szPlaceholder;
+    }
+};
+
+static void MakeTemplate(tTemplate &templ)
+{
+    static struct
+    {
+        wchar_t const* lpText;
+        int            nField;
+    } const parts[] = {
+        { L"Customer: ", IdField_Customer }, { L"\r\nBalance: ", IdField_Balance },
+        { L"\r\nLast order: ", IdField_LastOrder }, { L"\r\nRating: ", IdField_Rating },
+        { L"\r\nManager: ", IdField_Manager }, { L", branch ", IdField_Branch },
+        { L"\r\nWeather in the branch: ", IdField_Weather }, { L"\r\n", -1 },
+    };
+    tString strText;
+    std::vector<size_t> positions;
+
+    for (size_t ii = 0; ii < sizeof(parts) / sizeof(parts[0]); ii++)
+    {
+        strText += parts[ii].lpText;
+        positions.push_back(strText.size());
+    }
+    templ.AssignText(strText.c_str(), strText.size());
+    for (size_t ii = 0; ii < sizeof(parts) / sizeof(parts[0]); ii++)
+    {
+        if (0 <= parts[ii].nField)
+        {
+            templ.AppendSlot(positions[ii], (tagBenchFields)parts[ii].nField);
+        }
+    }
+}
+
+static double ElapsedMs(std::chrono::steady_clock::time_point tStart)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tStart).count();
+}
+
+static tString Render(tTemplate const& templ, std::vector<tResolver::tResult> const& results)
+{
+    CResolvedSource source(results);
+    tString strOutput;
+
+    templ.RenderTo(source, 0, strOutput);
+    return strOutput;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PUBLIC FUNCTIONS
+/////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char* argv[])
+{
+    unsigned const nLatencyMs = (1 < argc) ? (unsigned)atol(argv[1]) : 20;
+    size_t const nThreads = (2 < argc) ? (size_t)atol(argv[2]) : 2 * IdField_Count;
+    tagBenchFields keys[IdField_Count];
+    std::vector<tResolver::tResult> results;
+    tString strExpected, strOutput;
+    tTemplate templ;
+    int nResult = 0;
+
+    MakeTemplate(templ);
+    for (int ii = 0; ii < IdField_Count; ii++)
+    {
+        keys[ii] = (tagBenchFields)ii;
+    }
+    printf("Resolving %u fields, latency %u ms ( the slowest %u ms ), %u threads\n",
+        (unsigned)IdField_Count, nLatencyMs, 4 * nLatencyMs, (unsigned)nThreads);
+    {   // one field after another, as CSubstRenderContext does
+        CSlowProvider provider(nLatencyMs);
+        std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+
+        results.resize(IdField_Count);
+        for (int ii = 0; ii < IdField_Count; ii++)
+        {
+            results[ii].key = keys[ii];
+            results[ii].state = provider.ResolveText(keys[ii], results[ii].strText) ?
+                tResolver::eStateResolved : tResolver::eStateFailed;
+        }
+        strExpected = Render(templ, results);
+        printf("sequential          : %8.1f ms\n", ElapsedMs(tStart));
+    }
+    {
+        std::shared_ptr<CSlowProvider> spProvider = std::make_shared<CSlowProvider>(nLatencyMs);
+        {
+            CSubstWorkPool pool(nThreads);
+            tResolver resolver(pool, spProvider);
+            std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+            bool bAll;
+
+            // the concurrent run, waiting long enough
+            bAll = resolver.Resolve(keys, IdField_Count, 100 * nLatencyMs, results);
+            strOutput = Render(templ, results);
+            printf("concurrent          : %8.1f ms %s\n", ElapsedMs(tStart),
+                (bAll && (strOutput == strExpected)) ? "" : "(MISMATCH!)");
+            if (!bAll || (strOutput != strExpected))
+            {
+                nResult = 1;
+            }
+
+            // the concurrent run with the timeout shorter than the slowest field
+            tStart = std::chrono::steady_clock::now();
+            bAll = resolver.Resolve(keys, IdField_Count, 2 * nLatencyMs, results);
+            strOutput = Render(templ, results);
+            bool bOk = !bAll && (1 == resolver.GetTimedOutCount()) &&
+                (tString::npos != strOutput.find(s_szPlaceholder));
+            printf("concurrent, timeout : %8.1f ms, %u timed out %s\n", ElapsedMs(tStart),
+                (unsigned)resolver.GetTimedOutCount(), bOk ? "" : "(MISMATCH!)");
+            if (!bOk)
+            {
+                nResult = 1;
+            }
+        }
+        // the pool has finished the late field by now
+        if (2 * IdField_Count != spProvider->GetCalls())
+        {
+            nResult = 1;
+        }
+    }
+    return nResult;
+}
@@ -0,0 +1,211 @@
+// BatchRenderBench.cpp :
+// Benchmark of CSubstBatchRenderer, rendering one template with the values of many records
+// ( the "mail merge" ) on 1, 2, 4, ... threads up to the count of hardware threads,
+// with the records passed to the sink in order and out of order.
+// The output of each run is checked against the output rendered by one thread.
+//
+// The benchmark does not need MFC; to build and run it on Linux:
+//   g++ -O2 -std=c++14 -pthread -I../SubstLib BatchRenderBench.cpp -o BatchRenderBench
+//   ./BatchRenderBench [records [threads]]
+//
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDE FILES
+/////////////////////////////////////////////////////////////////////////////
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include "SubstBatchRender.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// PRIVATE SYMBOLS
+/////////////////////////////////////////////////////////////////////////////
+
+enum tagBenchFields
+{
+    IdField_Title,
+    IdField_FirstName,
+    IdField_LastName,
+    IdField_Street,
+    IdField_City,
+    IdField_Zip,
+    IdField_Product,
+    IdField_Amount,
+    IdField_Count
+};
+
+typedef CSubstRenderTemplate<wchar_t, tagBenchFields> tTemplate;
+typedef std::wstring tString;
+
+// The records kept in memory; the values of one record are stored in one string
+class CBenchRecords : public ISubstRecordSource<wchar_t, tagBenchFields>
+{
+protected:
+    struct tValue
+    {
+        size_t nStart;
+        size_t nLength;
+    };
+    std::vector<tString> m_records;
+    std::vector<tValue>  m_values;
+
+public:
+    CBenchRecords(size_t nRecords)
+    {
+        static wchar_t const* const names[] = { L"Anna", L"Bohumil", L"Cyril", L"Dagmar", L"Eliska", L"Frantisek" };
+        static wchar_t const* const cities[] = { L"Praha", L"Brno", L"Ostrava", L"Plzen", L"Liberec" };
+        wchar_t szBuf[64];
+
+        srand(7);
+        m_records.resize(nRecords);
+        m_values.resize(nRecords * IdField_Count);
+        for (size_t ii = 0; ii < nRecords; ii++)
+        {
+            tString values[IdField_Count];
+
+            values[IdField_Title] = (ii % 2) ? L"Mr." : L"Ms.";
+            values[IdField_FirstName] = names[rand() % 6];
+            values[IdField_LastName] = names[rand() % 6] + tString(L"ova");
+            swprintf(szBuf, 64, L"Street No. %u", (unsigned)(rand() % 1000));
+            values[IdField_Street] = szBuf;
+            values[IdField_City] = cities[rand() % 5];
+            swprintf(szBuf, 64, L"%05u", (unsigned)(rand() % 100000));
+            values[IdField_Zip] = szBuf;
+            // some records are much longer, to give the work stealing something to do
+            values[IdField_Product] = tString((0 == rand() % 50) ? 2000 : 20, L'x');
+            swprintf(szBuf, 64, L"%u.%02u", (unsigned)(rand() % 10000), (unsigned)(rand() % 100));
+            values[IdField_Amount] = szBuf;
+            for (size_t jj = 0; jj < IdField_Count; jj++)
+            {
+                m_values[ii * IdField_Count + jj].nStart = m_records[ii].size();
+                m_values[ii * IdField_Count + jj].nLength = values[jj].size();
+                m_records[ii] += values[jj];
+            }
+        }
+    }
+
+    virtual size_t GetRecordCount() const
+    { return m_records.size(); }
+
+    virtual wchar_t const* GetFieldValue(size_t nRecord, tagBenchFields id, size_t &nLength) const
+    {
+        tValue const& value = m_values[nRecord * IdField_Count + id];
+
+        nLength = value.nLength;
+        return m_records[nRecord].c_str() + value.nStart;
+    }
+};
+
+// The sink computing a checksum of the records, which does not depend on their order
+class CChecksumSink : public ISubstRecordSink<wchar_t>
+{
+public:
+    unsigned long long m_nSum;
+    size_t             m_nNextRecord;
+    bool               m_bInOrder;
+
+    CChecksumSink() : m_nSum(0), m_nNextRecord(0), m_bInOrder(true)
+    { }
+
+    virtual void WriteRecord(size_t nRecord, wchar_t const* lpText, size_t nLength)
+    {
+        unsigned long long nHash = 14695981039346656037ULL ^ nRecord;
+
+        for (size_t ii = 0; ii < nLength; ii++)
+        {
+            nHash = (nHash ^ (unsigned long long)lpText[ii]) * 1099511628211ULL;
+        }
+        m_nSum += nHash;
+        m_bInOrder = m_bInOrder && (nRecord == m_nNextRecord);
+        m_nNextRecord = nRecord + 1;
+    }
+};
+
+static void MakeTemplate(tTemplate &templ)
+{
+    static struct
+    {
+        wchar_t const* lpText;
+        int            nField;
+    } const parts[] = {
+        { L"Dear ", IdField_Title }, { L" ", IdField_FirstName }, { L" ", IdField_LastName },
+        { L",\r\n\r\nwe are pleased to confirm your order of ", IdField_Product },
+        { L" for the amount of ", IdField_Amount },
+        { L" EUR.\r\nThe goods will be delivered to the address\r\n\r\n", IdField_FirstName },
+        { L" ", IdField_LastName }, { L"\r\n", IdField_Street }, { L"\r\n", IdField_Zip }, { L" ", IdField_City },
+        { L"\r\n\r\nwithin five working days. Should you have any question, do not hesitate to contact us.\r\n"
+          L"\r\nYours sincerely,\r\nThe Shop\r\n", -1 },
+    };
+    tString strText;
+    std::vector<size_t> positions;
+
+    for (size_t ii = 0; ii < sizeof(parts) / sizeof(parts[0]); ii++)
+    {
+        strText += parts[ii].lpText;
+        positions.push_back(strText.size());
+    }
+    templ.AssignText(strText.c_str(), strText.size());
+    for (size_t ii = 0; ii < sizeof(parts) / sizeof(parts[0]); ii++)
+    {
+        if (0 <= parts[ii].nField)
+        {
+            templ.AppendSlot(positions[ii], (tagBenchFields)parts[ii].nField);
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PUBLIC FUNCTIONS
+/////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char* argv[])
+{
+    size_t const nRecords = (1 < argc) ? (size_t)atol(argv[1]) : 500000;
+    size_t const nHardware = (2 < argc) ? (size_t)atol(argv[2]) : std::thread::hardware_concurrency();
+    CBenchRecords records(nRecords);
+    tTemplate templ;
+    unsigned long long nExpected = 0;
+    int nResult = 0;
+
+    MakeTemplate(templ);
+    printf("Rendering %u records, up to %u threads\n", (unsigned)nRecords, (unsigned)nHardware);
+    for (size_t nThreads = 1; ; nThreads *= 2)
+    {
+        if (nThreads > nHardware)
+        {
+            nThreads = (nHardware < 1) ? 1 : nHardware;
+        }
+
+        CSubstWorkPool pool(nThreads);
+        CSubstBatchRenderer<wchar_t, tagBenchFields> renderer(pool);
+
+        for (int nOrder = eBatchOrdered; nOrder <= eBatchUnordered; nOrder++)
+        {
+            CChecksumSink sink;
+            tSubstBatchStats stats;
+
+            renderer.SetOrder((ESubstBatchOrder)nOrder);
+            renderer.Render(templ, records, sink, &stats);
+            if (0 == nExpected)
+            {
+                nExpected = sink.m_nSum;
+            }
+            bool bOk = (sink.m_nSum == nExpected) && (sink.m_bInOrder || (eBatchUnordered == nOrder));
+            printf("%2u threads, %-9s: %10.0f records/s, %8.1f MB/s, %6u chunks stolen %s\n",
+                (unsigned)nThreads, (eBatchOrdered == nOrder) ? "ordered" : "unordered",
+                stats.GetRecordsPerSecond(), stats.GetBytesPerSecond() / 1e6, (unsigned)stats.nStolen,
+                bOk ? "" : "(MISMATCH!)");
+            if (!bOk)
+            {
+                nResult = 1;
+            }
+        }
+        if (nThreads >= nHardware)
+        {
+            break;
+        }
+    }
+    return nResult;
+}
@@ -0,0 +1,238 @@
+// FieldIndexBench.cpp :
+// Benchmark of CSubstFieldIndex queries against the linear FirstThat/LastThat scans,
+// as used originally by CSubstPhysData::FindPhysInfo... methods and PhysPos2LogPos,
+// and of CSubstFieldIndex::ShiftFrom against the original loop of MoveAllInfoIfPhysGreaterEq.
+// It reports as well the memory taken per field by the table, which keeps the field ids too,
+// against the former lists of CLogInfo and CPhysInfo objects kept beside the table.
+//
+// The benchmark does not need MFC; to build and run it on Linux:
+//   g++ -O2 -std=c++14 -I../SubstLib FieldIndexBench.cpp -o FieldIndexBench
+//   ./FieldIndexBench
+//
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDE FILES
+/////////////////////////////////////////////////////////////////////////////
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+#include "SubstFieldIndex.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// PRIVATE SYMBOLS
+/////////////////////////////////////////////////////////////////////////////
+
+typedef CSubstFieldIndex::tPos tPos;
+
+// Stand-in for heap allocated CPhysInfo, with the virtual destructor like CObject has
+struct BenchPhysInfo
+{
+    tPos m_start;
+    tPos m_end;
+    BenchPhysInfo(tPos start, tPos end) : m_start(start), m_end(end) { }
+    virtual ~BenchPhysInfo() { }
+};
+
+// Stand-ins for the former CLogInfo and CPhysInfo, attached to the table by the pointer and the slot.
+// Each field had one of both, allocated separately, and pointed to by CObArray.
+struct BenchLogInfoObj
+{
+    int    m_what;
+    int    m_kind;
+    tPos   m_pos;
+    void*  m_pIndex;
+    size_t m_nSlot;
+    virtual ~BenchLogInfoObj() { }
+};
+
+struct BenchPhysInfoObj
+{
+    int    m_what;
+    tPos   m_start;
+    tPos   m_end;
+    void*  m_pIndex;
+    size_t m_nSlot;
+    virtual ~BenchPhysInfoObj() { }
+};
+
+typedef int (*tFirstThatPtrFn)(BenchPhysInfo* ptr, size_t wPar, size_t lPar);
+
+// Stand-in for CTypedPtrArrayEx enumeration
+struct BenchPhysList
+{
+    std::vector<BenchPhysInfo*> m_items;
+
+    ptrdiff_t FirstThat(tFirstThatPtrFn lpFn, size_t wPar, size_t lPar = 0) const
+    {
+        for (size_t ii = 0, isz = m_items.size(); ii < isz; ii++)
+            if ((*lpFn)(m_items[ii], wPar, lPar)) return (ptrdiff_t)ii;
+        return -1;
+    }
+    // like the original, does not stop early
+    ptrdiff_t LastThat(tFirstThatPtrFn lpFn, size_t wPar, size_t lPar = 0) const
+    {
+        ptrdiff_t result = -1;
+        for (size_t ii = 0, isz = m_items.size(); ii < isz; ii++)
+            if ((*lpFn)(m_items[ii], wPar, lPar)) result = (ptrdiff_t)ii;
+        return result;
+    }
+};
+
+static int FnPhysInfoPosLowerEq(BenchPhysInfo* phinf, size_t wParam, size_t)
+{ return (phinf->m_end <= (tPos)wParam); }
+static int FnPhysInfoPosGreaterEq(BenchPhysInfo* phinf, size_t wParam, size_t)
+{ return (phinf->m_start >= (tPos)wParam); }
+static int FnPhysInfoBetween(BenchPhysInfo* phinf, size_t wParam, size_t lParam)
+{ return (phinf->m_start >= (tPos)wParam) && (phinf->m_end <= (tPos)lParam); }
+static int FnPhysInfoPosIsIn(BenchPhysInfo* phinf, size_t wParam, size_t)
+{ return (phinf->m_start < (tPos)wParam) && ((tPos)wParam < phinf->m_end); }
+
+// The original CSubstPhysData::MoveAllInfoIfPhysGreaterEq ( without the logical list )
+static void LinearShift(BenchPhysList &list, tPos greaterOrEq, size_t by)
+{
+    for (size_t ii = 0, isz = list.m_items.size(); ii < isz; ii++)
+    {
+        if (list.m_items[ii]->m_start >= greaterOrEq)
+        {
+            list.m_items[ii]->m_start += by;
+            list.m_items[ii]->m_end += by;
+        }
+    }
+}
+
+// The original CSubstPhysData::PhysPos2LogPos
+static tPos LinearPhysPos2LogPos(BenchPhysList const &list, tPos ph)
+{
+    tPos result = ph;
+    for (size_t ii = 0, isz = list.m_items.size(); ii < isz; ii++)
+    {
+        if (list.m_items[ii]->m_end <= ph)
+            result -= (list.m_items[ii]->m_end - list.m_items[ii]->m_start);
+    }
+    return result;
+}
+
+static double NowSeconds()
+{
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+static void RunOne(size_t nFields)
+{
+    BenchPhysList list;
+    CSubstFieldIndex index;
+    std::vector<tPos> queries;
+    tPos pos = 0, lenBefore = 0;
+    size_t nQueries = (nFields <= 1000) ? 200000 : 2000;
+    size_t ii, checksumLin = 0, checksumIdx = 0;
+
+    srand(12345);
+    index.Reserve(nFields);
+    for (ii = 0; ii < nFields; ii++)
+    {   // some text followed by a field of length 4 .. 11
+        tPos start = pos + (rand() % 40);
+        tPos end = start + 4 + (rand() % 8);
+        list.m_items.push_back(new BenchPhysInfo(start, end));
+        index.Add(start - lenBefore, end - start, (CSubstFieldIndex::tStoredId)(ii % 16));
+        lenBefore += end - start;
+        pos = end;
+    }
+    for (ii = 0; ii < nQueries; ii++)
+    {
+        queries.push_back((tPos)(((double)rand() / RAND_MAX) * (pos + 1)));
+    }
+
+    double t0 = NowSeconds();
+    for (ii = 0; ii < nQueries; ii++)
+    {
+        tPos q = queries[ii];
+        checksumLin += (size_t)(list.FirstThat(FnPhysInfoPosIsIn, q) + 1);
+        checksumLin += (size_t)(list.LastThat(FnPhysInfoPosLowerEq, q) + 1);
+        checksumLin += (size_t)(list.FirstThat(FnPhysInfoPosGreaterEq, q) + 1);
+        checksumLin += (size_t)(list.FirstThat(FnPhysInfoBetween, q, q + 64) + 1);
+    }
+    double t1 = NowSeconds();
+    for (ii = 0; ii < nQueries; ii++)
+    {
+        tPos q = queries[ii];
+        checksumIdx += (size_t)(index.FindContaining(q) + 1);
+        checksumIdx += (size_t)(index.FindLastEndingAtOrBefore(q) + 1);
+        checksumIdx += (size_t)(index.FindFirstStartingAtOrAfter(q) + 1);
+        checksumIdx += (size_t)(index.FindFirstInside(q, q + 64) + 1);
+    }
+    double t2 = NowSeconds();
+
+    for (ii = 0; ii < nQueries; ii++)
+    {
+        checksumLin += LinearPhysPos2LogPos(list, queries[ii]);
+    }
+    double t3 = NowSeconds();
+    for (ii = 0; ii < nQueries; ii++)
+    {
+        checksumIdx += index.PhysPos2LogPos(queries[ii]);
+    }
+    double t4 = NowSeconds();
+
+    // insert and delete one character near the start of the text
+    size_t nShifts = (nFields <= 1000) ? 200000 : 2000;
+    for (ii = 0; ii < nShifts; ii++)
+    {
+        LinearShift(list, 0, 1);
+        LinearShift(list, 0, (size_t)-1);
+    }
+    double t5 = NowSeconds();
+    for (ii = 0; ii < nShifts; ii++)
+    {
+        index.ShiftFrom(index.LowerBoundStart(0), 1);
+        index.ShiftFrom(index.LowerBoundStart(0), -1);
+    }
+    double t6 = NowSeconds();
+    for (ii = 0; ii < nFields; ii++)
+    {
+        checksumLin += list.m_items[ii]->m_start;
+        checksumIdx += index.GetStart(ii);
+    }
+
+    double linNs = (t1 - t0) * 1e9 / (nQueries * 4);
+    double idxNs = (t2 - t1) * 1e9 / (nQueries * 4);
+    double linConvNs = (t3 - t2) * 1e9 / nQueries;
+    double idxConvNs = (t4 - t3) * 1e9 / nQueries;
+    double linShiftNs = (t5 - t4) * 1e9 / (nShifts * 2);
+    double idxShiftNs = (t6 - t5) * 1e9 / (nShifts * 2);
+    // the former layout kept 12 bytes of positions per field in the table as well; 
+    // the heap overhead of each object is not counted
+    double listBytes = (double)(sizeof(BenchLogInfoObj) + sizeof(BenchPhysInfoObj) + 2 * sizeof(void*) 
+        + 3 * sizeof(CSubstFieldIndex::tStoredPos));
+    double idxBytes = (double)index.GetAllocatedSize() / nFields;
+    printf("%8zu fields: find      linear %12.1f ns, index %8.1f ns, speedup %9.1fx\n",
+        nFields, linNs, idxNs, linNs / idxNs);
+    printf("%8zu fields: phys2log  linear %12.1f ns, index %8.1f ns, speedup %9.1fx\n",
+        nFields, linConvNs, idxConvNs, linConvNs / idxConvNs);
+    printf("%8zu fields: shift     linear %12.1f ns, index %8.1f ns, speedup %9.1fx %s\n",
+        nFields, linShiftNs, idxShiftNs, linShiftNs / idxShiftNs, (checksumLin == checksumIdx) ? "" : "(MISMATCH!)");
+    printf("%8zu fields: memory    lists  %10.1f B/field, table %6.1f B/field\n",
+        nFields, listBytes, idxBytes);
+
+    for (ii = 0; ii < list.m_items.size(); ii++)
+    {
+        delete list.m_items[ii];
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PUBLIC FUNCTIONS
+/////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+    size_t const sizes[] = { 10, 1000, 100000 };
+
+    printf("FindPhysInfoPosIsIn / Before / After / Between queries, PhysPos2LogPos, shift of fields, and memory\n");
+    for (size_t ii = 0; ii < sizeof(sizes) / sizeof(sizes[0]); ii++)
+    {
+        RunOne(sizes[ii]);
+    }
+    return 0;
+}
@@ -0,0 +1,120 @@
+// PieceTableBench.cpp :
+// Benchmark of CSubstPieceTable edits against the original way of editing the text
+// by CSubstPhysData::InsertText and DeleteAllBetween ( copy the whole string, modify the copy,
+// assign it back ), and against the in-place edit of contiguous string.
+//
+// The benchmark does not need MFC; to build and run it on Linux:
+//   g++ -O2 -std=c++14 -I../SubstLib PieceTableBench.cpp -o PieceTableBench
+//   ./PieceTableBench
+//
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDE FILES
+/////////////////////////////////////////////////////////////////////////////
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "SubstPieceTable.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// PRIVATE SYMBOLS
+/////////////////////////////////////////////////////////////////////////////
+
+typedef CSubstPieceTable<wchar_t> tPieceTable;
+typedef tPieceTable::tString tString;
+
+struct BenchEdit
+{
+    size_t m_pos;
+    bool   m_bInsert;
+};
+
+static double NowSeconds()
+{
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+static void RunOne(size_t nLength)
+{
+    std::vector<BenchEdit> edits;
+    tString strText(nLength, L'a');
+    tString strCopied(strText), strInPlace(strText);
+    tPieceTable table;
+    wchar_t const szTyped[] = L"x";
+    size_t ii, nEdits = (nLength <= 100000) ? 20000 : 2000;
+    size_t nCurrent = nLength;
+
+    srand(12345);
+    for (ii = 0; ii < nLength; ii++)
+    {
+        strText[ii] = (wchar_t)(L'a' + (rand() % 26));
+    }
+    strCopied = strInPlace = strText;
+    table.Assign(strText.c_str(), strText.length());
+
+    // typing: mostly inserts, some deletes, in the first half of the text
+    for (ii = 0; ii < nEdits; ii++)
+    {
+        BenchEdit edit;
+        edit.m_bInsert = (0 != (rand() % 4));
+        edit.m_pos = (size_t)(((double)rand() / RAND_MAX) * (nCurrent / 2));
+        nCurrent += edit.m_bInsert ? 1 : -1;
+        edits.push_back(edit);
+    }
+
+    double t0 = NowSeconds();
+    for (ii = 0; ii < nEdits; ii++)
+    {   // as the original InsertText: a copy, insertion into the copy, assignment back
+        tString strNew(strCopied);
+        if (edits[ii].m_bInsert)
+            strNew.insert(edits[ii].m_pos, szTyped);
+        else
+            strNew.erase(edits[ii].m_pos, 1);
+        strCopied = strNew;
+    }
+    double t1 = NowSeconds();
+    for (ii = 0; ii < nEdits; ii++)
+    {
+        if (edits[ii].m_bInsert)
+            strInPlace.insert(edits[ii].m_pos, szTyped);
+        else
+            strInPlace.erase(edits[ii].m_pos, 1);
+    }
+    double t2 = NowSeconds();
+    for (ii = 0; ii < nEdits; ii++)
+    {
+        if (edits[ii].m_bInsert)
+            table.Insert(edits[ii].m_pos, szTyped, 1);
+        else
+            table.Delete(edits[ii].m_pos, 1);
+    }
+    double t3 = NowSeconds();
+    bool bMatch = (strInPlace == table.GetString()) && (strCopied == strInPlace);
+    double t4 = NowSeconds();
+
+    printf("%9zu chars: edit  copied %10.1f ns, in place %10.1f ns, piece table %7.1f ns, speedup %8.1fx / %6.1fx %s\n",
+        nLength,
+        (t1 - t0) * 1e9 / nEdits, (t2 - t1) * 1e9 / nEdits, (t3 - t2) * 1e9 / nEdits,
+        (t1 - t0) / (t3 - t2), (t2 - t1) / (t3 - t2), bMatch ? "" : "(MISMATCH!)");
+    printf("%9zu chars: flatten of %zu pieces %10.1f us\n",
+        nLength, table.GetPieceCount(), (t4 - t3) * 1e6);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PUBLIC FUNCTIONS
+/////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+    size_t const sizes[] = { 1000, 100000, 4000000 };
+
+    printf("Single-character edits of the text\n");
+    for (size_t ii = 0; ii < sizeof(sizes) / sizeof(sizes[0]); ii++)
+    {
+        RunOne(sizes[ii]);
+    }
+    return 0;
+}
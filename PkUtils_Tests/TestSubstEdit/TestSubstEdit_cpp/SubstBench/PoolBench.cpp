@@ -0,0 +1,145 @@
+// PoolBench.cpp :
+// Benchmark of the ownership policies of CPkTypedPtrArray, loading and clearing a list of fields:
+// each field allocated by global new and deleted one by one ( CPkDeleteOwnership ),
+// allocated from the typed pool ( CPkPoolOwnership ), or from the arena released in bulk ( CPkArenaOwnership ).
+//
+// The benchmark does not need MFC; to build and run it on Linux:
+//   g++ -O2 -std=c++14 -pthread -I../SubstLib PoolBench.cpp -o PoolBench
+//   ./PoolBench
+//
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDE FILES
+/////////////////////////////////////////////////////////////////////////////
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+#include "PkObjectPool.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// PRIVATE SYMBOLS
+/////////////////////////////////////////////////////////////////////////////
+
+// Stands for CLogInfo / CPhysInfo: a polymorphic object with the field id and position
+class CBenchField
+{
+public:
+    int    m_what;
+    size_t m_start;
+    size_t m_end;
+
+    CBenchField(int what, size_t start) : m_what(what), m_start(start), m_end(start)
+    { }
+    virtual ~CBenchField()
+    { }
+};
+
+// The same, with the pooled operator new and delete as declared by DECLARE_PK_POOLED_NEW
+class CBenchPooledField : public CBenchField
+{
+public:
+    CBenchPooledField(int what, size_t start) : CBenchField(what, start)
+    { }
+
+    void* operator new(size_t nSize)
+    { return CPkTypedPool<CBenchPooledField>::Allocate(nSize); }
+    void operator delete(void* p, size_t nSize)
+    { CPkTypedPool<CBenchPooledField>::Free(p, nSize); }
+};
+
+typedef std::vector<CBenchField*> tList;
+
+static double NowSeconds()
+{
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+static size_t Checksum(tList const &list)
+{
+    size_t result = 0;
+    for (size_t ii = 0; ii < list.size(); ii++)
+    {
+        result += list[ii]->m_start + (size_t)list[ii]->m_what;
+    }
+    return result;
+}
+
+static void RunOne(size_t nFields)
+{
+    int const nRounds = (nFields <= 1000) ? 2000 : ((nFields <= 100000) ? 20 : 4);
+    double tLoad[3] = { 0, 0, 0 }, tClear[3] = { 0, 0, 0 };
+    size_t sums[3] = { 0, 0, 0 };
+    tList list;
+
+    list.reserve(nFields);
+    for (int round = 0; round < nRounds; round++)
+    {
+        double t0, t1, t2;
+        size_t ii;
+
+        // per-object new and delete
+        t0 = NowSeconds();
+        for (ii = 0; ii < nFields; ii++)
+            list.push_back(new CBenchField((int)(ii % 7), 3 * ii));
+        t1 = NowSeconds();
+        sums[0] += Checksum(list);
+        t2 = NowSeconds();
+        for (ii = 0; ii < nFields; ii++)
+            delete list[ii];
+        list.clear();
+        tLoad[0] += t1 - t0;
+        tClear[0] += NowSeconds() - t2;
+
+        // the typed pool; the pool memory is returned when the list is emptied
+        t0 = NowSeconds();
+        for (ii = 0; ii < nFields; ii++)
+            list.push_back(new CBenchPooledField((int)(ii % 7), 3 * ii));
+        t1 = NowSeconds();
+        sums[1] += Checksum(list);
+        t2 = NowSeconds();
+        for (ii = 0; ii < nFields; ii++)
+            delete list[ii];
+        list.clear();
+        CPkTypedPool<CBenchPooledField>::ReleaseIfUnused();
+        tLoad[1] += t1 - t0;
+        tClear[1] += NowSeconds() - t2;
+
+        // the arena; objects are destroyed, and the memory released at once
+        CPkArena arena;
+        t0 = NowSeconds();
+        for (ii = 0; ii < nFields; ii++)
+            list.push_back(new (arena.Allocate(sizeof(CBenchField))) CBenchField((int)(ii % 7), 3 * ii));
+        t1 = NowSeconds();
+        sums[2] += Checksum(list);
+        t2 = NowSeconds();
+        for (ii = 0; ii < nFields; ii++)
+            list[ii]->~CBenchField();
+        list.clear();
+        arena.Reset();
+        tLoad[2] += t1 - t0;
+        tClear[2] += NowSeconds() - t2;
+    }
+
+    printf("%8zu fields: load  new %8.1f ns, pool %6.1f ns, arena %6.1f ns per field\n",
+        nFields, tLoad[0] * 1e9 / nRounds / nFields, tLoad[1] * 1e9 / nRounds / nFields, tLoad[2] * 1e9 / nRounds / nFields);
+    printf("%8zu fields: clear new %8.1f ns, pool %6.1f ns, arena %6.1f ns per field %s\n",
+        nFields, tClear[0] * 1e9 / nRounds / nFields, tClear[1] * 1e9 / nRounds / nFields, tClear[2] * 1e9 / nRounds / nFields,
+        ((sums[0] == sums[1]) && (sums[1] == sums[2])) ? "" : "(MISMATCH!)");
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PUBLIC FUNCTIONS
+/////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+    size_t const sizes[] = { 1000, 100000, 1000000 };
+
+    printf("Loading and clearing the list of fields\n");
+    for (size_t ii = 0; ii < sizeof(sizes) / sizeof(sizes[0]); ii++)
+    {
+        RunOne(sizes[ii]);
+    }
+    return 0;
+}
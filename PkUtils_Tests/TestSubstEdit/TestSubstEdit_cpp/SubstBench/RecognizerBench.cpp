@@ -0,0 +1,196 @@
+// RecognizerBench.cpp :
+// Benchmark of the recognition of field texts in the plain text, as done by CSubstLogData::AssignPlainText:
+// the original comparison of every map entry at every position, CSubstRecognizer without the prefilter,
+// and CSubstRecognizer skipping the text by CSubstCharScanner; for both widths of characters.
+//
+// The benchmark does not need MFC; to build and run it on Linux:
+//   g++ -O2 -std=c++14 -I../SubstLib RecognizerBench.cpp -o RecognizerBench
+//   ./RecognizerBench
+// Add -mavx2 to use AVX2 instead of SSE2, or -DSUBST_SCANNER_NO_SIMD for the scalar scanner.
+//
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDE FILES
+/////////////////////////////////////////////////////////////////////////////
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "SubstRecognizer.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// PRIVATE SYMBOLS
+/////////////////////////////////////////////////////////////////////////////
+
+// the count of field texts in the map
+static size_t const s_nFields = 50;
+
+static double NowSeconds()
+{
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+template<class TCHARTYPE>
+static std::basic_string<TCHARTYPE> Widen(std::string const &str)
+{
+    return std::basic_string<TCHARTYPE>(str.begin(), str.end());
+}
+
+template<class TCHARTYPE>
+static std::vector<std::basic_string<TCHARTYPE> > MakeMap()
+{
+    std::vector<std::basic_string<TCHARTYPE> > result;
+    char szBuf[32];
+
+    for (size_t ii = 0; ii < s_nFields; ii++)
+    {
+        sprintf(szBuf, "<Field%u>", (unsigned)ii);
+        result.push_back(Widen<TCHARTYPE>(szBuf));
+    }
+    return result;
+}
+
+// The text of nLength characters, with one field text per nSpacing characters on average
+template<class TCHARTYPE>
+static std::basic_string<TCHARTYPE> MakeText(size_t nLength, size_t nSpacing)
+{
+    static char const szWords[] = "lorem ipsum dolor sit amet, consectetur adipiscing elit. ";
+    std::basic_string<TCHARTYPE> result;
+    char szBuf[32];
+
+    srand(11);
+    result.reserve(nLength + 32);
+    while (result.size() < nLength)
+    {
+        if (0 == (size_t)rand() % nSpacing)
+        {
+            sprintf(szBuf, "<Field%u>", (unsigned)(rand() % s_nFields));
+            result += Widen<TCHARTYPE>(szBuf);
+        }
+        else
+        {
+            result += (TCHARTYPE)szWords[result.size() % (sizeof(szWords) - 1)];
+        }
+    }
+    return result;
+}
+
+// The original algorithm, without the CString allocations: all entries compared at each position
+template<class TCHARTYPE>
+static size_t RecognizeLinear(
+    std::vector<std::basic_string<TCHARTYPE> > const &map,
+    std::basic_string<TCHARTYPE> const &text,
+    size_t &nLogLength)
+{
+    size_t nFields = 0;
+
+    nLogLength = 0;
+    for (size_t ii = 0; ii < text.size(); )
+    {
+        size_t jj;
+
+        for (jj = 0; jj < map.size(); jj++)
+        {
+            if (0 == text.compare(ii, map[jj].size(), map[jj]))
+                break;
+        }
+        if (jj < map.size())
+        {
+            ii += map[jj].size();
+            nFields++;
+        }
+        else
+        {
+            ii++;
+            nLogLength++;
+        }
+    }
+    return nFields;
+}
+
+template<class TCHARTYPE>
+static size_t RecognizeAutomaton(
+    CSubstRecognizer<TCHARTYPE> const &recognizer,
+    std::basic_string<TCHARTYPE> const &text,
+    size_t &nLogLength)
+{
+    size_t nFields = 0, nFrom, nStart, nPattern;
+
+    nLogLength = 0;
+    for (nFrom = 0; recognizer.FindNext(text.c_str(), text.size(), nFrom, nStart, nPattern); nFields++)
+    {
+        nLogLength += nStart - nFrom;
+        nFrom = nStart + recognizer.GetPatternLength(nPattern);
+    }
+    nLogLength += text.size() - nFrom;
+    return nFields;
+}
+
+template<class TCHARTYPE>
+static void RunOne(char const* szWidth, size_t nLength, size_t nSpacing)
+{
+    std::vector<std::basic_string<TCHARTYPE> > map = MakeMap<TCHARTYPE>();
+    std::basic_string<TCHARTYPE> text = MakeText<TCHARTYPE>(nLength, nSpacing);
+    CSubstRecognizer<TCHARTYPE> plain, filtered;
+    size_t nFields[3], nLogLength[3];
+    double times[3];
+    double t0;
+
+    plain.AllowPrefilter(false);
+    for (size_t ii = 0; ii < map.size(); ii++)
+    {
+        plain.AddPattern(map[ii].c_str(), map[ii].size());
+        filtered.AddPattern(map[ii].c_str(), map[ii].size());
+    }
+    plain.Build();
+    filtered.Build();
+
+    t0 = NowSeconds();
+    nFields[0] = RecognizeLinear(map, text, nLogLength[0]);
+    times[0] = NowSeconds() - t0;
+
+    t0 = NowSeconds();
+    nFields[1] = RecognizeAutomaton(plain, text, nLogLength[1]);
+    times[1] = NowSeconds() - t0;
+
+    t0 = NowSeconds();
+    nFields[2] = RecognizeAutomaton(filtered, text, nLogLength[2]);
+    times[2] = NowSeconds() - t0;
+
+    printf("%-7s %6.1f MB, field per %5u chars: linear %8.1f MB/s, automaton %8.1f MB/s, prefilter %8.1f MB/s %s\n",
+        szWidth, text.size() * sizeof(TCHARTYPE) / 1e6, (unsigned)nSpacing,
+        text.size() * sizeof(TCHARTYPE) / 1e6 / times[0],
+        text.size() * sizeof(TCHARTYPE) / 1e6 / times[1],
+        text.size() * sizeof(TCHARTYPE) / 1e6 / times[2],
+        ((nFields[0] == nFields[1]) && (nFields[1] == nFields[2]) &&
+         (nLogLength[0] == nLogLength[1]) && (nLogLength[1] == nLogLength[2])) ? "" : "(MISMATCH!)");
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PUBLIC FUNCTIONS
+/////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+    size_t const nLength = 16 * 1024 * 1024;
+    size_t const spacings[] = { 50, 1000, 100000 };
+
+#if defined(SUBST_SCANNER_AVX2)
+    printf("Recognition of %u field texts; the scanner uses AVX2\n", (unsigned)s_nFields);
+#elif defined(SUBST_SCANNER_SSE2)
+    printf("Recognition of %u field texts; the scanner uses SSE2\n", (unsigned)s_nFields);
+#else
+    printf("Recognition of %u field texts; the scanner is scalar\n", (unsigned)s_nFields);
+#endif
+    for (size_t ii = 0; ii < sizeof(spacings) / sizeof(spacings[0]); ii++)
+    {
+        RunOne<char>("char", nLength, spacings[ii]);
+        RunOne<wchar_t>("wchar_t", nLength, spacings[ii]);
+        RunOne<char16_t>("char16", nLength, spacings[ii]);
+    }
+    return 0;
+}
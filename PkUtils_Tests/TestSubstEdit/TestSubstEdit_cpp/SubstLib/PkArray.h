@@ -9,6 +9,7 @@
 /////////////////////////////////////////////////////////////////////////////
 #include "AfxTempl.h"
 #include "StdAfx.h"
+#include "PkObjectPool.h"
 
 /////////////////////////////////////////////////////////////////////////////
 // MANIFESTED CONSTANTS & MACROS
@@ -21,6 +22,35 @@
 #pragma once
 #endif // _MSC_VER > 1000
 
+/** DECLARE_PK_POOLED_NEW declares the class-level operators new and delete,
+    allocating objects of the class from CPkTypedPool<class_name>.
+    Since the class operator new hides all those of CObject, it declares the placement new 
+    and the debug new ( used by DEBUG_NEW ) as well.
+    Use it in the declaration of objects owned by an array with CPkPoolOwnership.
+    @see CPkPoolOwnership
+*/
+#ifdef _DEBUG
+#define _DECLARE_PK_POOLED_DEBUG_NEW(class_name) \
+    void* PASCAL operator new(size_t nSize, LPCSTR /*lpszFileName*/, int /*nLine*/) \
+        { return CPkTypedPool<class_name>::Allocate(nSize); } \
+    void PASCAL operator delete(void* p, LPCSTR /*lpszFileName*/, int /*nLine*/) \
+        { CPkTypedPool<class_name>::Free(p); }
+#else
+#define _DECLARE_PK_POOLED_DEBUG_NEW(class_name)
+#endif // _DEBUG
+
+#define DECLARE_PK_POOLED_NEW(class_name) \
+public: \
+    void* PASCAL operator new(size_t nSize) \
+        { return CPkTypedPool<class_name>::Allocate(nSize); } \
+    void PASCAL operator delete(void* p, size_t nSize) \
+        { CPkTypedPool<class_name>::Free(p, nSize); } \
+    void* PASCAL operator new(size_t, void* p) \
+        { return p; } \
+    void PASCAL operator delete(void*, void*) \
+        { } \
+    _DECLARE_PK_POOLED_DEBUG_NEW(class_name)
+
 /////////////////////////////////////////////////////////////////////////////
 // FUNCTIONS
 /////////////////////////////////////////////////////////////////////////////
@@ -199,6 +229,69 @@ public:
     INT_PTR FindAllThat(lpFirstThatPtrFn lpFn, CTypedPtrArray < BASE_CLASS, PTRTYPE > &output, WPARAM wPar = 0, LPARAM lPar = 0) const;
 };
 
+/** CPkDeleteOwnership is the default ownership policy of CPkTypedPtrArray; 
+    each element is deleted by its own delete, when removed from the array.
+    @see CPkTypedPtrArray
+*/
+class CPkDeleteOwnership
+{
+public:
+    template<class PTRTYPE> void Release(PTRTYPE ptr)
+    { delete ptr; }
+
+    /// Called when the array has been emptied
+    void ReleaseAll()
+    { }
+};
+
+/** CPkPoolOwnership is the ownership policy for arrays of objects allocated from CPkTypedPool<TOBJECT>,
+    i.e. of classes declaring DECLARE_PK_POOLED_NEW.
+    Deleting an element just returns its memory block to the pool free list. 
+    When the array is emptied and no other object of the pool is alive, the pool memory is released at once.
+    @see DECLARE_PK_POOLED_NEW
+*/
+template<class TOBJECT> class CPkPoolOwnership
+{
+public:
+    template<class PTRTYPE> void Release(PTRTYPE ptr)
+    { delete ptr; }
+
+    void ReleaseAll()
+    { CPkTypedPool<TOBJECT>::ReleaseIfUnused(); }
+};
+
+/** CPkArenaOwnership is the ownership policy keeping the array elements in the arena of the array.
+    The elements are created by placement new in the memory returned by Allocate.
+    Removing an element just destroys it, and the memory of all of them is released in bulk, 
+    when the array is emptied. Hence the elements must not be removed from the array
+    without deleting them ( by RemoveAt ), while the array keeps other elements.
+    Elements which are not allocated from the arena are deleted as usual.
+*/
+class CPkArenaOwnership
+{
+protected:
+    CPkArena m_arena;
+
+public:
+    void* Allocate(size_t nSize)
+    { return m_arena.Allocate(nSize); }
+
+    template<class PTRTYPE> void Release(PTRTYPE ptr)
+    {
+        if (m_arena.Owns(ptr))
+            DestroyObject(ptr);
+        else
+            delete ptr;
+    }
+
+    void ReleaseAll()
+    { m_arena.Reset(); }
+
+protected:
+    template<class TOBJECT> static void DestroyObject(TOBJECT* ptr)
+    { ptr->~TOBJECT(); }
+};
+
 /** CPkTypedPtrArray is a template derived from MFC CTypedPtrArrayEx.
     Analogically, as CTypedPtrArrayEx and CTypedPtrArray, it provides type-safe wrapper 
     for objects of class CPtrArray or CObArray.<br>
@@ -222,13 +315,19 @@ public:
     CObject* WINAPI CopyObject(CObject const *ptr);
     </pre>
     The original CTypedPtrArray::Append, CTypedPtrArray::Copy are no longer safe 
-    with this class and should not be used.
+    with this class and should not be used.<br>
+    The way the elements are deleted is given by the ownership policy TOWNERSHIP;
+    besides the default CPkDeleteOwnership, there are CPkPoolOwnership and CPkArenaOwnership.
     @see CopyObject
     @see CTypedPtrArrayEx 
+    @see CPkDeleteOwnership
 */
-template<class BASE_CLASS, class PTRTYPE>
+template<class BASE_CLASS, class PTRTYPE, class TOWNERSHIP = CPkDeleteOwnership>
 class CPkTypedPtrArray : public CTypedPtrArrayEx < BASE_CLASS, PTRTYPE >
 {
+protected:
+    TOWNERSHIP m_ownership;
+
 public:
     // Public 'using' declaration to make accessible both overloded FindAllThat 
     // ( the one defined here, and the other defined in CTypedPtrArrayEx ).
@@ -248,7 +347,11 @@ public:
 #endif
 
     /// assignment operator
-    CPkTypedPtrArray <BASE_CLASS, PTRTYPE >& operator = (CTypedPtrArray < BASE_CLASS, PTRTYPE > const &what );
+    CPkTypedPtrArray <BASE_CLASS, PTRTYPE, TOWNERSHIP >& operator = (CTypedPtrArray < BASE_CLASS, PTRTYPE > const &what );
+
+    /// Returns the ownership policy object
+    TOWNERSHIP& GetOwnership()
+    { return m_ownership; }
 
     /** Deletes the elements starting at the given index and sets their pointers to zero. 
         The pointers are just set to zero, are not removed from the array.
@@ -276,7 +379,7 @@ public:
 
     /// Finds all the pointers complying the condition (*lpFn), where  lpFn is a callback function provided by user.
     INT_PTR FindAllThat(typename CTypedPtrArrayEx<BASE_CLASS, PTRTYPE>::lpFirstThatPtrFn lpFn,
-        CPkTypedPtrArray < BASE_CLASS, PTRTYPE > &output, WPARAM wPar = 0, LPARAM lPar = 0) const;
+        CPkTypedPtrArray < BASE_CLASS, PTRTYPE, TOWNERSHIP > &output, WPARAM wPar = 0, LPARAM lPar = 0) const;
 
     /**
        Overloaded method of the predecesor. This method adds the contents of another array 
@@ -664,21 +767,21 @@ INT_PTR CTypedPtrArrayEx <BASE_CLASS, PTRTYPE>::FindAllThat(lpFirstThatPtrFn lpF
 /////////////////////////////////////////////////////////////////////////////
 //  CPkTypedPtrArray implementation
 
-template<class BASE_CLASS, class PTRTYPE>
-CPkTypedPtrArray <BASE_CLASS, PTRTYPE>::CPkTypedPtrArray()
+template<class BASE_CLASS, class PTRTYPE, class TOWNERSHIP>
+CPkTypedPtrArray <BASE_CLASS, PTRTYPE, TOWNERSHIP>::CPkTypedPtrArray()
 {
 }
 
-template<class BASE_CLASS, class PTRTYPE>
-CPkTypedPtrArray <BASE_CLASS, PTRTYPE>::~CPkTypedPtrArray()
+template<class BASE_CLASS, class PTRTYPE, class TOWNERSHIP>
+CPkTypedPtrArray <BASE_CLASS, PTRTYPE, TOWNERSHIP>::~CPkTypedPtrArray()
 {
     DeleteAndRemoveAll();
 }
 
 #pragma warning ( disable : 4706) // get rid of C4706: assignment within conditional expression
 #ifdef _DEBUG
-template<class BASE_CLASS, class PTRTYPE>
-void CPkTypedPtrArray <BASE_CLASS, PTRTYPE>::AssertValid() const
+template<class BASE_CLASS, class PTRTYPE, class TOWNERSHIP>
+void CPkTypedPtrArray <BASE_CLASS, PTRTYPE, TOWNERSHIP>::AssertValid() const
 {
     INT_PTR ii, isz;
     PTRTYPE ptr;
@@ -695,8 +798,8 @@ void CPkTypedPtrArray <BASE_CLASS, PTRTYPE>::AssertValid() const
 #endif // _DEBUG
 #pragma warning ( default : 4706)
 
-template<class BASE_CLASS, class PTRTYPE>
-CPkTypedPtrArray <BASE_CLASS, PTRTYPE >& CPkTypedPtrArray <BASE_CLASS, PTRTYPE>::operator = (CTypedPtrArray < BASE_CLASS, PTRTYPE > const &what )
+template<class BASE_CLASS, class PTRTYPE, class TOWNERSHIP>
+CPkTypedPtrArray <BASE_CLASS, PTRTYPE, TOWNERSHIP >& CPkTypedPtrArray <BASE_CLASS, PTRTYPE, TOWNERSHIP>::operator = (CTypedPtrArray < BASE_CLASS, PTRTYPE > const &what )
 {
     this->DeleteAndRemoveAll();
     this->Copy(what);
@@ -704,8 +807,8 @@ CPkTypedPtrArray <BASE_CLASS, PTRTYPE >& CPkTypedPtrArray <BASE_CLASS, PTRTYPE>:
 }
 
 #pragma warning ( disable : 4706) // get rid of C4706: assignment within conditional expression
-template<class BASE_CLASS, class PTRTYPE>
-void CPkTypedPtrArray <BASE_CLASS, PTRTYPE>::DeleteAt(INT_PTR nIndex, INT_PTR nCount)
+template<class BASE_CLASS, class PTRTYPE, class TOWNERSHIP>
+void CPkTypedPtrArray <BASE_CLASS, PTRTYPE, TOWNERSHIP>::DeleteAt(INT_PTR nIndex, INT_PTR nCount)
 {
     PTRTYPE ptr;
 
@@ -720,27 +823,31 @@ void CPkTypedPtrArray <BASE_CLASS, PTRTYPE>::DeleteAt(INT_PTR nIndex, INT_PTR nC
         if (ptr = (*this)[ii])
         {
             (*this)[ii] = NULL;
-            delete ptr;
+            m_ownership.Release(ptr);
         }
     }
 };
 
-template<class BASE_CLASS, class PTRTYPE>
-void CPkTypedPtrArray <BASE_CLASS, PTRTYPE>::DeleteAndRemoveAt(INT_PTR nIndex, INT_PTR nCount)
+template<class BASE_CLASS, class PTRTYPE, class TOWNERSHIP>
+void CPkTypedPtrArray <BASE_CLASS, PTRTYPE, TOWNERSHIP>::DeleteAndRemoveAt(INT_PTR nIndex, INT_PTR nCount)
 {
     DeleteAt(nIndex, nCount);
     BASE_CLASS::RemoveAt(nIndex, nCount);
+    if (0 == BASE_CLASS::GetSize())
+    {
+        m_ownership.ReleaseAll();
+    }
 };
 
-template<class BASE_CLASS, class PTRTYPE>
-void CPkTypedPtrArray <BASE_CLASS, PTRTYPE>::DeleteAndRemoveAll()
+template<class BASE_CLASS, class PTRTYPE, class TOWNERSHIP>
+void CPkTypedPtrArray <BASE_CLASS, PTRTYPE, TOWNERSHIP>::DeleteAndRemoveAll()
 {
     DeleteAndRemoveAt(0, BASE_CLASS::GetSize());
 }
 
-template<class BASE_CLASS, class PTRTYPE>
-INT_PTR CPkTypedPtrArray <BASE_CLASS, PTRTYPE>::FindAllThat(typename CTypedPtrArrayEx<BASE_CLASS, PTRTYPE>::lpFirstThatPtrFn lpFn,
-    CPkTypedPtrArray < BASE_CLASS, PTRTYPE > &output, WPARAM wPar, LPARAM lPar) const
+template<class BASE_CLASS, class PTRTYPE, class TOWNERSHIP>
+INT_PTR CPkTypedPtrArray <BASE_CLASS, PTRTYPE, TOWNERSHIP>::FindAllThat(typename CTypedPtrArrayEx<BASE_CLASS, PTRTYPE>::lpFirstThatPtrFn lpFn,
+    CPkTypedPtrArray < BASE_CLASS, PTRTYPE, TOWNERSHIP > &output, WPARAM wPar, LPARAM lPar) const
 {
     CTypedPtrArray < BASE_CLASS, PTRTYPE > temp;
 
@@ -750,8 +857,8 @@ INT_PTR CPkTypedPtrArray <BASE_CLASS, PTRTYPE>::FindAllThat(typename CTypedPtrAr
     return output.GetSize();
 }
 
-template<class BASE_CLASS, class PTRTYPE>
-INT_PTR CPkTypedPtrArray <BASE_CLASS, PTRTYPE>::Append(const CTypedPtrArray<BASE_CLASS, PTRTYPE>& src)
+template<class BASE_CLASS, class PTRTYPE, class TOWNERSHIP>
+INT_PTR CPkTypedPtrArray <BASE_CLASS, PTRTYPE, TOWNERSHIP>::Append(const CTypedPtrArray<BASE_CLASS, PTRTYPE>& src)
 {
     ASSERT_VALID(this);
     ASSERT(this != &src);   // cannot append and copy copy to itself
@@ -767,8 +874,8 @@ INT_PTR CPkTypedPtrArray <BASE_CLASS, PTRTYPE>::Append(const CTypedPtrArray<BASE
     return nOldSize;
 }
 
-template<class BASE_CLASS, class PTRTYPE>
-void CPkTypedPtrArray <BASE_CLASS, PTRTYPE>::Copy(const CTypedPtrArray<BASE_CLASS, PTRTYPE>& src)
+template<class BASE_CLASS, class PTRTYPE, class TOWNERSHIP>
+void CPkTypedPtrArray <BASE_CLASS, PTRTYPE, TOWNERSHIP>::Copy(const CTypedPtrArray<BASE_CLASS, PTRTYPE>& src)
 {
     ASSERT_VALID(this);
     ASSERT(this != &src);   // cannot append and copy copy to itself
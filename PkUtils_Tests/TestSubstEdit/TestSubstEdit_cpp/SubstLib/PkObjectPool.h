@@ -0,0 +1,352 @@
+/////////////////////////////////////////////////////////////////////////////
+// PkObjectPool.h : interface of the classes
+//                  CPkFixedPool, CPkTypedPool, CPkArena
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef __PKOBJECTPOOL_H__
+#define __PKOBJECTPOOL_H__
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDE FILES
+/////////////////////////////////////////////////////////////////////////////
+// Note: This header intentionally does not depend on MFC,
+// so it can be used ( and benchmarked ) outside of the MFC build as well.
+#include <stddef.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <mutex>
+#include <new>
+#include <vector>
+
+/////////////////////////////////////////////////////////////////////////////
+// MANIFESTED CONSTANTS & MACROS
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef ASSERT
+#define ASSERT(f)  assert(f)
+#define __PKOBJECTPOOL_OWN_ASSERT__
+#endif
+
+/////////////////////////////////////////////////////////////////////////////
+// CLASES
+/////////////////////////////////////////////////////////////////////////////
+
+/** CPkFixedPool allocates memory blocks of one fixed size.
+    Blocks are carved from chunks allocated at once ( each chunk twice as big as the previous one,
+    up to a limit ), and freed blocks are kept in the free list for the next allocation.
+    Hence both allocation and deallocation are O(1) and do not call the heap,
+    except for the new chunk now and then.
+    The pool is not thread-safe; the pool shared by threads is guarded by CPkTypedPool.
+*/
+class CPkFixedPool
+{
+protected:
+    struct tFreeBlock
+    {
+        tFreeBlock* m_pNext;
+    };
+
+    enum { tAlign = 16, tFirstChunkBlocks = 64, tMaxChunkBlocks = 4096 };
+
+    size_t m_nBlockSize;
+    size_t m_nNextChunkBlocks;
+    std::vector<char*> m_chunks;
+    tFreeBlock* m_pFree;
+    // the count of blocks allocated and not freed yet
+    size_t m_nLive;
+
+public:
+    explicit CPkFixedPool(size_t nBlockSize)
+        : m_nBlockSize(RoundUp(nBlockSize)), m_nNextChunkBlocks(tFirstChunkBlocks), m_pFree(NULL), m_nLive(0)
+    { }
+
+    ~CPkFixedPool()
+    {   // If some blocks are still alive, the memory is rather leaked than pulled from under them
+        ReleaseIfUnused();
+    }
+
+    size_t GetBlockSize() const
+    { return m_nBlockSize; }
+    size_t GetLiveCount() const
+    { return m_nLive; }
+    size_t GetChunkCount() const
+    { return m_chunks.size(); }
+
+    void* Allocate()
+    {
+        if (NULL == m_pFree)
+        {
+            AddChunk();
+        }
+
+        tFreeBlock* pBlock = m_pFree;
+        m_pFree = pBlock->m_pNext;
+        m_nLive++;
+        return pBlock;
+    }
+
+    void Free(void* p)
+    {
+        if (NULL != p)
+        {
+            tFreeBlock* pBlock = static_cast<tFreeBlock*>(p);
+
+            ASSERT(0 < m_nLive);
+            pBlock->m_pNext = m_pFree;
+            m_pFree = pBlock;
+            m_nLive--;
+        }
+    }
+
+    /// Returns true if the block p has been allocated from this pool. Takes O(chunks).
+    bool Owns(void const* p) const
+    {
+        char const* lpc = static_cast<char const*>(p);
+        size_t nBlocks = tFirstChunkBlocks;
+
+        for (size_t ii = 0; ii < m_chunks.size(); ii++)
+        {
+            if ((m_chunks[ii] <= lpc) && (lpc < m_chunks[ii] + nBlocks * m_nBlockSize))
+            {
+                return true;
+            }
+            nBlocks = NextChunkBlocks(nBlocks);
+        }
+        return false;
+    }
+
+    /// If no block is in use, returns all the memory of the pool at once. Returns true on success.
+    bool ReleaseIfUnused()
+    {
+        if (0 < m_nLive)
+        {
+            return false;
+        }
+        for (size_t ii = 0; ii < m_chunks.size(); ii++)
+        {
+            free(m_chunks[ii]);
+        }
+        m_chunks.clear();
+        m_pFree = NULL;
+        m_nNextChunkBlocks = tFirstChunkBlocks;
+        return true;
+    }
+
+protected:
+    static size_t RoundUp(size_t nSize)
+    {
+        if (nSize < sizeof(tFreeBlock))
+        {
+            nSize = sizeof(tFreeBlock);
+        }
+        return (nSize + tAlign - 1) / tAlign * tAlign;
+    }
+
+    static size_t NextChunkBlocks(size_t nBlocks)
+    { return (nBlocks < tMaxChunkBlocks) ? 2 * nBlocks : nBlocks; }
+
+    void AddChunk()
+    {
+        size_t nBlocks = m_nNextChunkBlocks;
+        char* lpChunk = static_cast<char*>(malloc(nBlocks * m_nBlockSize));
+
+        if (NULL == lpChunk)
+        {
+            throw std::bad_alloc();
+        }
+        m_chunks.push_back(lpChunk);
+        m_nNextChunkBlocks = NextChunkBlocks(nBlocks);
+        // link the new blocks to the free list, so the first one is allocated first
+        for (size_t ii = nBlocks; ii > 0; ii--)
+        {
+            tFreeBlock* pBlock = reinterpret_cast<tFreeBlock*>(lpChunk + (ii - 1) * m_nBlockSize);
+            pBlock->m_pNext = m_pFree;
+            m_pFree = pBlock;
+        }
+    }
+
+private:
+    CPkFixedPool(CPkFixedPool const&);
+    CPkFixedPool& operator = (CPkFixedPool const&);
+};
+
+/** CPkTypedPool keeps one CPkFixedPool for all objects of the class TOBJECT.
+    Memory of other size ( i.e. of classes derived from TOBJECT ) is not pooled,
+    but allocated by the global operator new.
+    The pool is shared by all threads of the process, hence it is guarded by a lock,
+    like the heap of the CRT is; the objects may be created and deleted by any thread.
+*/
+template<class TOBJECT> class CPkTypedPool
+{
+protected:
+    static CPkFixedPool& Instance()
+    {
+        static CPkFixedPool pool(sizeof(TOBJECT));
+        return pool;
+    }
+
+    static std::mutex& Lock()
+    {
+        static std::mutex lock;
+        return lock;
+    }
+
+public:
+    /// Returns the count of objects allocated from the pool and not freed yet
+    static size_t GetLiveCount()
+    {
+        std::lock_guard<std::mutex> lock(Lock());
+        return Instance().GetLiveCount();
+    }
+    static size_t GetChunkCount()
+    {
+        std::lock_guard<std::mutex> lock(Lock());
+        return Instance().GetChunkCount();
+    }
+
+    static void* Allocate(size_t nSize)
+    {
+        if (sizeof(TOBJECT) != nSize)
+            return ::operator new(nSize);
+
+        std::lock_guard<std::mutex> lock(Lock());
+        return Instance().Allocate();
+    }
+
+    static void Free(void* p, size_t nSize)
+    {
+        if (sizeof(TOBJECT) == nSize)
+        {
+            std::lock_guard<std::mutex> lock(Lock());
+            Instance().Free(p);
+        }
+        else
+        {
+            ::operator delete(p);
+        }
+    }
+
+    /// Frees the memory of unknown size; takes O(chunks)
+    static void Free(void* p)
+    {
+        {
+            std::lock_guard<std::mutex> lock(Lock());
+
+            if (Instance().Owns(p))
+            {
+                Instance().Free(p);
+                return;
+            }
+        }
+        ::operator delete(p);
+    }
+
+    /// If no object of the pool is alive in any thread, returns all the memory of the pool at once
+    static bool ReleaseIfUnused()
+    {
+        std::lock_guard<std::mutex> lock(Lock());
+        return Instance().ReleaseIfUnused();
+    }
+};
+
+/** CPkArena is a bump allocator; individual allocations are never freed,
+    but all the memory is released at once by Reset.
+    Chunks grow twice with each new one, so their count is logarithmic.
+*/
+class CPkArena
+{
+protected:
+    struct tChunk
+    {
+        char*  m_pData;
+        size_t m_nSize;
+    };
+
+    enum { tAlign = 16, tFirstChunkSize = 4096, tMaxChunkSize = 1024 * 1024 };
+
+    std::vector<tChunk> m_chunks;
+    // the amount used from the last chunk
+    size_t m_nUsed;
+
+public:
+    CPkArena() : m_nUsed(0)
+    { }
+    ~CPkArena()
+    { Reset(); }
+
+    size_t GetChunkCount() const
+    { return m_chunks.size(); }
+
+    void* Allocate(size_t nSize)
+    {
+        nSize = (nSize + tAlign - 1) / tAlign * tAlign;
+        if (m_chunks.empty() || (m_chunks.back().m_nSize - m_nUsed < nSize))
+        {
+            AddChunk(nSize);
+        }
+
+        void* p = m_chunks.back().m_pData + m_nUsed;
+        m_nUsed += nSize;
+        return p;
+    }
+
+    /// Returns true if p has been allocated from this arena. Takes O(chunks).
+    bool Owns(void const* p) const
+    {
+        char const* lpc = static_cast<char const*>(p);
+
+        for (size_t ii = 0; ii < m_chunks.size(); ii++)
+        {
+            if ((m_chunks[ii].m_pData <= lpc) && (lpc < m_chunks[ii].m_pData + m_chunks[ii].m_nSize))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// Releases all the memory allocated so far
+    void Reset()
+    {
+        for (size_t ii = 0; ii < m_chunks.size(); ii++)
+        {
+            free(m_chunks[ii].m_pData);
+        }
+        m_chunks.clear();
+        m_nUsed = 0;
+    }
+
+protected:
+    void AddChunk(size_t nMinSize)
+    {
+        size_t nSize = m_chunks.empty() ? (size_t)tFirstChunkSize : 2 * m_chunks.back().m_nSize;
+        tChunk chunk;
+
+        if (nSize > tMaxChunkSize)
+        {
+            nSize = tMaxChunkSize;
+        }
+        if (nSize < nMinSize)
+        {
+            nSize = nMinSize;
+        }
+        if (NULL == (chunk.m_pData = static_cast<char*>(malloc(nSize))))
+        {
+            throw std::bad_alloc();
+        }
+        chunk.m_nSize = nSize;
+        m_chunks.push_back(chunk);
+        m_nUsed = 0;
+    }
+
+private:
+    CPkArena(CPkArena const&);
+    CPkArena& operator = (CPkArena const&);
+};
+
+#ifdef __PKOBJECTPOOL_OWN_ASSERT__
+#undef ASSERT
+#undef __PKOBJECTPOOL_OWN_ASSERT__
+#endif
+
+#endif // __PKOBJECTPOOL_H__
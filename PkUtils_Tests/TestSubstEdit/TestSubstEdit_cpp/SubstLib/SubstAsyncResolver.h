@@ -0,0 +1,223 @@
+/////////////////////////////////////////////////////////////////////////////
+// SubstAsyncResolver.h : interface ISubstAsyncValueProvider,
+//                        and the class CSubstAsyncResolver
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef __SUBSTASYNCRESOLVER_H__
+#define __SUBSTASYNCRESOLVER_H__
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDE FILES
+/////////////////////////////////////////////////////////////////////////////
+// Note: This header intentionally does not depend on MFC,
+// so it can be used ( and benchmarked ) outside of the MFC build as well.
+#include <stddef.h>
+#include <assert.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "SubstWorkPool.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// MANIFESTED CONSTANTS & MACROS
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef ASSERT
+#define ASSERT(f)  assert(f)
+#define __SUBSTASYNCRESOLVER_OWN_ASSERT__
+#endif
+
+/////////////////////////////////////////////////////////////////////////////
+// TYPES
+/////////////////////////////////////////////////////////////////////////////
+
+/** ISubstAsyncValueProvider provides the texts of values, which may take long to get,
+    like a database lookup or reading a file. CSubstAsyncResolver calls it on the threads of its pool,
+    several values at once; hence it must be thread-safe.
+    The key identifies the value; for CSubstLogData it is the descriptor of the field.
+*/
+template<class TCHARTYPE, class TKEY> struct ISubstAsyncValueProvider
+{
+    /// Gets the text of the value; returns false if there is none
+    virtual bool ResolveText(TKEY key, std::basic_string<TCHARTYPE> &strText) = 0;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// CLASES
+/////////////////////////////////////////////////////////////////////////////
+
+/** CSubstAsyncResolver resolves the values of several keys concurrently, each of them by one task
+    of CSubstWorkPool, and waits for them at most for the given time.
+    The values not resolved in time are left pending; their tasks finish later, and their results are dropped.
+    The provider is shared by the resolver and by its tasks, so a late task keeps it alive
+    after the resolver has gone. Such a task still occupies a thread of the pool, delaying the tasks
+    of later calls; GetLateCount tells how many of them are still running, so that a caller may stop
+    using a provider which hangs. The pool should have more threads than the count of values which may
+    be late at once, or it should be dedicated to the resolver.
+*/
+template<class TCHARTYPE, class TKEY> class CSubstAsyncResolver
+{
+public:
+    typedef std::basic_string<TCHARTYPE>              tString;
+    typedef ISubstAsyncValueProvider<TCHARTYPE, TKEY> tProvider;
+
+    enum EState
+    {
+        /// not resolved in time
+        eStatePending,
+        eStateResolved,
+        /// the provider has no value, or it has thrown
+        eStateFailed,
+    };
+
+    struct tResult
+    {
+        TKEY    key;
+        EState  state;
+        tString strText;
+    };
+
+protected:
+    // The state of one Resolve call, shared with its tasks; it is released by the last of them
+    struct tBatch
+    {
+        std::mutex              lock;
+        std::condition_variable cvDone;
+        std::vector<tResult>    results;
+        size_t                  nPending;
+        // set when Resolve has returned; results of the tasks finishing later are dropped
+        bool                    bAbandoned;
+        // the late count of the resolver, outliving it
+        std::shared_ptr<std::atomic<size_t> > spLate;
+    };
+
+    CSubstWorkPool& m_pool;
+    std::shared_ptr<tProvider> m_spProvider;
+    // the count of tasks still running after their Resolve has returned; shared with them
+    std::shared_ptr<std::atomic<size_t> > m_spLate;
+    // statistics
+    size_t          m_nResolved;
+    size_t          m_nFailed;
+    size_t          m_nTimedOut;
+
+public:
+    CSubstAsyncResolver(CSubstWorkPool &pool, std::shared_ptr<tProvider> const& spProvider)
+        : m_pool(pool), m_spProvider(spProvider), m_spLate(std::make_shared<std::atomic<size_t> >(0)),
+          m_nResolved(0), m_nFailed(0), m_nTimedOut(0)
+    {
+        ASSERT(m_spProvider);
+    }
+
+    CSubstWorkPool& GetPool() const
+    { return m_pool; }
+    std::shared_ptr<tProvider> const& GetProvider() const
+    { return m_spProvider; }
+
+    /// Returns the count of tasks not finished in time by previous calls of Resolve, which are still running
+    size_t GetLateCount() const
+    { return *m_spLate; }
+
+    /// Returns the count of values resolved in time
+    size_t GetResolvedCount() const
+    { return m_nResolved; }
+    /// Returns the count of values the provider has not had
+    size_t GetFailedCount() const
+    { return m_nFailed; }
+    /// Returns the count of values not resolved in time
+    size_t GetTimedOutCount() const
+    { return m_nTimedOut; }
+
+    /** Resolves the values of nCount keys concurrently, waiting at most nTimeoutMs milliseconds.
+        The keys should be distinct, the resolver does not merge them.
+        results[ii] is the result of lpKeys[ii]. Returns true if all the values have been resolved
+        ( or failed ) in time. Must not be called by a worker of the pool.
+    */
+    bool Resolve(TKEY const* lpKeys, size_t nCount, unsigned nTimeoutMs, std::vector<tResult> &results)
+    {
+        std::chrono::steady_clock::time_point const tDeadline =
+            std::chrono::steady_clock::now() + std::chrono::milliseconds(nTimeoutMs);
+        std::shared_ptr<tBatch> spBatch = std::make_shared<tBatch>();
+        bool bAll;
+
+        ASSERT(m_pool.GetWorkerIndex() < 0);
+        spBatch->results.resize(nCount);
+        spBatch->nPending = nCount;
+        spBatch->bAbandoned = false;
+        spBatch->spLate = m_spLate;
+        for (size_t ii = 0; ii < nCount; ii++)
+        {
+            spBatch->results[ii].key = lpKeys[ii];
+            spBatch->results[ii].state = eStatePending;
+        }
+        for (size_t ii = 0; ii < nCount; ii++)
+        {
+            std::shared_ptr<tProvider> spProvider = m_spProvider;
+            TKEY key = lpKeys[ii];
+
+            m_pool.Submit([spBatch, spProvider, key, ii] { ResolveOne(spBatch, *spProvider, key, ii); });
+        }
+        {
+            std::unique_lock<std::mutex> lock(spBatch->lock);
+
+            bAll = spBatch->cvDone.wait_until(lock, tDeadline, [&] { return (0 == spBatch->nPending); });
+            spBatch->bAbandoned = true;
+            results.swap(spBatch->results);
+            // counted under the lock, so that the late tasks decrement only what has been added
+            *m_spLate += spBatch->nPending;
+        }
+        for (size_t ii = 0; ii < nCount; ii++)
+        {
+            switch (results[ii].state)
+            {
+                case eStateResolved: m_nResolved++; break;
+                case eStateFailed:   m_nFailed++;   break;
+                default:             m_nTimedOut++; break;
+            }
+        }
+        return bAll;
+    }
+
+protected:
+    static void ResolveOne(std::shared_ptr<tBatch> spBatch, tProvider &provider, TKEY key, size_t nIndex)
+    {
+        tString strText;
+        bool    bResolved;
+
+        try
+        {
+            bResolved = provider.ResolveText(key, strText);
+        }
+        catch (...)
+        {
+            bResolved = false;
+        }
+        {
+            std::lock_guard<std::mutex> lock(spBatch->lock);
+
+            if (!spBatch->bAbandoned)
+            {
+                tResult &result = spBatch->results[nIndex];
+
+                result.state = bResolved ? eStateResolved : eStateFailed;
+                result.strText.swap(strText);
+            }
+            else
+            {
+                (*spBatch->spLate)--;
+            }
+            spBatch->nPending--;
+            spBatch->cvDone.notify_all();
+        }
+    }
+};
+
+#ifdef __SUBSTASYNCRESOLVER_OWN_ASSERT__
+#undef ASSERT
+#undef __SUBSTASYNCRESOLVER_OWN_ASSERT__
+#endif
+
+#endif // __SUBSTASYNCRESOLVER_H__
@@ -0,0 +1,420 @@
+/////////////////////////////////////////////////////////////////////////////
+// SubstBatchRender.h : interface of the classes
+//                      CSubstRenderTemplate, CSubstBatchRenderer
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef __SUBSTBATCHRENDER_H__
+#define __SUBSTBATCHRENDER_H__
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDE FILES
+/////////////////////////////////////////////////////////////////////////////
+// Note: This header intentionally does not depend on MFC,
+// so it can be used ( and benchmarked ) outside of the MFC build as well.
+#include <stddef.h>
+#include <assert.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "SubstWorkPool.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// MANIFESTED CONSTANTS & MACROS
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef ASSERT
+#define ASSERT(f)  assert(f)
+#define __SUBSTBATCHRENDER_OWN_ASSERT__
+#endif
+
+/////////////////////////////////////////////////////////////////////////////
+// TYPES
+/////////////////////////////////////////////////////////////////////////////
+
+/** ISubstRecordSource provides the field values of the records to be rendered by CSubstBatchRenderer.
+    It is called by several worker threads at once, so it must be thread-safe.
+*/
+template<class TCHARTYPE, class TFIELDID> struct ISubstRecordSource
+{
+    /// Returns the count of records
+    virtual size_t GetRecordCount() const = 0;
+    /// Returns the value of the field id in the record nRecord and its length ( the value is not null-terminated ),
+    /// or NULL if the record has no such value; the field is rendered empty then.
+    /// The value must remain valid until the next call by the same thread.
+    virtual TCHARTYPE const* GetFieldValue(size_t nRecord, TFIELDID id, size_t &nLength) const = 0;
+};
+
+/** ISubstRecordSink receives the rendered records.
+    It is called just by the thread calling CSubstBatchRenderer::Render, never concurrently.
+*/
+template<class TCHARTYPE> struct ISubstRecordSink
+{
+    /// Receives the text of the record nRecord, not null-terminated
+    virtual void WriteRecord(size_t nRecord, TCHARTYPE const* lpText, size_t nLength) = 0;
+};
+
+/// The order the records are passed to ISubstRecordSink in
+enum ESubstBatchOrder
+{
+    /// in the order of records
+    eBatchOrdered,
+    /// as soon as they are rendered
+    eBatchUnordered,
+};
+
+/** tSubstBatchStats is the throughput of one CSubstBatchRenderer::Render call
+*/
+struct tSubstBatchStats
+{
+    size_t nRecords;
+    size_t nChunks;
+    /// the count of characters rendered
+    size_t nChars;
+    /// the count of bytes rendered
+    size_t nBytes;
+    /// the count of chunks rendered by another worker than the one they were queued for
+    size_t nStolen;
+    double dSeconds;
+
+    double GetRecordsPerSecond() const
+    { return (0 < dSeconds) ? (nRecords / dSeconds) : 0; }
+    double GetBytesPerSecond() const
+    { return (0 < dSeconds) ? (nBytes / dSeconds) : 0; }
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// CLASES
+/////////////////////////////////////////////////////////////////////////////
+
+/** CSubstRenderTemplate is the immutable snapshot of the substitution template:
+    the logical text, and the slots of the fields in the order of their positions
+    ( see CSubstRenderExt::GetRenderTemplate ).
+    It does not refer to the data it was taken from, hence it can be rendered by several threads at once.
+*/
+template<class TCHARTYPE, class TFIELDID> class CSubstRenderTemplate
+{
+public:
+    typedef std::basic_string<TCHARTYPE> tString;
+
+    struct tSlot
+    {
+        size_t   nPos;
+        TFIELDID id;
+    };
+
+protected:
+    tString            m_text;
+    std::vector<tSlot> m_slots;
+
+public:
+    CSubstRenderTemplate()
+    { }
+
+    tString const& GetText() const
+    { return m_text; }
+    size_t GetSlotCount() const
+    { return m_slots.size(); }
+    tSlot const& GetSlot(size_t nIndex) const
+    { return m_slots[nIndex]; }
+
+    void Clear()
+    {
+        m_text.clear();
+        m_slots.clear();
+    }
+
+    /// Assigns the logical text, removing all slots
+    void AssignText(TCHARTYPE const* lpText, size_t nLength)
+    {
+        m_text.assign(lpText, nLength);
+        m_slots.clear();
+    }
+    /// Returns the buffer of nLength characters to be filled with the logical text, removing all slots
+    TCHARTYPE* AssignTextBuffer(size_t nLength)
+    {
+        m_text.resize(nLength);
+        m_slots.clear();
+        return (0 < nLength) ? &m_text[0] : NULL;
+    }
+
+    void ReserveSlots(size_t nCount)
+    { m_slots.reserve(nCount); }
+    /// Appends the slot; the slots must be appended in the order of positions
+    void AppendSlot(size_t nPos, TFIELDID id)
+    {
+        tSlot slot;
+
+        ASSERT(nPos <= m_text.size());
+        ASSERT(m_slots.empty() || (m_slots.back().nPos <= nPos));
+        slot.nPos = nPos;
+        slot.id = id;
+        m_slots.push_back(slot);
+    }
+
+    /// Appends the template rendered with the values of the record nRecord to output
+    void RenderTo(
+        ISubstRecordSource<TCHARTYPE, TFIELDID> const &source,
+        size_t nRecord,
+        tString &output) const
+    {
+        TCHARTYPE const* lpText = m_text.c_str();
+        TCHARTYPE const* lpValue;
+        size_t nCopied = 0, nLength;
+
+        for (size_t ii = 0, nSlots = m_slots.size(); ii < nSlots; ii++)
+        {
+            tSlot const& slot = m_slots[ii];
+
+            output.append(lpText + nCopied, slot.nPos - nCopied);
+            nCopied = slot.nPos;
+            nLength = 0;
+            if (NULL != (lpValue = source.GetFieldValue(nRecord, slot.id, nLength)))
+            {
+                output.append(lpValue, nLength);
+            }
+        }
+        output.append(lpText + nCopied, m_text.size() - nCopied);
+    }
+};
+
+/** CSubstBatchRenderer renders one template with the values of many records ( the "mail merge" ),
+    on the threads of CSubstWorkPool.
+    The records are split into chunks, each of them rendered by one task to its own buffer;
+    the worker stealing the tasks of others keeps all threads busy, even if some records are much longer.
+    The buffers are passed to the sink by the thread calling Render,
+    either in the order of records, or as soon as they are rendered.
+    At most GetMaxChunksInFlight chunks are rendered or waiting for the sink at once,
+    hence the memory needed does not depend on the count of records.
+*/
+template<class TCHARTYPE, class TFIELDID> class CSubstBatchRenderer
+{
+public:
+    typedef CSubstRenderTemplate<TCHARTYPE, TFIELDID> tTemplate;
+    typedef ISubstRecordSource<TCHARTYPE, TFIELDID>   tSource;
+    typedef ISubstRecordSink<TCHARTYPE>               tSink;
+    typedef std::basic_string<TCHARTYPE>              tString;
+
+protected:
+    // The buffer of one chunk of records
+    struct tChunk
+    {
+        size_t  nFirstRecord;
+        size_t  nRecords;
+        tString text;
+        // the end of each record in text
+        std::vector<size_t> ends;
+        bool    bFailed;
+    };
+
+    // The state of one Render call, shared with its tasks
+    struct tBatch
+    {
+        tTemplate const*        lpTemplate;
+        tSource const*          lpSource;
+        std::vector<tChunk>     chunks;
+        // the chunks of the buffers rendered, not passed to the sink yet
+        std::deque<size_t>      ready;
+        size_t                  nRunning;
+        std::mutex              lock;
+        std::condition_variable cvDone;
+    };
+
+    CSubstWorkPool&  m_pool;
+    ESubstBatchOrder m_order;
+    size_t           m_nChunkRecords;
+    size_t           m_nMaxInFlight;
+
+public:
+    CSubstBatchRenderer(CSubstWorkPool &pool)
+        : m_pool(pool), m_order(eBatchOrdered), m_nChunkRecords(64), m_nMaxInFlight(4 * pool.GetThreadCount())
+    { }
+
+    ESubstBatchOrder GetOrder() const
+    { return m_order; }
+    void SetOrder(ESubstBatchOrder order)
+    { m_order = order; }
+
+    size_t GetChunkRecords() const
+    { return m_nChunkRecords; }
+    void SetChunkRecords(size_t nRecords)
+    {
+        ASSERT(0 < nRecords);
+        m_nChunkRecords = nRecords;
+    }
+
+    size_t GetMaxChunksInFlight() const
+    { return m_nMaxInFlight; }
+    void SetMaxChunksInFlight(size_t nChunks)
+    {
+        ASSERT(0 < nChunks);
+        m_nMaxInFlight = nChunks;
+    }
+
+    /** Renders all records of the source, passing them to the sink, and waits until it is done.
+        Returns false if rendering of some chunk has failed ( by an exception thrown by the source,
+        or out of memory ); the chunks passed to the sink before the failure are not taken back,
+        the rest is dropped.
+        An exception thrown by the sink is passed to the caller, after the running tasks finish.
+        Must not be called by a worker of the pool.
+    */
+    bool Render(
+        tTemplate const &templ,
+        tSource const &source,
+        tSink &sink,
+        tSubstBatchStats *lpStats = NULL)
+    {
+        std::chrono::steady_clock::time_point const tStart = std::chrono::steady_clock::now();
+        size_t const nStolenBefore = m_pool.GetStolenCount();
+        size_t const nRecords = source.GetRecordCount();
+        size_t const nChunks = (nRecords + m_nChunkRecords - 1) / m_nChunkRecords;
+        size_t const nSlots = (nChunks < m_nMaxInFlight) ? nChunks : m_nMaxInFlight;
+        // the chunks in the order submitted; and the buffers not used
+        std::deque<size_t> submitted, freeSlots;
+        size_t nSubmitted = 0, nChars = 0, nSlot;
+        bool   bFailed = false;
+        tBatch batch;
+
+        ASSERT(m_pool.GetWorkerIndex() < 0);
+        batch.lpTemplate = &templ;
+        batch.lpSource = &source;
+        batch.chunks.resize(nSlots);
+        batch.nRunning = 0;
+        for (nSlot = 0; nSlot < nSlots; nSlot++)
+        {
+            freeSlots.push_back(nSlot);
+        }
+
+        try
+        {
+            while (!submitted.empty() || ((nSubmitted < nChunks) && !bFailed))
+            {
+                // keep all the buffers busy
+                while (!freeSlots.empty() && (nSubmitted < nChunks) && !bFailed)
+                {
+                    nSlot = freeSlots.front();
+                    freeSlots.pop_front();
+                    SubmitChunk(batch, nSlot, nSubmitted * m_nChunkRecords,
+                        ((nRecords - nSubmitted * m_nChunkRecords) < m_nChunkRecords) ?
+                            (nRecords - nSubmitted * m_nChunkRecords) : m_nChunkRecords);
+                    submitted.push_back(nSlot);
+                    nSubmitted++;
+                }
+                // wait for the next chunk to be written
+                {
+                    std::unique_lock<std::mutex> lock(batch.lock);
+
+                    if (eBatchOrdered == m_order)
+                    {
+                        nSlot = submitted.front();
+                        batch.cvDone.wait(lock, [&] { return IsReady(batch, nSlot); });
+                        batch.ready.erase(std::find(batch.ready.begin(), batch.ready.end(), nSlot));
+                    }
+                    else
+                    {
+                        batch.cvDone.wait(lock, [&] { return !batch.ready.empty(); });
+                        nSlot = batch.ready.front();
+                        batch.ready.pop_front();
+                    }
+                }
+                submitted.erase(std::find(submitted.begin(), submitted.end(), nSlot));
+                freeSlots.push_back(nSlot);
+
+                tChunk const& chunk = batch.chunks[nSlot];
+                if (chunk.bFailed)
+                {
+                    bFailed = true;
+                }
+                else if (!bFailed)
+                {
+                    for (size_t ii = 0, nStart = 0; ii < chunk.nRecords; nStart = chunk.ends[ii++])
+                    {
+                        sink.WriteRecord(chunk.nFirstRecord + ii, chunk.text.c_str() + nStart, chunk.ends[ii] - nStart);
+                    }
+                    nChars += chunk.text.size();
+                }
+            }
+        }
+        catch (...)
+        {   // the tasks refer to the batch; must not leave before they finish
+            std::unique_lock<std::mutex> lock(batch.lock);
+            batch.cvDone.wait(lock, [&] { return (0 == batch.nRunning); });
+            throw;
+        }
+
+        if (NULL != lpStats)
+        {
+            lpStats->nRecords = nRecords;
+            lpStats->nChunks = nSubmitted;
+            lpStats->nChars = nChars;
+            lpStats->nBytes = nChars * sizeof(TCHARTYPE);
+            lpStats->nStolen = m_pool.GetStolenCount() - nStolenBefore;
+            lpStats->dSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - tStart).count();
+        }
+        return !bFailed;
+    }
+
+protected:
+    static bool IsReady(tBatch &batch, size_t nSlot)
+    { return (batch.ready.end() != std::find(batch.ready.begin(), batch.ready.end(), nSlot)); }
+
+    void SubmitChunk(tBatch &batch, size_t nSlot, size_t nFirstRecord, size_t nRecords)
+    {
+        tChunk &chunk = batch.chunks[nSlot];
+
+        chunk.nFirstRecord = nFirstRecord;
+        chunk.nRecords = nRecords;
+        chunk.bFailed = false;
+        {
+            std::lock_guard<std::mutex> lock(batch.lock);
+            batch.nRunning++;
+        }
+        try
+        {
+            m_pool.Submit([&batch, nSlot] { RenderChunk(batch, nSlot); });
+        }
+        catch (...)
+        {   // the task has not been queued, so it would never decrement the count waited for by Render
+            std::lock_guard<std::mutex> lock(batch.lock);
+            batch.nRunning--;
+            throw;
+        }
+    }
+
+    // The task rendering one chunk; the buffer is reused, so it does not grow once it is big enough
+    static void RenderChunk(tBatch &batch, size_t nSlot)
+    {
+        tChunk &chunk = batch.chunks[nSlot];
+
+        try
+        {
+            chunk.text.clear();
+            chunk.ends.clear();
+            for (size_t ii = 0; ii < chunk.nRecords; ii++)
+            {
+                batch.lpTemplate->RenderTo(*batch.lpSource, chunk.nFirstRecord + ii, chunk.text);
+                chunk.ends.push_back(chunk.text.size());
+            }
+        }
+        catch (...)
+        {
+            chunk.bFailed = true;
+        }
+        {   // notified under the lock: once it is released, the batch may be gone
+            std::lock_guard<std::mutex> lock(batch.lock);
+            batch.ready.push_back(nSlot);
+            batch.nRunning--;
+            batch.cvDone.notify_all();
+        }
+    }
+};
+
+#ifdef __SUBSTBATCHRENDER_OWN_ASSERT__
+#undef ASSERT
+#undef __SUBSTBATCHRENDER_OWN_ASSERT__
+#endif
+
+#endif // __SUBSTBATCHRENDER_H__
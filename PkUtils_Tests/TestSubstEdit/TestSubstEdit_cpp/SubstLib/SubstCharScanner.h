@@ -0,0 +1,219 @@
+/////////////////////////////////////////////////////////////////////////////
+// SubstCharScanner.h
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef __SUBSTCHARSCANNER_H__
+#define __SUBSTCHARSCANNER_H__
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDE FILES
+/////////////////////////////////////////////////////////////////////////////
+// Note: This header intentionally does not depend on MFC,
+// so it can be used ( and benchmarked ) outside of the MFC build as well.
+#include <stddef.h>
+
+// The vector code is chosen at compile time; SSE2 is always available on x64.
+// Define SUBST_SCANNER_NO_SIMD to use the scalar code only.
+#if !defined(SUBST_SCANNER_NO_SIMD)
+#if defined(__AVX2__)
+#define SUBST_SCANNER_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define SUBST_SCANNER_SSE2
+#include <emmintrin.h>
+#endif
+#endif // SUBST_SCANNER_NO_SIMD
+
+#if defined(_MSC_VER) && (defined(SUBST_SCANNER_AVX2) || defined(SUBST_SCANNER_SSE2))
+#include <intrin.h>
+#endif
+
+/////////////////////////////////////////////////////////////////////////////
+// CLASES
+/////////////////////////////////////////////////////////////////////////////
+
+/** CSubstCharScanner finds the next occurrence of any of a small set of characters
+    ( up to tMaxChars ), comparing a whole vector of characters at once ( AVX2 or SSE2 ),
+    with the scalar code for the rest of the text and for platforms without them.
+    It works for characters of 1, 2 or 4 bytes, hence for both widths of TCHAR.
+*/
+template<class TCHARTYPE> class CSubstCharScanner
+{
+public:
+    enum { tMaxChars = 4 };
+
+protected:
+    TCHARTYPE m_chars[tMaxChars];
+    size_t    m_nCount;
+
+public:
+    CSubstCharScanner() : m_nCount(0)
+    { }
+
+    size_t GetCount() const
+    { return m_nCount; }
+    void Clear()
+    { m_nCount = 0; }
+
+    /// Adds the character to the set; returns false if the set is full
+    bool AddChar(TCHARTYPE ch)
+    {
+        for (size_t ii = 0; ii < m_nCount; ii++)
+        {
+            if (m_chars[ii] == ch)
+                return true;
+        }
+        if (m_nCount >= tMaxChars)
+        {
+            return false;
+        }
+        m_chars[m_nCount++] = ch;
+        return true;
+    }
+
+    /// Returns the index of the first character of the set in lpText[nFrom, nLength), or nLength
+    size_t Find(TCHARTYPE const* lpText, size_t nFrom, size_t nLength) const
+    {
+        size_t ii = nFrom;
+
+        if (0 == m_nCount)
+        {
+            return nLength;
+        }
+#if defined(SUBST_SCANNER_AVX2)
+        ii = FindAvx2(lpText, ii, nLength);
+#elif defined(SUBST_SCANNER_SSE2)
+        ii = FindSse2(lpText, ii, nLength);
+#endif
+        for (; ii < nLength; ii++)
+        {
+            if (IsInSet(lpText[ii]))
+                break;
+        }
+        return ii;
+    }
+
+protected:
+    bool IsInSet(TCHARTYPE ch) const
+    {
+        for (size_t jj = 0; jj < m_nCount; jj++)
+        {
+            if (m_chars[jj] == ch)
+                return true;
+        }
+        return false;
+    }
+
+    static unsigned LowestBit(unsigned nMask)
+    {
+#ifdef _MSC_VER
+        unsigned long nBit;
+        _BitScanForward(&nBit, nMask);
+        return (unsigned)nBit;
+#else
+        return (unsigned)__builtin_ctz(nMask);
+#endif
+    }
+
+#if defined(SUBST_SCANNER_AVX2)
+    static __m256i Broadcast(TCHARTYPE ch)
+    {
+        switch (sizeof(TCHARTYPE))
+        {
+        case 1:  return _mm256_set1_epi8((char)ch);
+        case 2:  return _mm256_set1_epi16((short)ch);
+        default: return _mm256_set1_epi32((int)ch);
+        }
+    }
+    static __m256i CompareEq(__m256i a, __m256i b)
+    {
+        switch (sizeof(TCHARTYPE))
+        {
+        case 1:  return _mm256_cmpeq_epi8(a, b);
+        case 2:  return _mm256_cmpeq_epi16(a, b);
+        default: return _mm256_cmpeq_epi32(a, b);
+        }
+    }
+
+    // Scans whole blocks of 32 bytes; returns the index of the match, or of the first character not scanned
+    size_t FindAvx2(TCHARTYPE const* lpText, size_t ii, size_t nLength) const
+    {
+        size_t const nStep = sizeof(__m256i) / sizeof(TCHARTYPE);
+        __m256i sets[tMaxChars];
+        size_t jj;
+
+        for (jj = 0; jj < m_nCount; jj++)
+        {
+            sets[jj] = Broadcast(m_chars[jj]);
+        }
+        for (; ii + nStep <= nLength; ii += nStep)
+        {
+            __m256i block = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(lpText + ii));
+            __m256i found = CompareEq(block, sets[0]);
+            unsigned nMask;
+
+            for (jj = 1; jj < m_nCount; jj++)
+            {
+                found = _mm256_or_si256(found, CompareEq(block, sets[jj]));
+            }
+            if (0 != (nMask = (unsigned)_mm256_movemask_epi8(found)))
+            {
+                return ii + LowestBit(nMask) / sizeof(TCHARTYPE);
+            }
+        }
+        return ii;
+    }
+#endif // SUBST_SCANNER_AVX2
+
+#if defined(SUBST_SCANNER_SSE2)
+    static __m128i Broadcast(TCHARTYPE ch)
+    {
+        switch (sizeof(TCHARTYPE))
+        {
+        case 1:  return _mm_set1_epi8((char)ch);
+        case 2:  return _mm_set1_epi16((short)ch);
+        default: return _mm_set1_epi32((int)ch);
+        }
+    }
+    static __m128i CompareEq(__m128i a, __m128i b)
+    {
+        switch (sizeof(TCHARTYPE))
+        {
+        case 1:  return _mm_cmpeq_epi8(a, b);
+        case 2:  return _mm_cmpeq_epi16(a, b);
+        default: return _mm_cmpeq_epi32(a, b);
+        }
+    }
+
+    // Scans whole blocks of 16 bytes; returns the index of the match, or of the first character not scanned
+    size_t FindSse2(TCHARTYPE const* lpText, size_t ii, size_t nLength) const
+    {
+        size_t const nStep = sizeof(__m128i) / sizeof(TCHARTYPE);
+        __m128i sets[tMaxChars];
+        size_t jj;
+
+        for (jj = 0; jj < m_nCount; jj++)
+        {
+            sets[jj] = Broadcast(m_chars[jj]);
+        }
+        for (; ii + nStep <= nLength; ii += nStep)
+        {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<__m128i const*>(lpText + ii));
+            __m128i found = CompareEq(block, sets[0]);
+            unsigned nMask;
+
+            for (jj = 1; jj < m_nCount; jj++)
+            {
+                found = _mm_or_si128(found, CompareEq(block, sets[jj]));
+            }
+            if (0 != (nMask = (unsigned)_mm_movemask_epi8(found)))
+            {
+                return ii + LowestBit(nMask) / sizeof(TCHARTYPE);
+            }
+        }
+        return ii;
+    }
+#endif // SUBST_SCANNER_SSE2
+};
+
+#endif // __SUBSTCHARSCANNER_H__
@@ -108,13 +108,15 @@ protected:
     static LRESULT CALLBACK SubstEditNewPro(HWND hwnd, UINT, WPARAM, LPARAM);
 #ifdef _DEBUG
     void	 AssertSelValidity(CSelInfo const& sel) const;
+    BOOL	 IsWindowTextConsistent(size_t iStart, size_t iEnd) const;
 #endif
 
     void EmptyEditCtrlUndoBuffer();
     LRESULT  CallOrigProc(UINT msg, WPARAM wParam = 0, LPARAM lParam = 0);
 
     BOOL	SetNewWndProc(WNDPROC NewWndProc);
-    size_t 	ModifyDataOnInsertion(size_t iPos, LPCTSTR szOldText, LPCTSTR szNewText);
+    size_t 	ModifyDataOnInsertion(size_t iPos, size_t iNewCaret);
+    BOOL    GetWindowTextPart(size_t iStart, size_t nCount, CString &strPart) const;
 
     void    ChangeModifyTempCountReset();
     void    ChangeModifyTempCountIncrement();
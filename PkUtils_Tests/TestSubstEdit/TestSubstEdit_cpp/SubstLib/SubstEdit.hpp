@@ -193,7 +193,7 @@ template<class TFIELDID>
 void CSubstEdit<TFIELDID>::AssertSelValidity(
     CSelInfo const& sel) const
 {
-    ASSERT(NULL == RFPhysDataC().FindPhysInfoPosIsIn(sel.StartChar()));
+    ASSERT(0 > RFPhysDataC().FindPhysInfoPosIsIn(sel.StartChar()));
     if (sel.IsSel())
     {
         if (sel.IsAllSelection())
@@ -201,10 +201,43 @@ void CSubstEdit<TFIELDID>::AssertSelValidity(
         }
         else
         {
-            ASSERT(NULL == RFPhysDataC().FindPhysInfoPosIsIn(sel.EndChar()));
+            ASSERT(0 > RFPhysDataC().FindPhysInfoPosIsIn(sel.EndChar()));
         }
     }
 }
+
+// Checks the window text matches the physical data, as the current validation level requires.
+// The incremental check compares the edited range [iStart, iEnd) of the text, 
+// extended by CSubstValidation::GetContext() characters on both sides.
+template<class TFIELDID> 
+BOOL CSubstEdit<TFIELDID>::IsWindowTextConsistent(size_t iStart, size_t iEnd) const
+{
+    CString  strTmp;
+    size_t   nContext, nPhysLen, winStart, winEnd;
+
+    if (CSubstValidation::IsFullCheckDue())
+    {
+        GetWindowText(strTmp);
+        return (strTmp == RFPhysDataC().GetPhysStr());
+    }
+    if (CSubstValidation::IsIncremental())
+    {
+        nContext = CSubstValidation::GetContext();
+        nPhysLen = RFPhysDataC().GetPhysLength();
+        if ((iStart > iEnd) || (iEnd > nPhysLen) || ((size_t)GetWindowTextLength() != nPhysLen))
+        {
+            return FALSE;
+        }
+        winStart = (iStart > nContext) ? (iStart - nContext) : 0;
+        winEnd = (nPhysLen - iEnd > nContext) ? (iEnd + nContext) : nPhysLen;
+        if (!GetWindowTextPart(winStart, winEnd - winStart, strTmp))
+        {
+            return FALSE;
+        }
+        return (strTmp == RFPhysDataC().GetPhysStrPart((tPhysPos)winStart, winEnd - winStart));
+    }
+    return TRUE;
+}
 #endif // _DEBUG
 
 template<class TFIELDID> 
@@ -243,19 +276,19 @@ int CSubstEdit<TFIELDID>::LineCol2CharPos(int line, int col) const
 template<class TFIELDID> 
 tPhysPos CSubstEdit<TFIELDID>::FindPosOutsidePhys(tPhysPos iorig, eFindDirection direction) const
 {
-    CPhysInfo<TFIELDID>* lpPhys;
+    INT_PTR           nPhys;
     tPhysPos          res = iorig;
 
-    if (lpPhys = RFPhysDataC().FindPhysInfoPosIsIn(iorig))
+    if (0 <= (nPhys = RFPhysDataC().FindPhysInfoPosIsIn(iorig)))
     {
-        size_t delta_a = iorig - lpPhys->GetStart();
-        size_t delta_b = lpPhys->GetEnd() - iorig;
+        size_t delta_a = iorig - RFPhysDataC().GetPhysInfoStart(nPhys);
+        size_t delta_b = RFPhysDataC().GetPhysInfoEnd(nPhys) - iorig;
 
         ASSERT((delta_a > 0) && (delta_b > 0));
         if ( (direction == eFindBackward) || (direction == eFindCloser && (delta_a <= delta_b)) )
-            res = lpPhys->GetStart();
+            res = RFPhysDataC().GetPhysInfoStart(nPhys);
         else
-            res = lpPhys->GetEnd();
+            res = RFPhysDataC().GetPhysInfoEnd(nPhys);
     }
 
     return res;
@@ -462,16 +495,16 @@ BOOL CSubstEdit<TFIELDID>::InsertNewInfo(
 {
     CSelInfo     selInf;
     tPhysPos     phpos;
-    CPhysInfo<TFIELDID>*  lpPh;
+    INT_PTR      nPh;
     BOOL         res = FALSE;
 
     ASSERT(::IsWindow((HWND)*this));
     ASSERT(this->IsSubclassed());
-    if (lpPh = PhysData().InsertNewInfo(GetSelInfo(selInf).CaretChar(), what))
+    if (0 <= (nPh = PhysData().InsertNewInfo(GetSelInfo(selInf).CaretChar(), what)))
     {
         NotifyFixPrologue();
         LockHookFn();
-        phpos = lpPh->GetEnd();
+        phpos = PhysData().GetPhysInfoEnd(nPh);
         CallOrigProc(WM_SETTEXT, 0, (LPARAM)(LPVOID)PhysData().GetPhysStr());
         CallOrigProc(EM_SETSEL, (WPARAM)phpos, (LPARAM)phpos);
         CallOrigProc(EM_SCROLLCARET);
@@ -485,28 +518,79 @@ BOOL CSubstEdit<TFIELDID>::InsertNewInfo(
     return res;
 }
 
+// Reads nCount characters of the window text starting on iStart, line by line by EM_GETLINE,
+// so that the whole window text does not have to be copied.
+template<class TFIELDID> 
+BOOL CSubstEdit<TFIELDID>::GetWindowTextPart(size_t iStart, size_t nCount, CString &strPart) const
+{
+    CSubstEdit<TFIELDID>* pThis = const_cast<CSubstEdit<TFIELDID>*>(this);
+    LPCTSTR  szBreak = _T("\r\n");
+    CString  strLine;
+    size_t   iPos = iStart, iEnd = iStart + nCount;
+    size_t   nLineEnd, nPartEnd;
+    int      nLine, nLineStart, nLineLength, nNextStart;
+
+    strPart.Empty();
+    while (iPos < iEnd)
+    {
+        nLine = (int)pThis->CallOrigProc(EM_LINEFROMCHAR, (WPARAM)iPos);
+        nLineStart = (int)pThis->CallOrigProc(EM_LINEINDEX, (WPARAM)nLine);
+        nLineLength = (int)pThis->CallOrigProc(EM_LINELENGTH, (WPARAM)nLineStart);
+        if ((nLineStart < 0) || (iPos < (size_t)nLineStart))
+        {
+            return FALSE;
+        }
+        nLineEnd = (size_t)(nLineStart + nLineLength);
+        if (iPos < nLineEnd)
+        {   // the first word of the buffer is its size for EM_GETLINE
+            LPTSTR lpBuf = strLine.GetBuffer(nLineLength + 2);
+            *(LPWORD)lpBuf = (WORD)nLineLength;
+            strLine.ReleaseBuffer((int)pThis->CallOrigProc(EM_GETLINE, (WPARAM)nLine, (LPARAM)lpBuf));
+            if (strLine.GetLength() != nLineLength)
+            {
+                return FALSE;
+            }
+            nPartEnd = (iEnd < nLineEnd) ? iEnd : nLineEnd;
+            strPart += strLine.Mid((int)(iPos - nLineStart), (int)(nPartEnd - iPos));
+            iPos = nPartEnd;
+        }
+        if (iPos < iEnd)
+        {   // the line break up to the next line; none if the line is just wrapped
+            if ((nNextStart = (int)pThis->CallOrigProc(EM_LINEINDEX, (WPARAM)(nLine + 1))) < 0)
+            {
+                return FALSE;
+            }
+            if (((size_t)nNextStart < nLineEnd) || (_tcslen(szBreak) < (size_t)nNextStart - nLineEnd))
+            {
+                return FALSE;
+            }
+            for (; (iPos < iEnd) && (iPos < (size_t)nNextStart); iPos++)
+            {
+                strPart += szBreak[iPos - nLineEnd];
+            }
+        }
+    }
+    return TRUE;
+}
+
+// Inserts to the physical data the text typed on iPos, before the caret iNewCaret.
+// Just the typed characters are read from the window, not the whole window text.
 template<class TFIELDID> 
 size_t CSubstEdit<TFIELDID>::ModifyDataOnInsertion(
     size_t   iPos, 
-    LPCTSTR  szOldText, 
-    LPCTSTR  szNewText)
+    size_t   iNewCaret)
 {
-    size_t   ioldLen, inewLen, irold;
     CString  strTmp;
-    CString  strOld = szOldText;
-    CString  strNew = szNewText;
     size_t   delta = 0;
 
-    if (strOld != strNew)
+    ASSERT(iNewCaret >= iPos);
+    if (iNewCaret > iPos)
     {
-        delta = (inewLen = strNew.GetLength()) - (ioldLen = strOld.GetLength());
-        ASSERT(delta > 0);
-        irold = ioldLen  - iPos;
-        ASSERT(strOld.Left((int)iPos) == strNew.Left((int)iPos));
-        ASSERT(strOld.Right((int)irold) == strNew.Right((int)irold));
-        strTmp = strNew.Mid((int)iPos, (int)delta);
+        delta = iNewCaret - iPos;
+        VERIFY(GetWindowTextPart(iPos, delta, strTmp));
         VERIFY(PhysData().InsertText(iPos, strTmp));
-        ASSERT(PhysData().GetPhysStr() == strNew);
+        // the typed text and the text around it are checked, as the validation level requires
+        ASSERT(IsWindowTextConsistent(iPos, iNewCaret));
     }
     return delta;
 }
@@ -559,7 +643,7 @@ LRESULT CSubstEdit<TFIELDID>::DeleteSel_WmCharStrange(
     {
         PhysData().DeleteAllBetween(selInf.StartChar(), selInf.EndChar());
         CEdit::EmptyUndoBuffer();
-        ASSERT(strNew == PhysData().GetPhysStr());
+        ASSERT(IsWindowTextConsistent(selInf.StartChar(), selInf.StartChar()));
     }
     return lRes;
 }
@@ -569,27 +653,24 @@ LRESULT CSubstEdit<TFIELDID>::BackspaceDeleteNotSel(
     CSelInfo const& selInf, 
     LPARAM      lParam)
 {
-#ifdef _DEBUG
-    CString     strTmp;
-#endif
     CSelInfo    sel;
-    CPhysInfo<TFIELDID>* lpPhys;
+    INT_PTR     nPhys;
     size_t      iCaret, iStart;
     LRESULT     lRes = 0;
 
     ASSERT(!selInf.IsSel());
     if ((iCaret = selInf.CaretChar()) > 0)
     {
-        if ((lpPhys = PhysData().FindPhysInfoBefore(iCaret)) && (lpPhys->GetEnd() == iCaret))
+        if ((0 <= (nPhys = PhysData().FindPhysInfoBefore(iCaret))) && (PhysData().GetPhysInfoEnd(nPhys) == iCaret))
         {
-            iStart = lpPhys->GetStart();
+            iStart = PhysData().GetPhysInfoStart(nPhys);
         }
         else
         {
-            CString strLeft = PhysData().StrPhysStr().Left((int)iCaret);
-            CString lastTwos = strLeft.Right(2);
+            size_t nTail = (iCaret < 2) ? iCaret : 2;
+            CString lastTwos = PhysData().GetPhysStrPart(iCaret - nTail, nTail);
 
-            if (0 == strLeft.Right(2).Compare(_T("\r\n")))
+            if (0 == lastTwos.Compare(_T("\r\n")))
                 iStart = iCaret - 2;
             else
                 iStart = iCaret - 1;
@@ -602,17 +683,13 @@ LRESULT CSubstEdit<TFIELDID>::BackspaceDeleteNotSel(
                 break;
         }
         CEdit::EmptyUndoBuffer();
-#ifdef _DEBUG
-        GetWindowText(strTmp); ASSERT(strTmp == PhysData().GetPhysStr());
-#endif
+        ASSERT(IsWindowTextConsistent(iStart, iStart));
     }
     else
     {
         lRes = CallOrigProc(WM_CHAR, VK_BACK, lParam);
         CEdit::EmptyUndoBuffer();
-#ifdef _DEBUG
-        GetWindowText(strTmp); ASSERT(strTmp == PhysData().GetPhysStr());
-#endif
+        ASSERT(IsWindowTextConsistent(0, 0));
     }
 
     return lRes;
@@ -624,24 +701,24 @@ LRESULT CSubstEdit<TFIELDID>::VkDeleteNotSel(
     LPARAM      lParam)
 {
     BYTE        pbKeyState[256];
-    CString     strTmp, strRight;
-    CPhysInfo<TFIELDID>* lpPhys;
+    CString     strRight;
+    INT_PTR     nPhys;
     size_t      iCaret, iEnd, nDelLimit;
+    size_t      nLength = PhysData().GetPhysLength();
     LRESULT     lRes = 0;
 
     ASSERT(!selInf.IsSel());
-    GetWindowText(strTmp); 
-    ASSERT(strTmp == PhysData().GetPhysStr());
-    if ((iCaret = selInf.CaretChar()) < (size_t)strTmp.GetLength())
+    ASSERT(IsWindowTextConsistent(selInf.CaretChar(), selInf.CaretChar()));
+    if ((iCaret = selInf.CaretChar()) < nLength)
     {
-        if ((lpPhys = PhysData().FindPhysInfoAfter(iCaret)) && (lpPhys->GetStart() == iCaret))
+        if ((0 <= (nPhys = PhysData().FindPhysInfoAfter(iCaret))) && (PhysData().GetPhysInfoStart(nPhys) == iCaret))
         {
-            nDelLimit = iEnd = lpPhys->GetEnd();
+            nDelLimit = iEnd = PhysData().GetPhysInfoEnd(nPhys);
         }
         else
         {
-            strRight = strTmp.Right((int)(strTmp.GetLength() - iCaret));
-            if (0 == strRight.Left(2).Compare(_T("\r\n")))
+            strRight = PhysData().GetPhysStrPart(iCaret, (nLength - iCaret < 2) ? (nLength - iCaret) : 2);
+            if (0 == strRight.Compare(_T("\r\n")))
                 iEnd = iCaret + 2;
             else
                 iEnd = iCaret + 1;
@@ -657,16 +734,12 @@ LRESULT CSubstEdit<TFIELDID>::VkDeleteNotSel(
             lRes = CallOrigProc(WM_KEYDOWN, VK_DELETE, lParam);
         }
         CEdit::EmptyUndoBuffer();
-#ifdef _DEBUG
-        GetWindowText(strTmp); ASSERT(strTmp == PhysData().GetPhysStr());
-#endif
+        ASSERT(IsWindowTextConsistent(iCaret, iCaret));
     }
     else
     {
         lRes = CallOrigProc(WM_KEYDOWN, VK_DELETE, lParam);
-#ifdef _DEBUG
-        GetWindowText(strTmp); ASSERT(strTmp == PhysData().GetPhysStr());
-#endif
+        ASSERT(IsWindowTextConsistent(iCaret, iCaret));
     }
 
     return lRes;
@@ -678,20 +751,15 @@ LRESULT CSubstEdit<TFIELDID>::WmCharDoInsetChar(
     WPARAM      wParam, 
     LPARAM      lParam)
 {
-    CString  strNew, strOld;
+    CSelInfo newSel;
     size_t   iCaret = selInf.CaretChar();
     LRESULT  lRes = 0;
 
-#ifdef _DEBUG
     ASSERT(!selInf.IsSel());
-    GetWindowText(strOld);
-    ASSERT(strOld == PhysData().GetPhysStr() );
-#else
-    strOld = PhysData().GetPhysStr();
-#endif
+    ASSERT(IsWindowTextConsistent(iCaret, iCaret));
     lRes = CallOrigProc(WM_CHAR, wParam, lParam);
-    GetWindowText(strNew);
-    if (ModifyDataOnInsertion(iCaret, strOld, strNew) > 0)
+    // the characters typed are those between the old and new caret
+    if (ModifyDataOnInsertion(iCaret, GetSelInfo(newSel).CaretChar()) > 0)
     {
         CEdit::EmptyUndoBuffer();
     }
@@ -712,7 +780,7 @@ LRESULT CSubstEdit<TFIELDID>::MoveCaretHorizontal(WPARAM wParam, LPARAM lParam)
     SetKeyboardState((LPBYTE)&pbKeyState);
 
     lRes = CallOrigProc(WM_KEYDOWN, wParam, lParam);
-    while (PhysData().FindPhysInfoPosIsIn(GetSelInfo(selInf).CaretChar()))
+    while (0 <= PhysData().FindPhysInfoPosIsIn(GetSelInfo(selInf).CaretChar()))
     {   // move caret this way to keep shift-selecting if shift is pressed
         CallOrigProc(WM_KEYDOWN, wParam, lParam);
     }
@@ -734,7 +802,7 @@ LRESULT CSubstEdit<TFIELDID>::MoveCaretVertical(WPARAM wParam, LPARAM lParam)
     SetKeyboardState((LPBYTE)&pbKeyState);
 
     lRes = CallOrigProc(WM_KEYDOWN, wParam, lParam);
-    if (PhysData().FindPhysInfoPosIsIn(tPosCurrent = GetSelInfo(selInf).CaretChar()))
+    if (0 <= PhysData().FindPhysInfoPosIsIn(tPosCurrent = GetSelInfo(selInf).CaretChar()))
     {
         eFindDirection direction = (wParam == VK_UP) ? eFindBackward : eFindForward;
         WPARAM wkSubstitute = (wParam == VK_UP) ? VK_LEFT : VK_RIGHT;
@@ -828,7 +896,7 @@ LRESULT CSubstEdit<TFIELDID>::MyOnWmLButtonDown(WPARAM wParam, LPARAM lParam)
     CPoint      pt(LOWORD(lParam), HIWORD(lParam));
     size_t      iround;
     CPoint      pttmp;
-    int         nAllLength = RFPhysDataC().StrPhysStr().GetLength();
+    int         nAllLength = (int)RFPhysDataC().GetPhysLength();
     int         charPos = GetCharIndexFromPosition(pt);
     int         istrPos = LineCol2CharPos(HIWORD(charPos), LOWORD(charPos));
     LRESULT     lRes    = 0;
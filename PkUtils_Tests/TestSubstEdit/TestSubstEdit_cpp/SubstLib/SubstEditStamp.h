@@ -0,0 +1,52 @@
+/////////////////////////////////////////////////////////////////////////////
+// SubstEditStamp.h : interface of the class CSubstEditStamp
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef __SUBSTEDITSTAMP_H__
+#define __SUBSTEDITSTAMP_H__
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDE FILES
+/////////////////////////////////////////////////////////////////////////////
+// Note: This header intentionally does not depend on MFC,
+// so it can be used ( and benchmarked ) outside of the MFC build as well.
+#include <atomic>
+
+/////////////////////////////////////////////////////////////////////////////
+// CLASES
+/////////////////////////////////////////////////////////////////////////////
+
+/** CSubstEditStamp identifies the version of the data it is a member of;
+    the data calls Touch on every modification.
+    Each new value is unique in the process, never used by any other object before.
+    Hence if the values are equal, so are the contents, even if the data has been copied or assigned
+    ( the copy takes the value of the original, along with its contents ).
+*/
+class CSubstEditStamp
+{
+public:
+    typedef unsigned long long tValue;
+
+protected:
+    tValue m_nValue;
+
+public:
+    CSubstEditStamp() : m_nValue(NewValue())
+    { }
+
+    tValue GetValue() const
+    { return m_nValue; }
+
+    /// Marks the data as modified
+    void Touch()
+    { m_nValue = NewValue(); }
+
+protected:
+    static tValue NewValue()
+    {
+        static std::atomic<tValue> s_nLast(0);
+        return ++s_nLast;
+    }
+};
+
+#endif // __SUBSTEDITSTAMP_H__
@@ -0,0 +1,695 @@
+/////////////////////////////////////////////////////////////////////////////
+// SubstFieldIndex.h
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef __SUBSTFIELDINDEX_H__
+#define __SUBSTFIELDINDEX_H__
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDE FILES
+/////////////////////////////////////////////////////////////////////////////
+// Note: This header intentionally does not depend on MFC,
+// so it can be used ( and benchmarked ) outside of the MFC build as well.
+#include <stddef.h>
+#include <assert.h>
+#include <vector>
+#include "SubstEditStamp.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// MANIFESTED CONSTANTS & MACROS
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef ASSERT
+#define ASSERT(f)  assert(f)
+#define __SUBSTFIELDINDEX_OWN_ASSERT__
+#endif
+
+/////////////////////////////////////////////////////////////////////////////
+// CLASES
+/////////////////////////////////////////////////////////////////////////////
+
+/** CFenwickTree is a binary indexed tree over a sequence of non-negative values.
+    It supports point update, point query, prefix sum and the search by prefix sum, all in O(log n).
+    The values are not stored separately; when the sequence itself has to change by inserting
+    or removing items, the tree is converted in place back to values and rebuilt, in O(n).
+    The tree is 1-based internally; the public interface uses 0-based item indexes.
+    Deltas are applied in modular arithmetic of TVALUE, so unsigned types work fine
+    as long as the resulting values and sums fit in TVALUE.
+*/
+template<class TVALUE> class CFenwickTree
+{
+public:
+    typedef TVALUE    tValue;
+    typedef ptrdiff_t tDelta;
+
+protected:
+    std::vector<tValue> m_tree;  // m_tree[0] is not used
+    size_t m_nHighBit;           // the highest power of two not greater than count
+
+public:
+    CFenwickTree() : m_tree(1, 0), m_nHighBit(0)
+    { }
+
+    size_t GetCount() const
+    { return m_tree.size() - 1; }
+
+    void RemoveAll()
+    {
+        m_tree.assign(1, 0);
+        m_nHighBit = 0;
+    }
+
+    void Reserve(size_t nCount)
+    {
+        m_tree.reserve(nCount + 1);
+    }
+
+    /// Builds the tree from nCount values, reading every nStride-th item of lpValues. Takes O(n).
+    void Build(tValue const *lpValues, size_t nCount, size_t nStride = 1)
+    {
+        m_tree.assign(1, 0);
+        m_tree.reserve(nCount + 1);
+        for (size_t ii = 0; ii < nCount; ii++)
+        {
+            m_tree.push_back(lpValues[ii * nStride]);
+        }
+        BuildInPlace();
+    }
+
+    /// Appends a new value at the end. Takes O(log n).
+    void Append(tValue value)
+    {
+        size_t nNew = GetCount() + 1;
+        m_tree.push_back((tValue)(value + Prefix(nNew - 1) - Prefix(nNew - LowBit(nNew))));
+        UpdateHighBit();
+    }
+
+    /// Inserts nCount values before the item nItem. Takes O(n).
+    void InsertAt(size_t nItem, tValue const *lpValues, size_t nCount)
+    {
+        ASSERT(nItem <= GetCount());
+        UnbuildInPlace();
+        m_tree.insert(m_tree.begin() + 1 + nItem, lpValues, lpValues + nCount);
+        BuildInPlace();
+    }
+
+    /// Removes nCount values starting with the item nItem. Takes O(n).
+    void RemoveAt(size_t nItem, size_t nCount)
+    {
+        ASSERT(nItem + nCount <= GetCount());
+        UnbuildInPlace();
+        m_tree.erase(m_tree.begin() + 1 + nItem, m_tree.begin() + 1 + nItem + nCount);
+        BuildInPlace();
+    }
+
+    /// Adds the ( possibly negative ) delta to the item nItem
+    void Add(size_t nItem, tDelta delta)
+    {
+        ASSERT(nItem < GetCount());
+        for (size_t ii = nItem + 1, isz = GetCount(); ii <= isz; ii += LowBit(ii))
+        {
+            m_tree[ii] += (tValue)delta;
+        }
+    }
+
+    /// Returns the value of the item nItem
+    tValue GetAt(size_t nItem) const
+    {
+        size_t ii = nItem + 1;
+        size_t nStop = ii - LowBit(ii);
+        tValue result = m_tree[ii];
+
+        ASSERT(nItem < GetCount());
+        // subtract the subtrees covered by m_tree[ii], except the item itself
+        for (--ii; ii > nStop; ii -= LowBit(ii))
+        {
+            result -= m_tree[ii];
+        }
+        return result;
+    }
+
+    /// Returns the sum of first nCount items
+    tValue Prefix(size_t nCount) const
+    {
+        tValue result = 0;
+        ASSERT(nCount <= GetCount());
+        for (size_t ii = nCount; ii > 0; ii -= LowBit(ii))
+        {
+            result += m_tree[ii];
+        }
+        return result;
+    }
+
+    /// Returns the largest count of first items, whose sum is not greater than value
+    size_t CountNotGreater(size_t value) const
+    {
+        size_t nPos = 0;
+        for (size_t step = m_nHighBit; step > 0; step >>= 1)
+        {
+            if ((nPos + step <= GetCount()) && (m_tree[nPos + step] <= value))
+            {
+                nPos += step;
+                value -= m_tree[nPos];
+            }
+        }
+        return nPos;
+    }
+
+    /// Returns the largest count of first items, whose sum is less than value
+    size_t CountLess(size_t value) const
+    {
+        return (0 < value) ? CountNotGreater(value - 1) : 0;
+    }
+
+    /// Copies the point values of all items to values. Takes O(n).
+    void GetValues(std::vector<tValue> &values) const
+    {
+        values.assign(m_tree.begin() + 1, m_tree.end());
+        for (size_t ii = values.size(); ii > 0; ii--)
+        {
+            size_t jj = ii + LowBit(ii);
+            if (jj <= values.size())
+            {
+                values[jj - 1] -= values[ii - 1];
+            }
+        }
+    }
+
+    /// Returns true if both trees hold the same sequence of values
+    bool IsEqual(CFenwickTree const &rhs) const
+    {   // the tree of given values is unique, hence it is enough to compare the trees
+        return (m_tree == rhs.m_tree);
+    }
+
+    /// Returns the count of bytes allocated by the tree
+    size_t GetAllocatedSize() const
+    {
+        return m_tree.capacity() * sizeof(tValue);
+    }
+
+protected:
+    static size_t LowBit(size_t ii)
+    { return ii & (~ii + 1); }
+
+    // Converts m_tree holding plain values to the tree
+    void BuildInPlace()
+    {
+        for (size_t ii = 1, isz = GetCount(); ii <= isz; ii++)
+        {
+            size_t jj = ii + LowBit(ii);
+            if (jj <= isz)
+            {
+                m_tree[jj] += m_tree[ii];
+            }
+        }
+        UpdateHighBit();
+    }
+
+    // Converts the tree back to plain values; the reverse of BuildInPlace
+    void UnbuildInPlace()
+    {
+        for (size_t ii = GetCount(); ii > 0; ii--)
+        {
+            size_t jj = ii + LowBit(ii);
+            if (jj <= GetCount())
+            {
+                m_tree[jj] -= m_tree[ii];
+            }
+        }
+    }
+
+    void UpdateHighBit()
+    {
+        size_t nCount = GetCount();
+        for (m_nHighBit = 1; (m_nHighBit << 1) <= nCount; m_nHighBit <<= 1)
+            ;
+        if (0 == nCount)
+        {
+            m_nHighBit = 0;
+        }
+    }
+};
+
+/** CSubstFieldIndex is an ordered table of fields, shared by the logical and physical view
+    of substitution data. Each field i is stored "gap-encoded" as the pair
+    <ul>
+    <li> gap(i) - the count of logical characters between the previous field and this one </li>
+    <li> len(i) - the physical length of the field text ( zero for purely logical data ) </li>
+    </ul>
+    Absolute positions are not stored; they are prefix sums computed by two Fenwick trees,
+    which are the only storage of the table ( the gaps and lengths are their point values ):
+    <ul>
+    <li> logical position(i) = gap(0) + ... + gap(i) </li>
+    <li> physical start(i) = gap(0) + len(0) + ... + len(i-1) + gap(i),
+         physical end(i) = start(i) + len(i) </li>
+    </ul>
+    Hence inserting or deleting text moves all the following fields by updating just one gap,
+    which takes O(log n) instead of rewriting every later position.
+    Fields are sorted and do not overlap; the position queries are searches by prefix sum,
+    taking O(log n), or O(log n + k) when k matching fields are enumerated.
+    Inserting or removing a field rebuilds the trees, which is O(n) like the array insertion itself.
+    Besides the positions, each field carries its id and a one-byte tag ( like the kind of logical field ),
+    kept in parallel arrays; the owners of the table build their field objects from it on demand.
+    The table keeps 32-bit values in contiguous arrays, which makes 12 bytes per field for the positions,
+    plus 4 bytes of the id and 1 byte of the tag; hence the total text length is limited to 4G characters,
+    and the id must fit in 32 bits.
+*/
+class CSubstFieldIndex
+{
+public:
+    typedef size_t    tPos;
+    typedef ptrdiff_t tDelta;
+    // Index of the field, or -1 if not found
+    typedef ptrdiff_t tIndex;
+    // The type of stored values
+    typedef unsigned int  tStoredPos;
+    typedef unsigned int  tStoredId;
+    typedef unsigned char tStoredTag;
+
+protected:
+    // tree over interleaved gap(0), len(0), gap(1), len(1) ...; 
+    // Prefix(2i + 1) is start(i), Prefix(2i + 2) is end(i)
+    CFenwickTree<tStoredPos> m_physTree;
+    // tree over gaps only; Prefix(i + 1) is logical position(i)
+    CFenwickTree<tStoredPos> m_logTree;
+    // id(i) and tag(i), in parallel with the trees
+    std::vector<tStoredId>   m_ids;
+    std::vector<tStoredTag>  m_tags;
+    // changes with each modification of the count or logical positions of fields
+    CSubstEditStamp          m_stamp;
+
+public:
+    CSubstFieldIndex()
+    { }
+
+    size_t GetCount() const
+    { return m_logTree.GetCount(); }
+    bool IsEmpty() const
+    { return (0 == GetCount()); }
+
+    tPos GetStart(size_t nDex) const
+    { ASSERT(nDex < GetCount()); return m_physTree.Prefix(2 * nDex + 1); }
+    tPos GetEnd(size_t nDex) const
+    { ASSERT(nDex < GetCount()); return m_physTree.Prefix(2 * nDex + 2); }
+    tPos GetLength(size_t nDex) const
+    { ASSERT(nDex < GetCount()); return m_physTree.GetAt(2 * nDex + 1); }
+    tPos GetLogPos(size_t nDex) const
+    { ASSERT(nDex < GetCount()); return m_logTree.Prefix(nDex + 1); }
+    tStoredId GetId(size_t nDex) const
+    { ASSERT(nDex < GetCount()); return m_ids[nDex]; }
+    tStoredTag GetTag(size_t nDex) const
+    { ASSERT(nDex < GetCount()); return m_tags[nDex]; }
+
+    /// Returns the total length of the first nCount fields
+    tPos GetLengthBefore(size_t nCount) const
+    {
+        ASSERT(nCount <= GetCount());
+        return (tStoredPos)(m_physTree.Prefix(2 * nCount) - m_logTree.Prefix(nCount));
+    }
+
+    /// Returns the stamp of the current version of the logical fields ( physical lengths are not included )
+    CSubstEditStamp::tValue GetStamp() const
+    { return m_stamp.GetValue(); }
+
+    /// Returns true if both tables hold the same logical fields ( positions, ids and tags ); lengths are ignored
+    bool IsLogicalEqual(CSubstFieldIndex const &rhs) const
+    {
+        return m_logTree.IsEqual(rhs.m_logTree) && (m_ids == rhs.m_ids) && (m_tags == rhs.m_tags);
+    }
+
+    /// Returns the count of bytes allocated by the table
+    size_t GetAllocatedSize() const
+    {
+        return m_physTree.GetAllocatedSize() + m_logTree.GetAllocatedSize() 
+            + m_ids.capacity() * sizeof(tStoredId) + m_tags.capacity() * sizeof(tStoredTag);
+    }
+
+    //// modifications ///////////////////////////////////////////////////
+    /// Marks the fields as modified; to be called if the data kept by the caller changes
+    void Touch()
+    { m_stamp.Touch(); }
+
+    void SetId(size_t nDex, tStoredId id)
+    {
+        ASSERT(nDex < GetCount());
+        m_ids[nDex] = id;
+        m_stamp.Touch();
+    }
+
+    void SetTag(size_t nDex, tStoredTag tag)
+    {
+        ASSERT(nDex < GetCount());
+        m_tags[nDex] = tag;
+        m_stamp.Touch();
+    }
+
+    void RemoveAll()
+    {
+        m_physTree.RemoveAll();
+        m_logTree.RemoveAll();
+        m_ids.clear();
+        m_tags.clear();
+        m_stamp.Touch();
+    }
+
+    void Reserve(size_t nCount)
+    {
+        m_physTree.Reserve(2 * nCount);
+        m_logTree.Reserve(nCount);
+        m_ids.reserve(nCount);
+        m_tags.reserve(nCount);
+    }
+
+    /** Replaces the contents by logical fields of rhs ( positions, ids and tags ), 
+        with zero physical length. Takes O(n).
+    */
+    void AssignLogical(CSubstFieldIndex const &rhs)
+    {
+        if (this != &rhs)
+        {
+            std::vector<tStoredPos> gaps;
+            std::vector<tStoredPos> items;
+
+            rhs.m_logTree.GetValues(gaps);
+            items.assign(2 * gaps.size(), 0);
+            for (size_t ii = 0; ii < gaps.size(); ii++)
+            {
+                items[2 * ii] = gaps[ii];
+            }
+            m_physTree.Build(items.empty() ? NULL : &items[0], items.size());
+            m_logTree = rhs.m_logTree;
+            m_ids = rhs.m_ids;
+            m_tags = rhs.m_tags;
+        }
+        m_stamp.Touch();
+    }
+
+    /// Appends the field at the end, on given logical position. Takes O(log n).
+    void Add(tPos logPos, tPos len, tStoredId id = 0, tStoredTag tag = 0)
+    {
+        tPos lastLog = IsEmpty() ? 0 : GetLogPos(GetCount() - 1);
+
+        ASSERT(lastLog <= logPos);
+        m_physTree.Append((tStoredPos)(logPos - lastLog));
+        m_physTree.Append((tStoredPos)len);
+        m_logTree.Append((tStoredPos)(logPos - lastLog));
+        m_ids.push_back(id);
+        m_tags.push_back(tag);
+        m_stamp.Touch();
+    }
+
+    /** Inserts the field on given logical position, before the field nDex.
+        Logical positions of following fields do not change,
+        their physical positions move by len.
+    */
+    void InsertAt(size_t nDex, tPos logPos, tPos len, tStoredId id = 0, tStoredTag tag = 0)
+    {
+        ASSERT(nDex <= GetCount());
+        if (nDex == GetCount())
+        {
+            Add(logPos, len, id, tag);
+        }
+        else
+        {
+            tPos prevLog = (0 < nDex) ? GetLogPos(nDex - 1) : 0;
+            tStoredPos items[2] = { (tStoredPos)(logPos - prevLog), (tStoredPos)len };
+
+            ASSERT(prevLog <= logPos);
+            ASSERT(logPos <= GetLogPos(nDex));
+            // the field nDex is now the next one; its gap is shorter
+            AddToGap(nDex, -(tDelta)items[0]);
+            m_physTree.InsertAt(2 * nDex, items, 2);
+            m_logTree.InsertAt(nDex, items, 1);
+            m_ids.insert(m_ids.begin() + nDex, id);
+            m_tags.insert(m_tags.begin() + nDex, tag);
+            m_stamp.Touch();
+        }
+    }
+
+    /** Inserts nCount fields of zero length on given logical positions ( ascending ), with given ids and tags,
+        before the field nDex. Takes O(n + nCount), regardless the count of inserted fields.
+    */
+    void InsertAt(
+        size_t            nDex, 
+        tPos const*       lpLogPos, 
+        tStoredId const*  lpIds, 
+        tStoredTag const* lpTags, 
+        size_t            nCount)
+    {
+        ASSERT(nDex <= GetCount());
+        if (nDex == GetCount())
+        {
+            for (size_t ii = 0; ii < nCount; ii++)
+            {
+                Add(lpLogPos[ii], 0, lpIds[ii], lpTags[ii]);
+            }
+        }
+        else if (0 < nCount)
+        {
+            tPos prevLog = (0 < nDex) ? GetLogPos(nDex - 1) : 0;
+            std::vector<tStoredPos> items(2 * nCount, 0);
+            std::vector<tStoredPos> gaps(nCount);
+
+            ASSERT(prevLog <= lpLogPos[0]);
+            ASSERT(lpLogPos[nCount - 1] <= GetLogPos(nDex));
+            for (size_t ii = 0; ii < nCount; ii++)
+            {
+                ASSERT((0 == ii) || (lpLogPos[ii - 1] <= lpLogPos[ii]));
+                gaps[ii] = items[2 * ii] = (tStoredPos)(lpLogPos[ii] - prevLog);
+                prevLog = lpLogPos[ii];
+            }
+            // the field nDex is now the next one; its gap is shorter
+            AddToGap(nDex, -(tDelta)(lpLogPos[nCount - 1] - ((0 < nDex) ? GetLogPos(nDex - 1) : 0)));
+            m_physTree.InsertAt(2 * nDex, &items[0], items.size());
+            m_logTree.InsertAt(nDex, &gaps[0], gaps.size());
+            m_ids.insert(m_ids.begin() + nDex, lpIds, lpIds + nCount);
+            m_tags.insert(m_tags.begin() + nDex, lpTags, lpTags + nCount);
+            m_stamp.Touch();
+        }
+    }
+
+    /** Removes nCount fields starting with nDex.
+        Logical positions of following fields do not change,
+        their physical positions move back by the length of removed fields.
+    */
+    void RemoveAt(size_t nDex, size_t nCount = 1)
+    {
+        ASSERT(nDex + nCount <= GetCount());
+        if (0 < nCount)
+        {
+            if (nDex + nCount < GetCount())
+            {   // the next field takes over the logical gaps of removed ones
+                tPos prevLog = (0 < nDex) ? GetLogPos(nDex - 1) : 0;
+                AddToGap(nDex + nCount, (tDelta)(GetLogPos(nDex + nCount - 1) - prevLog));
+            }
+            m_physTree.RemoveAt(2 * nDex, 2 * nCount);
+            m_logTree.RemoveAt(nDex, nCount);
+            m_ids.erase(m_ids.begin() + nDex, m_ids.begin() + nDex + nCount);
+            m_tags.erase(m_tags.begin() + nDex, m_tags.begin() + nDex + nCount);
+            m_stamp.Touch();
+        }
+    }
+
+    /// Changes the physical length of the field; following fields move accordingly
+    void SetLength(size_t nDex, tPos len)
+    {
+        ASSERT(nDex < GetCount());
+        m_physTree.Add(2 * nDex + 1, (tDelta)len - (tDelta)GetLength(nDex));
+    }
+
+    /// Sets the physical length of all fields to zero. Takes O(n).
+    void ResetLengths()
+    {
+        std::vector<tStoredPos> gaps;
+        std::vector<tStoredPos> items(2 * GetCount(), 0);
+
+        m_logTree.GetValues(gaps);
+        for (size_t ii = 0; ii < gaps.size(); ii++)
+        {
+            items[2 * ii] = gaps[ii];
+        }
+        m_physTree.Build(items.empty() ? NULL : &items[0], items.size());
+    }
+
+    /// Moves just the field nDex to the new logical position; the other fields stay where they are.
+    void SetLogPos(size_t nDex, tPos logPos)
+    {
+        tDelta delta = (tDelta)(logPos - GetLogPos(nDex));
+
+        ASSERT((0 == nDex) || (GetLogPos(nDex - 1) <= logPos));
+        ASSERT((nDex + 1 == GetCount()) || (logPos <= GetLogPos(nDex + 1)));
+        AddToGap(nDex, delta);
+        if (nDex + 1 < GetCount())
+        {
+            AddToGap(nDex + 1, -delta);
+        }
+        m_stamp.Touch();
+    }
+
+    /** Sets the logical positions ( ascending ) of all the fields at once; lengths of fields do not change.
+        Takes O(n log n), regardless how many fields move.
+    */
+    void SetAllLogPos(tPos const* lpLogPos, size_t nCount)
+    {
+        std::vector<tStoredPos> items(2 * nCount);
+        tPos prevLog = 0;
+
+        ASSERT(nCount == GetCount());
+        for (size_t ii = 0; ii < nCount; ii++)
+        {
+            ASSERT(prevLog <= lpLogPos[ii]);
+            items[2 * ii] = (tStoredPos)(lpLogPos[ii] - prevLog);
+            items[2 * ii + 1] = (tStoredPos)GetLength(ii);
+            prevLog = lpLogPos[ii];
+        }
+        m_physTree.Build(items.empty() ? NULL : &items[0], items.size());
+        m_logTree.Build(items.empty() ? NULL : &items[0], nCount, 2);
+        m_stamp.Touch();
+    }
+
+    /** Moves the fields [nDex, nDex + nCount) all to the same logical position logPos;
+        the other fields stay where they are.
+        The caller must keep the order, i.e. logPos must not be less than the position of nDex - 1,
+        and not greater than the position of nDex + nCount.
+    */
+    void SetLogPosRange(size_t nDex, size_t nCount, tPos logPos)
+    {
+        ASSERT(nDex + nCount <= GetCount());
+        if (0 < nCount)
+        {
+            tPos prevLog = (0 < nDex) ? GetLogPos(nDex - 1) : 0;
+            tPos lastLog = GetLogPos(nDex + nCount - 1);
+
+            ASSERT(prevLog <= logPos);
+            ASSERT((nDex + nCount == GetCount()) || (logPos <= GetLogPos(nDex + nCount)));
+            AddToGap(nDex, (tDelta)(logPos - prevLog) - (tDelta)GetGap(nDex));
+            for (size_t ii = nDex + 1; ii < nDex + nCount; ii++)
+            {
+                AddToGap(ii, -(tDelta)GetGap(ii));
+            }
+            if (nDex + nCount < GetCount())
+            {
+                AddToGap(nDex + nCount, (tDelta)(lastLog - logPos));
+            }
+            m_stamp.Touch();
+        }
+    }
+
+    /** Moves all the fields starting with the index nDex by the given ( possibly negative ) delta,
+        both logically and physically; this corresponds to text inserted or deleted before nDex.
+        Takes O(log n).
+    */
+    void ShiftFrom(size_t nDex, tDelta delta)
+    {
+        ASSERT(nDex <= GetCount());
+        if (nDex < GetCount())
+        {
+            ASSERT((0 <= delta) || ((tPos)(-delta) <= GetGap(nDex)));
+            AddToGap(nDex, delta);
+            m_stamp.Touch();
+        }
+    }
+
+    //// lower-level queries; return the index in range [0, GetCount()] ///
+    /// Returns the index of the first field with start >= pos
+    size_t LowerBoundStart(tPos pos) const
+    {   // count of prefixes less than pos, rounded to include the start of the field
+        return (m_physTree.CountLess(pos) + 1) / 2;
+    }
+    /// Returns the index of the first field with end > pos
+    size_t UpperBoundEnd(tPos pos) const
+    {
+        return m_physTree.CountNotGreater(pos) / 2;
+    }
+    /// Returns the index of the first field with logical position > pos
+    size_t UpperBoundLogPos(tPos pos) const
+    {
+        return m_logTree.CountNotGreater(pos);
+    }
+
+    //// position conversions //////////////////////////////////////////////
+    /// Converts physical position to logical, subtracting lengths of all fields ending before or on it
+    tPos PhysPos2LogPos(tPos physPos) const
+    {
+        return physPos - GetLengthBefore(UpperBoundEnd(physPos));
+    }
+
+    /// Converts logical position to physical, adding lengths of all fields located before or on it
+    tPos LogPos2PhysPos(tPos logPos) const
+    {
+        return logPos + GetLengthBefore(UpperBoundLogPos(logPos));
+    }
+
+    //// field queries; return -1 if not found /////////////////////////////
+    /// Finds the last field located before or on given pos ( i.e. with end <= pos )
+    tIndex FindLastEndingAtOrBefore(tPos pos) const
+    {
+        return (tIndex)UpperBoundEnd(pos) - 1;
+    }
+
+    /// Finds the first field located after or on given pos ( i.e. with start >= pos )
+    tIndex FindFirstStartingAtOrAfter(tPos pos) const
+    {
+        size_t nDex = LowerBoundStart(pos);
+        return (nDex < GetCount()) ? (tIndex)nDex : -1;
+    }
+
+    /// Finds the first field completely located in the range [start, end]
+    tIndex FindFirstInside(tPos start, tPos end) const
+    {
+        size_t nFirst;
+        return (0 < FindRangeInside(start, end, nFirst)) ? (tIndex)nFirst : -1;
+    }
+
+    /// Finds the field that contains pos in its interior ( i.e. start < pos < end )
+    tIndex FindContaining(tPos pos) const
+    {
+        size_t nDex = LowerBoundStart(pos);
+        if ((0 < nDex) && (pos < GetEnd(nDex - 1)))
+        {
+            return (tIndex)(nDex - 1);
+        }
+        return -1;
+    }
+
+    /** Finds all the fields completely located in the range [start, end]
+        ( i.e. start <= field start and field end <= end ).
+        Returns their count; the matching fields are those with index in [nFirst, nFirst + count).
+    */
+    size_t FindRangeInside(tPos start, tPos end, size_t &nFirst) const
+    {
+        size_t nLast = UpperBoundEnd(end);
+
+        nFirst = LowerBoundStart(start);
+        return (nFirst < nLast) ? (nLast - nFirst) : 0;
+    }
+
+    /** Finds all the fields overlapping the range [start, end)
+        ( i.e. field start < end and start < field end ).
+        Returns their count; the matching fields are those with index in [nFirst, nFirst + count).
+    */
+    size_t FindRangeOverlapping(tPos start, tPos end, size_t &nFirst) const
+    {
+        size_t nLast = LowerBoundStart(end);
+
+        nFirst = UpperBoundEnd(start);
+        return (nFirst < nLast) ? (nLast - nFirst) : 0;
+    }
+
+protected:
+    tStoredPos GetGap(size_t nDex) const
+    { return m_logTree.GetAt(nDex); }
+
+    void AddToGap(size_t nDex, tDelta delta)
+    {
+        m_physTree.Add(2 * nDex, delta);
+        m_logTree.Add(nDex, delta);
+    }
+};
+
+#ifdef __SUBSTFIELDINDEX_OWN_ASSERT__
+#undef ASSERT
+#undef __SUBSTFIELDINDEX_OWN_ASSERT__
+#endif
+
+#endif // __SUBSTFIELDINDEX_H__
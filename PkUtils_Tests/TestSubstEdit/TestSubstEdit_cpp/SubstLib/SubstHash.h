@@ -0,0 +1,214 @@
+/////////////////////////////////////////////////////////////////////////////
+// SubstHash.h : interface of the classes CSubstHash64 and CSubstHash128
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef __SUBSTHASH_H__
+#define __SUBSTHASH_H__
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDE FILES
+/////////////////////////////////////////////////////////////////////////////
+// Note: This header intentionally does not depend on MFC,
+// so it can be used ( and benchmarked ) outside of the MFC build as well.
+#include <stddef.h>
+#include <string.h>
+
+/////////////////////////////////////////////////////////////////////////////
+// CLASES
+/////////////////////////////////////////////////////////////////////////////
+
+/** CSubstHash64 computes the 64-bit hash of the data added piece by piece,
+    like the logical string and the fields of CSubstLogData.
+    The data are processed eight bytes at once, each word mixed by the finalizer of MurmurHash3.
+    The hash is not cryptographic; it is meant for the keys of caches.
+    The result depends on how the data are split to pieces; the pieces of variable length
+    should be added with their length ( see AddText ), so that different data do not give the same sequence.
+*/
+class CSubstHash64
+{
+public:
+    typedef unsigned long long tValue;
+
+protected:
+    tValue m_nState;
+    tValue m_nLength;
+
+public:
+    CSubstHash64() : m_nState(0x2545F4914F6CDD1DULL), m_nLength(0)
+    { }
+
+    /// Adds nBytes bytes of lpData
+    void Add(void const* lpData, size_t nBytes)
+    {
+        unsigned char const* lpBytes = static_cast<unsigned char const*>(lpData);
+        tValue nWord;
+
+        m_nLength += nBytes;
+        for (; 8 <= nBytes; lpBytes += 8, nBytes -= 8)
+        {
+            memcpy(&nWord, lpBytes, 8);
+            AddWord(nWord);
+        }
+        if (0 < nBytes)
+        {   // the tail is padded with zeroes; the length added by GetValue tells it apart
+            nWord = 0;
+            memcpy(&nWord, lpBytes, nBytes);
+            AddWord(nWord);
+        }
+    }
+
+    /// Adds the value of the type of fixed size, like the field id or the position
+    template<class TVALUE>
+    void AddValue(TVALUE const& value)
+    {
+        Add(&value, sizeof(value));
+    }
+
+    /// Adds the length of the text, and the text itself
+    template<class TCHARTYPE>
+    void AddText(TCHARTYPE const* lpText, size_t nLength)
+    {
+        AddValue(nLength);
+        Add(lpText, nLength * sizeof(TCHARTYPE));
+    }
+
+    tValue GetValue() const
+    {
+        return Mix(m_nState ^ m_nLength);
+    }
+
+    /// The finalizer of MurmurHash3; each bit of the result depends on all bits of nKey
+    static tValue Mix(tValue nKey)
+    {
+        nKey ^= nKey >> 33;
+        nKey *= 0xFF51AFD7ED558CCDULL;
+        nKey ^= nKey >> 33;
+        nKey *= 0xC4CEB9FE1A85EC53ULL;
+        nKey ^= nKey >> 33;
+        return nKey;
+    }
+
+protected:
+    void AddWord(tValue nWord)
+    {
+        m_nState ^= Mix(nWord);
+        m_nState = ((m_nState << 27) | (m_nState >> 37)) * 0x9E3779B97F4A7C15ULL + 0x52DCE729ULL;
+    }
+};
+
+/** CSubstHash128 computes the 128-bit fingerprint of the data added piece by piece,
+    like the logical string of CSubstLogData. The data are processed in blocks of 32 bytes,
+    each by four independent 64-bit lanes ( the rounds of xxHash64 ), so the lanes run in parallel
+    on superscalar CPUs, and the compiler may vectorize them; only the tail shorter than the block
+    is processed word by word. The lanes are merged into two halves of the result, mixed differently.
+    Like CSubstHash64, the result depends on how the data are split to pieces.
+*/
+class CSubstHash128
+{
+public:
+    /// The 128-bit value of the hash
+    struct tValue
+    {
+        unsigned long long nLow;
+        unsigned long long nHigh;
+
+        bool operator == (tValue const& rhs) const
+        { return (nLow == rhs.nLow) && (nHigh == rhs.nHigh); }
+        bool operator != (tValue const& rhs) const
+        { return !(*this == rhs); }
+    };
+
+    enum { tLanes = 4, tBlockSize = tLanes * 8 };
+
+protected:
+    unsigned long long m_lanes[tLanes];
+    unsigned long long m_nLength;
+
+public:
+    CSubstHash128() : m_nLength(0)
+    {
+        m_lanes[0] = Prime1() + Prime2();
+        m_lanes[1] = Prime2();
+        m_lanes[2] = 0;
+        m_lanes[3] = 0 - Prime1();
+    }
+
+    /// Adds nBytes bytes of lpData
+    void Add(void const* lpData, size_t nBytes)
+    {
+        unsigned char const* lpBytes = static_cast<unsigned char const*>(lpData);
+        unsigned long long   words[tLanes];
+        size_t               ii;
+
+        m_nLength += nBytes;
+        for (; tBlockSize <= nBytes; lpBytes += tBlockSize, nBytes -= tBlockSize)
+        {
+            memcpy(words, lpBytes, tBlockSize);
+            for (ii = 0; ii < tLanes; ii++)
+            {
+                m_lanes[ii] = Round(m_lanes[ii], words[ii]);
+            }
+        }
+        for (ii = 0; 0 < nBytes; ii++)
+        {   // the tail is padded with zeroes; the length added by GetValue tells it apart
+            size_t nWord = (8 < nBytes) ? 8 : nBytes;
+
+            words[0] = 0;
+            memcpy(words, lpBytes, nWord);
+            m_lanes[ii] = Round(m_lanes[ii], words[0]);
+            lpBytes += nWord;
+            nBytes -= nWord;
+        }
+    }
+
+    /// Adds the value of the type of fixed size, like the field id or the position
+    template<class TVALUE>
+    void AddValue(TVALUE const& value)
+    {
+        Add(&value, sizeof(value));
+    }
+
+    /// Adds the length of the text, and the text itself
+    template<class TCHARTYPE>
+    void AddText(TCHARTYPE const* lpText, size_t nLength)
+    {
+        AddValue(nLength);
+        Add(lpText, nLength * sizeof(TCHARTYPE));
+    }
+
+    /// Adds the fingerprint computed before, like the fingerprint of a part of the data
+    void AddFingerprint(tValue const& value)
+    {
+        AddValue(value.nLow);
+        AddValue(value.nHigh);
+    }
+
+    tValue GetValue() const
+    {
+        tValue result;
+
+        result.nLow = CSubstHash64::Mix(Rotl(m_lanes[0], 1) + Rotl(m_lanes[1], 7) + Rotl(m_lanes[2], 12) + 
+                                        Rotl(m_lanes[3], 18) + m_nLength);
+        result.nHigh = CSubstHash64::Mix((m_lanes[0] ^ Rotl(m_lanes[1], 29) ^ Rotl(m_lanes[2], 41) ^ 
+                                          Rotl(m_lanes[3], 53)) + m_nLength * Prime2() + result.nLow);
+        return result;
+    }
+
+protected:
+    static unsigned long long Prime1()
+    { return 0x9E3779B185EBCA87ULL; }
+    static unsigned long long Prime2()
+    { return 0xC2B2AE3D27D4EB4FULL; }
+
+    static unsigned long long Rotl(unsigned long long nValue, int nBits)
+    { return (nValue << nBits) | (nValue >> (64 - nBits)); }
+
+    static unsigned long long Round(unsigned long long nLane, unsigned long long nWord)
+    {
+        nLane += nWord * Prime2();
+        nLane = Rotl(nLane, 31);
+        return nLane * Prime1();
+    }
+};
+
+#endif // __SUBSTHASH_H__
@@ -8,14 +8,24 @@
 ///////////////////////////////////////////
 // INCLUDE FILES
 ///////////////////////////////////////////
+#include <mutex>
 #include "AfxTempl.h"
 #include "PkArray.h"
 
 ///////////////////////////////////////////
 // MANIFESTED CONSTANTS & MACROS
 ///////////////////////////////////////////
-#define    LOGINFO_VERSION                0
-#define    SUBSTLOGDATA_VERSION           0
+#define    LOGINFO_VERSION                1
+#define    SUBSTLOGDATA_VERSION           1
+
+#ifndef kInvalidSubstElemId
+#define kInvalidSubstElemId  0
+#endif
+
+// SubstConstMap needs the loops in constexpr constructors
+#if (__cplusplus >= 201402L) || (defined(_MSVC_LANG) && (_MSVC_LANG >= 201402L))
+#define SUBST_HAS_CONST_MAP
+#endif
 
 ///////////////////////////////////////////
 // TYPES
@@ -34,22 +44,186 @@ template<class TFIELDID> interface ISubstDescrProvider
     virtual SubstDescr<TFIELDID> const* GetSubstDescr() const = 0;
 };
 
+/** SubstMapIndex is the lookup table of one substitution map, 
+    finding the descriptor of the field id in O(1), and keeping the length of its text.
+    If the ids are small non-negative numbers ( as enum values usually are ), 
+    the table is indexed directly by the id; otherwise it is a hash table.
+    The index is shared by all SubstMapKeeper objects keeping the same map; it is built by the first of them
+    ( see AcquireIndex ), and deleted when the last of them releases the map ( see ReleaseIndex ).
+    Hence the map needs to be alive only as long as some keeper keeps it, and the same address
+    may be reused by another map later. The indexes are registered under a lock,
+    so that the keepers may be created and destroyed by several threads at once;
+    the index itself is not modified once it has been built.
+*/
+template<class TFIELDID> class SubstMapIndex
+{
+public:
+    struct tEntry
+    {
+        SubstDescr<TFIELDID> const* lpDescr;
+        size_t  nTxtLen;
+    };
+
+protected:
+    // the table indexed by the id, if used
+    CArray<tEntry, tEntry const&> m_dense;
+    CMap<TFIELDID, TFIELDID, tEntry, tEntry const&> m_hashed;
+    BOOL  m_bDense;
+
+public:
+    SubstMapIndex(SubstDescr<TFIELDID> const* lpMap);
+
+    tEntry const* Lookup(TFIELDID item) const;
+
+    static SubstMapIndex<TFIELDID> const* AcquireIndex(SubstDescr<TFIELDID> const* lpMap);
+    static void ReleaseIndex(SubstDescr<TFIELDID> const* lpMap);
+    static BOOL LookupRegistered(SubstDescr<TFIELDID> const* lpMap, TFIELDID item, SubstDescr<TFIELDID> const* &lpDescr);
+
+protected:
+    // The index of the map, and the count of keepers keeping the map
+    struct tRegistered
+    {
+        SubstMapIndex<TFIELDID>* lpIndex;
+        size_t  nRefs;
+    };
+
+    typedef CMap<SubstDescr<TFIELDID> const*, SubstDescr<TFIELDID> const*, 
+        tRegistered, tRegistered const&> tRegistryMap;
+
+    // The indexes of the maps kept, and the lock guarding them
+    class tRegistry
+    {
+    public:
+        std::mutex   m_lock;
+        tRegistryMap m_indexes;
+
+        ~tRegistry();
+    };
+    static tRegistry& Registry();
+};
+
+#ifdef SUBST_HAS_CONST_MAP
+/** SubstConstMap is the option for maps with enum ids known at compile time; 
+    it is the table indexed directly by the id ( a perfect hash ), created by the compiler:
+    <pre>
+    static constexpr SubstDescr<tagMyFields> s_map[] = { { IdField_Year, _T("<Year>") }, ... { IdField_NONE, NULL } };
+    static constexpr SubstConstMap<tagMyFields, IdField_Dog> s_table(s_map);
+    ...
+    logData.AssignSubstMap(s_table);
+    </pre>
+    The keeper of the table then uses it instead of the index of the map, and it registers no index.
+    The table must live as long as the keepers keeping it. If some id of the map exceeds NMAXID, 
+    the table is not complete, and the keeper uses the index of the map.
+*/
+template<class TFIELDID, size_t NMAXID> class SubstConstMap
+{
+protected:
+    SubstDescr<TFIELDID> const* m_lpMap;
+    SubstDescr<TFIELDID> const* m_slots[NMAXID + 1];
+    size_t  m_lengths[NMAXID + 1];
+    bool    m_bComplete;
+
+public:
+    template<size_t NCOUNT>
+    constexpr SubstConstMap(SubstDescr<TFIELDID> const (&map)[NCOUNT]) : 
+        m_lpMap(map), m_slots(), m_lengths(), m_bComplete(true)
+    {
+        for (size_t ii = 0; (ii < NCOUNT) && (kInvalidSubstElemId != map[ii].valId); ii++)
+        {
+            size_t nId = (size_t)map[ii].valId;
+            if (nId > NMAXID)
+            {
+                m_bComplete = false;
+            }
+            else if (NULL == m_slots[nId])
+            {   // the first descriptor of the id wins, as it does with SubstMapIndex
+                m_slots[nId] = &map[ii];
+                m_lengths[nId] = TextLength(map[ii].lpTxt);
+            }
+        }
+    }
+
+    constexpr SubstDescr<TFIELDID> const* GetMap() const
+    { return m_lpMap; }
+    constexpr bool IsComplete() const
+    { return m_bComplete; }
+    constexpr size_t GetSlotCount() const
+    { return NMAXID + 1; }
+    constexpr SubstDescr<TFIELDID> const* const* GetSlots() const
+    { return m_slots; }
+    constexpr size_t const* GetLengths() const
+    { return m_lengths; }
+
+    constexpr SubstDescr<TFIELDID> const* FindMapItem(TFIELDID item) const
+    { return ((size_t)item <= NMAXID) ? m_slots[(size_t)item] : NULL; }
+
+    constexpr size_t GetTextLength(TFIELDID item) const
+    { return ((size_t)item <= NMAXID) ? m_lengths[(size_t)item] : 0; }
+
+protected:
+    static constexpr size_t TextLength(LPCTSTR lpTxt)
+    {
+        size_t nLen = 0;
+        while (lpTxt[nLen])
+        {
+            nLen++;
+        }
+        return nLen;
+    }
+};
+#endif // SUBST_HAS_CONST_MAP
+
+/** SubstMapKeeper keeps the substitution map, and finds the descriptors of the fields in it;
+    either by the index of the map shared with other keepers ( see SubstMapIndex ),
+    or by the table of the map built by the compiler ( see SubstConstMap ).
+*/
 template<class TFIELDID> class SubstMapKeeper
 {
 protected:
     static SubstDescr<TFIELDID> const m_stdEmptyMap;
     SubstDescr<TFIELDID> const *m_lpMap;    // map of (field id) -> (field text)
+    SubstMapIndex<TFIELDID> const *m_lpIndex;  // index of m_lpMap, or NULL if the constant table is used
+    // the constant table of m_lpMap, if assigned
+    SubstDescr<TFIELDID> const* const* m_lpConstSlots;
+    size_t const* m_lpConstLengths;
+    size_t  m_nConstSlots;
 
 public:
     SubstMapKeeper();
     SubstMapKeeper(SubstDescr<TFIELDID> const *lpMap);
     SubstMapKeeper(SubstMapKeeper<TFIELDID> const &rhs);
+    ~SubstMapKeeper();
+
+    SubstMapKeeper<TFIELDID>& operator = (SubstMapKeeper<TFIELDID> const &rhs);
 
     SubstDescr<TFIELDID> const* GetSubstMap() const;
     void AssignSubstMap(SubstDescr<TFIELDID> const* lpMap);
+#ifdef SUBST_HAS_CONST_MAP
+    template<size_t NMAXID> void AssignSubstMap(SubstConstMap<TFIELDID, NMAXID> const &table)
+    {
+        if (table.IsComplete())
+        {
+            AssignConstTable(table.GetMap(), table.GetSlots(), table.GetLengths(), table.GetSlotCount());
+        }
+        else
+        {
+            ASSERT(FALSE);
+            AssignSubstMap(table.GetMap());
+        }
+    }
+#endif // SUBST_HAS_CONST_MAP
 
    static SubstDescr<TFIELDID> const* FindMapItem(SubstDescr<TFIELDID> const* lpMap, TFIELDID  item);
    SubstDescr<TFIELDID> const* FindMapItem(TFIELDID item) const;
+   SubstDescr<TFIELDID> const* FindMapItem(TFIELDID item, size_t &nTxtLen) const;
+
+protected:
+    void AssignConstTable(
+        SubstDescr<TFIELDID> const* lpMap,
+        SubstDescr<TFIELDID> const* const* lpSlots,
+        size_t const* lpLengths,
+        size_t  nSlots);
+    void ReleaseMap(void);
 };
 
 
@@ -9,9 +9,6 @@
 /////////////////////////////////////////////////////////////////////////////
 // MANIFESTED CONSTANTS & MACROS
 /////////////////////////////////////////////////////////////////////////////
-#ifndef kInvalidSubstElemId
-#define kInvalidSubstElemId  0
-#endif
 
 /////////////////////////////////////////////////////////////////////////////
 // PRIVATE SYMBOLS
@@ -25,22 +22,234 @@ SubstDescr<TFIELDID> const SubstMapKeeper<TFIELDID>::m_stdEmptyMap = {
 // CLASS DEFINITIONS
 /////////////////////////////////////////////////////////////////////////////
 
+////////////////////////////////////////////
+// SubstMapIndex
+
+template<class TFIELDID> 
+SubstMapIndex<TFIELDID>::SubstMapIndex(SubstDescr<TFIELDID> const* lpMap)
+{
+    SubstDescr<TFIELDID> const* lpTmp;
+    INT_PTR  nCount = 0, nMaxId = 0, nId;
+    tEntry   entry;
+
+    for (lpTmp = lpMap; kInvalidSubstElemId != lpTmp->valId; lpTmp++)
+    {
+        nId = (INT_PTR)lpTmp->valId;
+        if (nId < 0)
+        {
+            nMaxId = -1;
+            break;
+        }
+        if (nId > nMaxId)
+        {
+            nMaxId = nId;
+        }
+        nCount++;
+    }
+    // use the direct table if it is not too sparse
+    if (m_bDense = ((0 <= nMaxId) && (nMaxId <= 4 * nCount + 64)))
+    {
+        entry.lpDescr = NULL;
+        entry.nTxtLen = 0;
+        m_dense.SetSize(nMaxId + 1);
+        for (nId = 0; nId <= nMaxId; nId++)
+        {
+            m_dense[nId] = entry;
+        }
+    }
+    else
+    {
+        m_hashed.InitHashTable((UINT)(nCount + nCount / 4 + 17));
+    }
+    for (lpTmp = lpMap; kInvalidSubstElemId != lpTmp->valId; lpTmp++)
+    {   // the first descriptor of the id wins, as it did with the linear search
+        ASSERT(lpTmp->lpTxt);
+        entry.lpDescr = lpTmp;
+        entry.nTxtLen = _tcslen(lpTmp->lpTxt);
+        if (m_bDense)
+        {
+            if (NULL == m_dense[(INT_PTR)lpTmp->valId].lpDescr)
+            {
+                m_dense[(INT_PTR)lpTmp->valId] = entry;
+            }
+        }
+        else if (NULL == m_hashed.PLookup(lpTmp->valId))
+        {
+            m_hashed.SetAt(lpTmp->valId, entry);
+        }
+    }
+}
+
+template<class TFIELDID> 
+typename SubstMapIndex<TFIELDID>::tEntry const* SubstMapIndex<TFIELDID>::Lookup(TFIELDID item) const
+{
+    tEntry const* lpEntry = NULL;
+
+    if (kInvalidSubstElemId == item)
+    {
+        ASSERT(FALSE);
+    }
+    else if (m_bDense)
+    {
+        INT_PTR nId = (INT_PTR)item;
+        if ((0 <= nId) && (nId < m_dense.GetSize()) && (NULL != m_dense[nId].lpDescr))
+        {
+            lpEntry = &m_dense[nId];
+        }
+    }
+    else
+    {
+        typename CMap<TFIELDID, TFIELDID, tEntry, tEntry const&>::CPair const* lpPair;
+        if (NULL != (lpPair = m_hashed.PLookup(item)))
+        {
+            lpEntry = &lpPair->value;
+        }
+    }
+    return lpEntry;
+}
+
+template<class TFIELDID> 
+/*static */ typename SubstMapIndex<TFIELDID>::tRegistry& SubstMapIndex<TFIELDID>::Registry()
+{
+    static tRegistry s_registry;
+    return s_registry;
+}
+
+// The indexes still registered on exit are those of keepers destroyed later, if any; they are deleted anyway
+template<class TFIELDID> 
+SubstMapIndex<TFIELDID>::tRegistry::~tRegistry()
+{
+    typename tRegistryMap::CPair const* lpPair;
+
+    for (lpPair = m_indexes.PGetFirstAssoc(); NULL != lpPair; lpPair = m_indexes.PGetNextAssoc(lpPair))
+    {
+        delete lpPair->value.lpIndex;
+    }
+}
+
+// Returns the index of the map, building it if no keeper keeps the map yet;
+// each call must be paired with ReleaseIndex
+template<class TFIELDID> 
+/*static */ SubstMapIndex<TFIELDID> const* SubstMapIndex<TFIELDID>::AcquireIndex(SubstDescr<TFIELDID> const* lpMap)
+{
+    tRegistry& registry = Registry();
+    typename tRegistryMap::CPair* lpPair;
+    tRegistered registered;
+
+    if (NULL == lpMap)
+    {
+        ASSERT(FALSE);
+        return NULL;
+    }
+    std::lock_guard<std::mutex> lock(registry.m_lock);
+
+    if (NULL != (lpPair = registry.m_indexes.PLookup(lpMap)))
+    {
+        lpPair->value.nRefs++;
+        return lpPair->value.lpIndex;
+    }
+    registered.lpIndex = new SubstMapIndex<TFIELDID>(lpMap);
+    registered.nRefs = 1;
+    registry.m_indexes.SetAt(lpMap, registered);
+    return registered.lpIndex;
+}
+
+// Releases the index acquired by AcquireIndex; the index is deleted when the last keeper of the map releases it
 template<class TFIELDID> 
-SubstMapKeeper<TFIELDID>::SubstMapKeeper()
+/*static */ void SubstMapIndex<TFIELDID>::ReleaseIndex(SubstDescr<TFIELDID> const* lpMap)
+{
+    tRegistry& registry = Registry();
+    typename tRegistryMap::CPair* lpPair;
+    SubstMapIndex<TFIELDID>* lpIndex = NULL;
+
+    if (NULL != lpMap)
+    {
+        std::lock_guard<std::mutex> lock(registry.m_lock);
+
+        if (NULL == (lpPair = registry.m_indexes.PLookup(lpMap)))
+        {
+            ASSERT(FALSE);
+        }
+        else if (0 == --lpPair->value.nRefs)
+        {
+            lpIndex = lpPair->value.lpIndex;
+            registry.m_indexes.RemoveKey(lpMap);
+        }
+    }
+    delete lpIndex;
+}
+
+// Finds the descriptor of the item by the index of lpMap, if some keeper keeps lpMap;
+// returns FALSE if none does, so that the caller searches the map itself
+template<class TFIELDID> 
+/*static */ BOOL SubstMapIndex<TFIELDID>::LookupRegistered(
+    SubstDescr<TFIELDID> const* lpMap, 
+    TFIELDID  item, 
+    SubstDescr<TFIELDID> const* &lpDescr)
+{
+    tRegistry& registry = Registry();
+    typename tRegistryMap::CPair const* lpPair;
+    tEntry const* lpEntry;
+
+    lpDescr = NULL;
+    if (NULL != lpMap)
+    {   // the lock is held by the lookup, so that the index is not released meanwhile
+        std::lock_guard<std::mutex> lock(registry.m_lock);
+
+        if (NULL != (lpPair = registry.m_indexes.PLookup(lpMap)))
+        {
+            if (NULL != (lpEntry = lpPair->value.lpIndex->Lookup(item)))
+            {
+                lpDescr = lpEntry->lpDescr;
+            }
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+////////////////////////////////////////////
+// SubstMapKeeper
+
+template<class TFIELDID> 
+SubstMapKeeper<TFIELDID>::SubstMapKeeper() : 
+    m_lpMap(NULL), m_lpIndex(NULL), m_lpConstSlots(NULL), m_lpConstLengths(NULL), m_nConstSlots(0)
 {
     AssignSubstMap(&m_stdEmptyMap);
 }
 
 template<class TFIELDID> 
-SubstMapKeeper<TFIELDID>::SubstMapKeeper(SubstDescr<TFIELDID> const *lpMap)
+SubstMapKeeper<TFIELDID>::SubstMapKeeper(SubstDescr<TFIELDID> const *lpMap) : 
+    m_lpMap(NULL), m_lpIndex(NULL), m_lpConstSlots(NULL), m_lpConstLengths(NULL), m_nConstSlots(0)
 {
     AssignSubstMap(lpMap);
 }
 
 template<class TFIELDID> 
-SubstMapKeeper<TFIELDID>::SubstMapKeeper(SubstMapKeeper const &rhs)
+SubstMapKeeper<TFIELDID>::SubstMapKeeper(SubstMapKeeper const &rhs) : 
+    m_lpMap(NULL), m_lpIndex(NULL), m_lpConstSlots(NULL), m_lpConstLengths(NULL), m_nConstSlots(0)
 {
-    AssignSubstMap(rhs.GetSubstMap());
+    *this = rhs;
+}
+
+template<class TFIELDID> 
+SubstMapKeeper<TFIELDID>::~SubstMapKeeper()
+{
+    ReleaseMap();
+}
+
+template<class TFIELDID> 
+SubstMapKeeper<TFIELDID>& SubstMapKeeper<TFIELDID>::operator = (SubstMapKeeper<TFIELDID> const &rhs)
+{
+    if (NULL != rhs.m_lpConstSlots)
+    {
+        AssignConstTable(rhs.m_lpMap, rhs.m_lpConstSlots, rhs.m_lpConstLengths, rhs.m_nConstSlots);
+    }
+    else
+    {
+        AssignSubstMap(rhs.GetSubstMap());
+    }
+    return *this;
 }
 
 template<class TFIELDID> 
@@ -49,13 +258,58 @@ SubstDescr<TFIELDID> const* SubstMapKeeper<TFIELDID>::GetSubstMap() const
     return m_lpMap;
 }
 
+// Keeps the map lpMap, releasing the map kept so far. 
+// If the constant table of lpMap is kept already, it is used further.
 template<class TFIELDID> 
 void SubstMapKeeper<TFIELDID>::AssignSubstMap(SubstDescr<TFIELDID> const* lpMap)
 {
     ASSERT(lpMap != NULL);
-    m_lpMap = lpMap;
+    if (lpMap != m_lpMap)
+    {   // acquired first, so that the index shared by both is not deleted meanwhile
+        SubstMapIndex<TFIELDID> const* lpIndex = SubstMapIndex<TFIELDID>::AcquireIndex(lpMap);
+
+        ReleaseMap();
+        m_lpMap = lpMap;
+        m_lpIndex = lpIndex;
+    }
+}
+
+// Keeps the map lpMap, found by its constant table; no index of the map is acquired
+template<class TFIELDID> 
+void SubstMapKeeper<TFIELDID>::AssignConstTable(
+    SubstDescr<TFIELDID> const* lpMap,
+    SubstDescr<TFIELDID> const* const* lpSlots,
+    size_t const* lpLengths,
+    size_t  nSlots)
+{
+    ASSERT((NULL != lpMap) && (NULL != lpSlots) && (NULL != lpLengths));
+    if (lpSlots != m_lpConstSlots)
+    {
+        ReleaseMap();
+        m_lpMap = lpMap;
+        m_lpConstSlots = lpSlots;
+        m_lpConstLengths = lpLengths;
+        m_nConstSlots = nSlots;
+    }
+}
+
+// Releases the index of the map kept, if acquired, and forgets the map
+template<class TFIELDID> 
+void SubstMapKeeper<TFIELDID>::ReleaseMap(void)
+{
+    if (NULL != m_lpIndex)
+    {
+        SubstMapIndex<TFIELDID>::ReleaseIndex(m_lpMap);
+    }
+    m_lpMap = NULL;
+    m_lpIndex = NULL;
+    m_lpConstSlots = NULL;
+    m_lpConstLengths = NULL;
+    m_nConstSlots = 0;
 }
 
+// Finds the descriptor of the item in lpMap. The lookup is O(1) if some keeper keeps the index of lpMap; 
+// otherwise the map is searched linearly, and no index is built.
 template<class TFIELDID> 
 /*static */ SubstDescr<TFIELDID> const* SubstMapKeeper<TFIELDID>::FindMapItem(
     SubstDescr<TFIELDID> const* lpMap, 
@@ -64,6 +318,10 @@ template<class TFIELDID>
     TFIELDID  tmp_item;
     SubstDescr<TFIELDID> const* lpTmp;
 
+    if (SubstMapIndex<TFIELDID>::LookupRegistered(lpMap, item, lpTmp))
+    {
+        return lpTmp;
+    }
     if ((kInvalidSubstElemId != item) && (lpTmp = lpMap))
     {
         for(;;lpTmp++)
@@ -89,5 +347,33 @@ template<class TFIELDID>
 template<class TFIELDID> 
 SubstDescr<TFIELDID> const* SubstMapKeeper<TFIELDID>::FindMapItem(TFIELDID item) const
 {
-    return FindMapItem(GetSubstMap(), item);
+    size_t nTxtLen;
+    return FindMapItem(item, nTxtLen);
+}
+
+// Finds the descriptor of the item, and the length of its text
+template<class TFIELDID> 
+SubstDescr<TFIELDID> const* SubstMapKeeper<TFIELDID>::FindMapItem(TFIELDID item, size_t &nTxtLen) const
+{
+    typename SubstMapIndex<TFIELDID>::tEntry const* lpEntry;
+    size_t nId;
+
+    if (NULL != m_lpConstSlots)
+    {
+        ASSERT(kInvalidSubstElemId != item);
+        if (((nId = (size_t)item) < m_nConstSlots) && (NULL != m_lpConstSlots[nId]))
+        {
+            nTxtLen = m_lpConstLengths[nId];
+            return m_lpConstSlots[nId];
+        }
+        nTxtLen = 0;
+        return NULL;
+    }
+    if (NULL == (lpEntry = m_lpIndex->Lookup(item)))
+    {
+        nTxtLen = 0;
+        return NULL;
+    }
+    nTxtLen = lpEntry->nTxtLen;
+    return lpEntry->lpDescr;
 }
@@ -8,16 +8,29 @@
 /////////////////////////////////////////////////////////////////////////////
 // INCLUDE FILES
 /////////////////////////////////////////////////////////////////////////////
+#include <mutex>
 #include "AfxTempl.h"
 #include "PkArray.h"
 #include "SubstMapping.h"
 #include "RuntimeTpt.h"
+#include "SubstFieldIndex.h"
+#include "SubstRecognizer.h"
+#include "SubstTextSearch.h"
+#include "SubstTextSink.h"
+#include "SubstRenderPlan.h"
+#include "SubstRenderContext.h"
+#include "SubstTemplateProgram.h"
+#include "SubstRenderCache.h"
+#include "SubstText.h"
+#include "SubstValidation.h"
 
 /////////////////////////////////////////////////////////////////////////////
 // MANIFESTED CONSTANTS & MACROS
 /////////////////////////////////////////////////////////////////////////////
-#define    LOGINFO_VERSION                0
-#define    SUBSTLOGDATA_VERSION           0
+// Version 1 of CLogInfo keeps its kind ( see ESubstLogInfoKind ).
+// Version 1 of CSubstLogData may contain sections; their markers are kept by the log list.
+#define    LOGINFO_VERSION                1
+#define    SUBSTLOGDATA_VERSION           1
 
 /////////////////////////////////////////////////////////////////////////////
 // TYPES
@@ -30,6 +43,22 @@ template<class TFIELDID> class CSubstLogData;
 #define tSubstLogDataPredecessor  CObject
 typedef size_t                    tLogPos;
 
+/// What CLogInfo stands for. The markers of sections are interpreted only by the template program
+/// ( see CSubstLogData::GetTemplateProgram ). The physical data display them like fields, with their texts of the map;
+/// the renderings with other field texts leave them out, and the plain text keeps them as "<?if text?>",
+/// "<?repeat text?>" and "<?end text?>" ( see CSubstLogData::WritePlainText ).
+enum ESubstLogInfoKind
+{
+    /// the field
+    eLogInfoField,
+    /// begins the section written only if the field has a text
+    eLogInfoIf,
+    /// begins the section repeated for each item of the field
+    eLogInfoRepeat,
+    /// ends the section begun last
+    eLogInfoEnd,
+};
+
 #ifndef kInvalidSubstElemId
 #define kInvalidSubstElemId  0
 #endif
@@ -40,6 +69,10 @@ typedef size_t                    tLogPos;
 
 /** CLogInfo is a logical coordinate of field
   "Logical" coordinates do not include interior length of fields.
+  The fields of CSubstLogData are kept by its field index ( see CSubstFieldIndex ); 
+  CLogInfo is just the value of one of them, built on demand by CSubstLogData::GetLogInfo, 
+  or passed to CSubstLogData::AppendLogInfo and InsertLogInfo.
+  It remains a serializable CObject, as the archive keeps the list of them.
 */
 template<class TFIELDID> class CLogInfo : public tLogInfoPredecessor
 {
@@ -48,6 +81,8 @@ template<class TFIELDID> class CLogInfo : public tLogInfoPredecessor
 protected:
     // The field ID
     TFIELDID m_what;
+    // The field, or the marker of section
+    ESubstLogInfoKind m_kind;
     // The logical position in the string; the index is considered without displayed body of fields.
     // When computing logical position, the 'ordinary' character has a length 1, 
     // while the (complete) field has a length 0.
@@ -58,7 +93,8 @@ protected:
 public:
     CLogInfo();
     CLogInfo(TFIELDID what);
-    CLogInfo(TFIELDID what, tLogPos pos);
+    CLogInfo(TFIELDID what, tLogPos pos, ESubstLogInfoKind kind = eLogInfoField);
+    CLogInfo(CLogInfo<TFIELDID> const& rhs);
     virtual ~CLogInfo();
 
     TFIELDID  What(void) const
@@ -66,6 +102,13 @@ public:
     void  SetWhat(TFIELDID id) 
     { m_what = id; }
 
+    ESubstLogInfoKind GetKind(void) const
+    { return m_kind; }
+    void  SetKind(ESubstLogInfoKind kind) 
+    { m_kind = kind; }
+    BOOL IsField(void) const
+    { return (eLogInfoField == m_kind); }
+
     tLogPos const GetPos(void) const
     { return m_pos; }
     void SetPos(tLogPos pos) 
@@ -84,6 +127,7 @@ public:
 
 /** CLogInfoList teplate is actually just a nickname for CPkTypedPtrArray of CLogInfo<TFIELDID>*
     Its purpose is making long syntax more simple.
+    CSubstLogData uses it just for the serialization of its fields.
 */
 template<class TFIELDID> class CLogInfoList : public CPkTypedPtrArray<CObArray, CLogInfo<TFIELDID>*>
 {
@@ -95,20 +139,128 @@ template<class TFIELDID> class CLogInfoList : public CPkTypedPtrArray<CObArray,
 template<class TFIELDID> class CSubstLogData : public tSubstLogDataPredecessor
 {
 	DECLARE_SERIAL_T(CSubstLogData, TFIELDID);
+    // the field id is kept by the field index
+    static_assert(sizeof(TFIELDID) <= sizeof(CSubstFieldIndex::tStoredId), "TFIELDID does not fit the field index");
 
 public:
     typedef CString CALLBACK fnDescrToText(SubstDescr<TFIELDID> const* lpDescr);
     typedef fnDescrToText *lpfnDescrToText;
+    /// Returns the text of the field and its length without a copy; 
+    /// the text must remain valid until LogStrToPhysStr returns.
+    typedef LPCTSTR CALLBACK fnDescrToView(SubstDescr<TFIELDID> const* lpDescr, size_t &nLength);
+    typedef fnDescrToView *lpfnDescrToView;
 
 protected:
     // the logical string ( text without fields )
-    CString       m_logStr; 
-    // list of log. positions
-    CLogInfoList<TFIELDID> m_logList;
+    CSubstText    m_logStr; 
+    // the fields: their log. positions, ids and kinds ( and lengths, if displayed )
+    CSubstFieldIndex       m_fieldIndex;
 
 private:
     // map of (field id) -> (field text)
     SubstMapKeeper<TFIELDID> m_map;
+    // guards the members below, compiled lazily by const methods, so that the same data
+    // may be rendered by several threads at once ( while no thread modifies them )
+    mutable std::mutex m_compileLock;
+    // the render plan compiled last; see GetRenderPlan
+    mutable CSubstRenderPlan<TFIELDID> m_renderPlan;
+    // the template program compiled last; see GetTemplateProgram
+    mutable CSubstTemplateProgram<TFIELDID> m_program;
+    // the fingerprint of a part of the contents computed last, and the stamp of the part 
+    // it has been computed of; see GetFingerprint
+    struct tFingerprint
+    {
+        bool bValid;
+        CSubstEditStamp::tValue nStamp;
+        CSubstHash128::tValue   value;
+
+        tFingerprint() : bValid(false), nStamp(0)
+        { value.nLow = value.nHigh = 0; }
+    };
+    // the fingerprints of the logical string, and of the fields
+    mutable tFingerprint m_textFingerprint;
+    mutable tFingerprint m_fieldsFingerprint;
+
+protected:
+    // The xml special characters, and their entities
+    enum { tXmlEntities = 5 };
+    static TCHAR const   m_xmlChars[tXmlEntities];
+    static LPCTSTR const m_xmlEntities[tXmlEntities];
+    // The plain text of the marker of a section is the prefix of its kind, the text of its field and the suffix
+    static LPCTSTR const m_markerPrefixes[eLogInfoEnd + 1];
+    static LPCTSTR const m_markerSuffix;
+
+    // The part of logical text to be replaced by ReplaceLogTextParts
+    struct tLogTextPart
+    {
+        tLogPos nStart;
+        size_t  nOldLength;
+        LPCTSTR lpNewText;
+        size_t  nNewLength;
+    };
+
+    // Provides the field texts for the render plan collected in advance, one per slot
+    class CCollectedTextViews : public std::vector<tSubstTextView>
+    {
+    public:
+        BOOL GetView(size_t nSlot, typename CSubstRenderPlan<TFIELDID>::tSlot const&, tSubstTextView &view) const
+        {
+            view = (*this)[nSlot];
+            return (NULL != view.lpText);
+        }
+    };
+
+    // Provides the field texts for the render plan written to the sink, got from lpFn one by one
+    class CDescrToTextViews
+    {
+    protected:
+        lpfnDescrToText m_lpFn;
+        CString         m_strText;
+    public:
+        CDescrToTextViews(lpfnDescrToText lpFn) : m_lpFn(lpFn)
+        { }
+        BOOL GetView(size_t, typename CSubstRenderPlan<TFIELDID>::tSlot const& slot, tSubstTextView &view)
+        {
+            if (NULL == slot.lpDescr)
+                return FALSE;
+            m_strText = (*m_lpFn)(slot.lpDescr);
+            view.lpText = m_strText;
+            view.nLength = (size_t)m_strText.GetLength();
+            return TRUE;
+        }
+    };
+
+    // Provides the field texts for the render plan written to the sink, got from lpFn one by one
+    class CDescrToViewViews
+    {
+    protected:
+        lpfnDescrToView m_lpFn;
+    public:
+        CDescrToViewViews(lpfnDescrToView lpFn) : m_lpFn(lpFn)
+        { }
+        BOOL GetView(size_t, typename CSubstRenderPlan<TFIELDID>::tSlot const& slot, tSubstTextView &view)
+        {
+            view.nLength = 0;
+            view.lpText = (NULL != slot.lpDescr) ? (*m_lpFn)(slot.lpDescr, view.nLength) : NULL;
+            return (NULL != view.lpText);
+        }
+    };
+
+    // Provides the field texts for the render plan written to the sink, got from the context one by one
+    class CContextViews
+    {
+    protected:
+        CSubstRenderContext<TFIELDID>& m_context;
+    public:
+        CContextViews(CSubstRenderContext<TFIELDID> &context) : m_context(context)
+        { }
+        BOOL GetView(size_t, typename CSubstRenderPlan<TFIELDID>::tSlot const& slot, tSubstTextView &view)
+        {
+            view.nLength = 0;
+            view.lpText = (NULL != slot.lpDescr) ? m_context.GetFieldText(slot.lpDescr, view.nLength) : NULL;
+            return (NULL != view.lpText);
+        }
+    };
 
 public:
     CSubstLogData();
@@ -119,14 +271,23 @@ public:
     virtual ~CSubstLogData();
 
     LPCTSTR GetLogStr(void) const
-    { return m_logStr; }
+    { return m_logStr.GetString(); }
+    size_t GetLogLength(void) const
+    { return m_logStr.GetLength(); }
     void  SetLogStr(LPCTSTR szLogStr)
-    { m_logStr = szLogStr; }
-
-    CLogInfoList<TFIELDID> &LogList()
-    { return m_logList; }
-    CLogInfoList<TFIELDID> const & LogListC() const
-    { return m_logList; }
+    { m_logStr.Assign(szLogStr); }
+
+    INT_PTR GetLogInfoCount() const
+    { return (INT_PTR)m_fieldIndex.GetCount(); }
+    TFIELDID GetLogInfoWhat(INT_PTR nIndex) const
+    { return (TFIELDID)m_fieldIndex.GetId((size_t)nIndex); }
+    tLogPos GetLogInfoPos(INT_PTR nIndex) const
+    { return m_fieldIndex.GetLogPos((size_t)nIndex); }
+    ESubstLogInfoKind GetLogInfoKind(INT_PTR nIndex) const
+    { return (ESubstLogInfoKind)m_fieldIndex.GetTag((size_t)nIndex); }
+    CLogInfo<TFIELDID> GetLogInfo(INT_PTR nIndex) const
+    { return CLogInfo<TFIELDID>(GetLogInfoWhat(nIndex), GetLogInfoPos(nIndex), GetLogInfoKind(nIndex)); }
+    void SetLogInfo(INT_PTR nIndex, CLogInfo<TFIELDID> const& logInfo);
 
     SubstDescr<TFIELDID> const* GetSubstMap(void) const
     { 
@@ -137,31 +298,70 @@ public:
         ASSERT(lpMap); 
         m_map.AssignSubstMap(lpMap); 
     }
+    void AssignSubstMap(SubstMapKeeper<TFIELDID> const& mapKeeper)
+    { 
+        m_map = mapKeeper; 
+    }
+#ifdef SUBST_HAS_CONST_MAP
+    template<size_t NMAXID> void AssignSubstMap(SubstConstMap<TFIELDID, NMAXID> const& table)
+    { 
+        m_map.AssignSubstMap(table); 
+    }
+#endif // SUBST_HAS_CONST_MAP
 
-    void ClearContentsLogical(void);
+    virtual void  ClearContentsLogical(void);
     virtual void  DeleteContents();
 
-    INT_PTR GetLogInfoIndex(CLogInfo<TFIELDID> const* lpPos) const;
     SubstDescr<TFIELDID> const* FindMapItem(TFIELDID item) const;
+    SubstDescr<TFIELDID> const* FindMapItem(TFIELDID item, size_t &nTxtLen) const;
 
-    CLogInfo<TFIELDID>* AppenNewLogInfo(TFIELDID  what);
-    INT_PTR AppendLogInfo(CLogInfo<TFIELDID> const* lpLogInfo);
-    void    InsertLogInfo(INT_PTR indexBefore, CLogInfo<TFIELDID>* lpLogInfo);
-    void    InsertLogInfo(CLogInfo<TFIELDID>* lpLogInfoBefore, CLogInfo<TFIELDID>* lpLogInfo);
+    INT_PTR AppenNewLogInfo(TFIELDID  what);
+    INT_PTR AppenNewLogInfo(TFIELDID  what, tLogPos pos, ESubstLogInfoKind kind = eLogInfoField);
+    INT_PTR AppendLogInfo(CLogInfo<TFIELDID> const& logInfo);
+    INT_PTR InsertLogInfo(INT_PTR indexBefore, CLogInfo<TFIELDID> const& logInfo);
+    void    InsertLogInfo(INT_PTR indexBefore, std::vector<CLogInfo<TFIELDID> > const &infos);
 
-    void   RemoveLogInfo(INT_PTR nIndex);
-    BOOL   RemoveLogInfo(CLogInfo<TFIELDID> const*lpLogInfo);
+    void   RemoveLogInfo(INT_PTR nIndex, INT_PTR nCount = 1);
 
     static CString LogStrToPhysStr(CSubstLogData<TFIELDID> const &logData, lpfnDescrToText lpFn);
+    static CString LogStrToPhysStr(CSubstLogData<TFIELDID> const &logData, lpfnDescrToView lpFn);
+    static CString LogStrToPhysStr(CSubstLogData<TFIELDID> const &logData, CSubstRenderContext<TFIELDID> &context);
+    static CString LogStrToPhysStr(CSubstLogData<TFIELDID> const &logData, ISubstTemplateValues<TFIELDID> &values);
     static CString LogStr2PhysStr(CSubstLogData<TFIELDID> const &logData);
 
-    virtual void Assign(CSubstLogData<TFIELDID> const &rhs);
-    virtual void AssignPlainText(LPCTSTR szText);
+    // Rendering through the cache; the string is composed only if the cache does not keep it already
+    static CString LogStrToPhysStr(CSubstLogData<TFIELDID> const &logData, lpfnDescrToText lpFn, CSubstRenderCache &cache);
+    static CString LogStrToPhysStr(CSubstLogData<TFIELDID> const &logData, lpfnDescrToView lpFn, CSubstRenderCache &cache);
+    static CString LogStrToPhysStr(CSubstLogData<TFIELDID> const &logData, CSubstRenderContext<TFIELDID> &context, 
+                                   CSubstRenderCache &cache);
+
+    // Rendering to the sink, in chunks; the memory needed does not depend on the length of the output
+    static void LogStrToPhysStr(CSubstLogData<TFIELDID> const &logData, ISubstTextSink &sink);
+    static void LogStrToPhysStr(CSubstLogData<TFIELDID> const &logData, lpfnDescrToText lpFn, ISubstTextSink &sink);
+    static void LogStrToPhysStr(CSubstLogData<TFIELDID> const &logData, lpfnDescrToView lpFn, ISubstTextSink &sink);
+    static void LogStrToPhysStr(CSubstLogData<TFIELDID> const &logData, CSubstRenderContext<TFIELDID> &context, 
+                                ISubstTextSink &sink);
+    static void LogStrToPhysStr(CSubstLogData<TFIELDID> const &logData, ISubstTemplateValues<TFIELDID> &values, 
+                                ISubstTextSink &sink);
 
+    virtual void Assign(CSubstLogData<TFIELDID> const &rhs);
+    virtual void AssignPlainText(LPCTSTR szText, BOOL bIgnoreCase = FALSE);
+    virtual INT_PTR ReplaceLogTextAll(LPCTSTR szOldPart, LPCTSTR szNewPart);
+
+    CSubstRenderPlan<TFIELDID> const& GetRenderPlan() const;
+    CSubstTemplateProgram<TFIELDID> const& GetTemplateProgram() const;
+    CSubstHash128::tValue GetFingerprint() const;
+    CSubstHash64::tValue GetContentHash() const;
+    BOOL    IsEqual(CSubstLogData<TFIELDID> const &rhs) const;
     CString GetPlainText() const;
+    void    WritePlainText(ISubstTextSink &sink) const;
 
     CSubstLogData<TFIELDID> & operator = (LPCTSTR szLogStr);
     CSubstLogData<TFIELDID> & operator = (CSubstLogData<TFIELDID> const & rhs);
+    bool operator == (CSubstLogData<TFIELDID> const & rhs) const
+    { return FALSE != IsEqual(rhs); }
+    bool operator != (CSubstLogData<TFIELDID> const & rhs) const
+    { return FALSE == IsEqual(rhs); }
 
     void   Serialize(CArchive& ar);
 
@@ -169,12 +369,30 @@ protected:
     SubstMapKeeper<TFIELDID> const& MapKeeper() const
     { return m_map; }
 
+    void    CollectTextViews(lpfnDescrToText lpFn, std::vector<CString> &texts, CCollectedTextViews &views) const;
+    void    CollectTextViews(lpfnDescrToView lpFn, CCollectedTextViews &views) const;
+    void    CollectTextViews(CSubstRenderContext<TFIELDID> &context, CCollectedTextViews &views) const;
+    CString RenderCached(CCollectedTextViews const& views, CSubstRenderCache &cache) const;
+
+    static CSubstFieldIndex::tStoredId StoredId(TFIELDID what)
+    { return (CSubstFieldIndex::tStoredId)what; }
+    static CSubstFieldIndex::tStoredTag StoredTag(ESubstLogInfoKind kind)
+    { return (CSubstFieldIndex::tStoredTag)kind; }
+
     void  AssignSerializableData(CSubstLogData<TFIELDID> const & what);
-    void  AssignLogList(CPkTypedPtrArray<CObArray, CLogInfo<TFIELDID>*>  const &list);
+    void  AssignLogList(CSubstLogData<TFIELDID> const & what);
+    BOOL  IsLogListEqual(CSubstLogData<TFIELDID> const & what) const;
+    CSubstHash128::tValue GetTextFingerprint() const;
+    CSubstHash128::tValue GetFieldsFingerprint() const;
+    void  CopyLogList(CLogInfoList<TFIELDID> &list) const;
+    void  RebuildFieldIndex(CLogInfoList<TFIELDID> const &list);
     void  ReplaceLogXmlCharsThere();
     void  ReplaceLogXmlPartsBack();
+    void  ReplaceLogXmlEntities(BOOL bEscape);
     virtual void ReplaceLogTextPart(tLogPos startIndex, int nReplacedLenght, LPCTSTR szNewText);
     void ReplaceLogTextAllThrough(CString strOldPart, CString strNewPart);
+    void ReplaceLogTextParts(std::vector<tLogTextPart> const &parts);
+    void WriteLogTextEscaped(CSubstTextWriter &writer, tLogPos nFrom, tLogPos nTo) const;
     /* not needed so far
     LPCLogInfoList DuplicateList() const;
     */
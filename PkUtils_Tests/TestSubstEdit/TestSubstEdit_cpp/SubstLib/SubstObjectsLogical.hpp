@@ -24,6 +24,19 @@ extern CString WINAPI extractSubstr(
 // STATIC FUNCTIONS
 /////////////////////////////////////////////////////////////////////////////
 
+// Note: "&apos" is without the semicolon, as it always has been; documents saved so far rely on it
+template<class TFIELDID> 
+TCHAR const CSubstLogData<TFIELDID>::m_xmlChars[tXmlEntities] = { 
+    _T('&'), _T('<'), _T('>'), _T('"'), _T('\'') };
+template<class TFIELDID> 
+LPCTSTR const CSubstLogData<TFIELDID>::m_xmlEntities[tXmlEntities] = { 
+    _T("&amp;"), _T("&lt;"), _T("&gt;"), _T("&quot;"), _T("&apos") };
+template<class TFIELDID> 
+LPCTSTR const CSubstLogData<TFIELDID>::m_markerPrefixes[eLogInfoEnd + 1] = { 
+    NULL, _T("<?if "), _T("<?repeat "), _T("<?end ") };
+template<class TFIELDID> 
+LPCTSTR const CSubstLogData<TFIELDID>::m_markerSuffix = _T("?>");
+
 template<class TFIELDID> 
 CString CALLBACK getReplacementTextFn(SubstDescr<TFIELDID> const* lpDesc)
 {
@@ -39,17 +52,18 @@ CString CALLBACK getReplacementTextFn(SubstDescr<TFIELDID> const* lpDesc)
 // CLASS DEFINITIONS
 /////////////////////////////////////////////////////////////////////////////
 
-IMPLEMENT_SERIAL_T(CLogInfo, TFIELDID, tLogInfoPredecessor, LOGINFO_VERSION);
+// The older versions are loaded as well; see Serialize
+IMPLEMENT_SERIAL_T(CLogInfo, TFIELDID, tLogInfoPredecessor, VERSIONABLE_SCHEMA | LOGINFO_VERSION);
 
 template<class TFIELDID> 
-CLogInfo<TFIELDID>::CLogInfo() : tLogInfoPredecessor()
+CLogInfo<TFIELDID>::CLogInfo() : tLogInfoPredecessor(), m_kind(eLogInfoField)
 {
     SetWhat((TFIELDID)kInvalidSubstElemId);
     SetPos(0);
 }
 
 template<class TFIELDID> 
-CLogInfo<TFIELDID>::CLogInfo(TFIELDID  what) : tLogInfoPredecessor()
+CLogInfo<TFIELDID>::CLogInfo(TFIELDID  what) : tLogInfoPredecessor(), m_kind(eLogInfoField)
 {
     SetWhat(what);
     SetPos(0);
@@ -58,12 +72,19 @@ CLogInfo<TFIELDID>::CLogInfo(TFIELDID  what) : tLogInfoPredecessor()
 template<class TFIELDID> 
 CLogInfo<TFIELDID>::CLogInfo(
     TFIELDID  what,
-    tLogPos      pos) : tLogInfoPredecessor()
+    tLogPos      pos,
+    ESubstLogInfoKind kind) : tLogInfoPredecessor(), m_kind(kind)
 {
     SetWhat(what);
     SetPos(pos);
 }
 
+template<class TFIELDID> 
+CLogInfo<TFIELDID>::CLogInfo(CLogInfo<TFIELDID> const& rhs) 
+    : tLogInfoPredecessor(), m_what(rhs.m_what), m_kind(rhs.m_kind), m_pos(rhs.m_pos)
+{
+}
+
 template<class TFIELDID> 
 CLogInfo<TFIELDID>::~CLogInfo()
 {
@@ -75,7 +96,8 @@ BOOL CLogInfo<TFIELDID>::Assign(CLogInfo<TFIELDID> const*lprhs)
     if (lprhs->IsKindOf(RUNTIME_CLASS(CLogInfo)))
     {
         m_what  = lprhs->What();
-        m_pos = lprhs->GetPos();
+        m_kind  = lprhs->GetKind();
+        SetPos(lprhs->GetPos());
         return TRUE;
     }
     else
@@ -99,16 +121,26 @@ void CLogInfo<TFIELDID>::Serialize(CArchive& ar)
 
     if (ar.IsLoading())
     {
+        // The schema is not known if Serialize is called directly; then it is the current one
+        UINT nSchema = ar.GetObjectSchema();
+        BYTE kind = eLogInfoField;
+
         // In case the line below does not compile for the particular TFIELDID type,
         // you have to supply for that type an operator
         // CArchive& AFXAPI operator>>(CArchive& ar, TFIELDID &val)
         ar >> m_what;
         ar >> m_pos;
+        if ((1 <= nSchema) || ((UINT)-1 == nSchema))
+        {
+            ar >> kind;
+        }
+        m_kind = (ESubstLogInfoKind)kind;
     }
     else
     {
         ar << m_what;
         ar << m_pos;
+        ar << (BYTE)m_kind;
     }
 }
 
@@ -129,7 +161,7 @@ void CLogInfo<TFIELDID>::Dump(CDumpContext& dc) const
 
 /////////////////////////////////////////////////////////////////////////////
 
-IMPLEMENT_SERIAL_T(CSubstLogData, TFIELDID, tSubstLogDataPredecessor, SUBSTLOGDATA_VERSION );
+IMPLEMENT_SERIAL_T(CSubstLogData, TFIELDID, tSubstLogDataPredecessor, VERSIONABLE_SCHEMA | SUBSTLOGDATA_VERSION );
 
 template<class TFIELDID> 
 CSubstLogData<TFIELDID>::CSubstLogData() : tSubstLogDataPredecessor()
@@ -170,15 +202,36 @@ CSubstLogData<TFIELDID>::~CSubstLogData()
 }
 
 template<class TFIELDID> 
-INT_PTR CSubstLogData<TFIELDID>::GetLogInfoIndex(CLogInfo<TFIELDID> const*lpPos) const
+void CSubstLogData<TFIELDID>::DestroyList(void)
 {
-    return LogListC().Find(const_cast<CLogInfo<TFIELDID>*>(lpPos));
+    m_fieldIndex.RemoveAll();
 }
 
+// Fills the ( empty ) list by new CLogInfo objects, built of the fields; used for storing them
 template<class TFIELDID> 
-void CSubstLogData<TFIELDID>::DestroyList(void)
+void CSubstLogData<TFIELDID>::CopyLogList(CLogInfoList<TFIELDID> &list) const
+{
+    ASSERT(list.IsEmpty());
+    list.SetSize(0, GetLogInfoCount());
+    for (INT_PTR ii = 0, nSize = GetLogInfoCount(); ii < nSize; ii++)
+    {
+        list.Add(new CLogInfo<TFIELDID>(GetLogInfoWhat(ii), GetLogInfoPos(ii), GetLogInfoKind(ii)));
+    }
+}
+
+// Re-creates m_fieldIndex from the items of list; used for loading them
+template<class TFIELDID> 
+void CSubstLogData<TFIELDID>::RebuildFieldIndex(CLogInfoList<TFIELDID> const &list)
 {
-    m_logList.DeleteAndRemoveAll();
+    CLogInfo<TFIELDID>*  lpTmp;
+
+    m_fieldIndex.RemoveAll();
+    m_fieldIndex.Reserve(list.GetCount());
+    for (INT_PTR ii = 0, nSize = list.GetCount(); ii < nSize; ii++)
+    {
+        VERIFY(lpTmp = list.GetAt(ii));
+        m_fieldIndex.Add(lpTmp->GetPos(), 0, StoredId(lpTmp->What()), StoredTag(lpTmp->GetKind()));
+    }
 }
 
 template<class TFIELDID> 
@@ -198,167 +251,570 @@ template<class TFIELDID>
 SubstDescr<TFIELDID> const* CSubstLogData<TFIELDID>::FindMapItem(
     TFIELDID item) const
 {
-    return SubstMapKeeper<TFIELDID>::FindMapItem(GetSubstMap(), item);
+    return MapKeeper().FindMapItem(item);
 }
 
 template<class TFIELDID> 
-INT_PTR CSubstLogData<TFIELDID>::AppendLogInfo(CLogInfo<TFIELDID> const*lpLogInfo)
+SubstDescr<TFIELDID> const* CSubstLogData<TFIELDID>::FindMapItem(
+    TFIELDID item, 
+    size_t  &nTxtLen) const
 {
-    return LogList().Add(const_cast<CLogInfo<TFIELDID>*>(lpLogInfo));
+    return MapKeeper().FindMapItem(item, nTxtLen);
 }
 
+// Replaces the field nIndex by logInfo; its position must keep the order of fields
 template<class TFIELDID> 
-CLogInfo<TFIELDID>* CSubstLogData<TFIELDID>::AppenNewLogInfo(TFIELDID  what)
+void CSubstLogData<TFIELDID>::SetLogInfo(INT_PTR nIndex, CLogInfo<TFIELDID> const& logInfo)
 {
-    CLogInfo<TFIELDID>* lpLogInfo = NULL;
+    m_fieldIndex.SetId((size_t)nIndex, StoredId(logInfo.What()));
+    m_fieldIndex.SetTag((size_t)nIndex, StoredTag(logInfo.GetKind()));
+    m_fieldIndex.SetLogPos((size_t)nIndex, logInfo.GetPos());
+}
 
-    try
-    {
-        if (lpLogInfo = new CLogInfo<TFIELDID>(what))
-        {
-            AppendLogInfo(lpLogInfo);
-        }
-    }
-    catch(CException *e)
+template<class TFIELDID> 
+INT_PTR CSubstLogData<TFIELDID>::AppendLogInfo(CLogInfo<TFIELDID> const& logInfo)
+{
+    // the position must not preceed the position of the last field
+    m_fieldIndex.Add(logInfo.GetPos(), 0, StoredId(logInfo.What()), StoredTag(logInfo.GetKind()));
+    return GetLogInfoCount() - 1;
+}
+
+// Appends a new field on the position of the last field ( or on the position 0, if there is none )
+template<class TFIELDID> 
+INT_PTR CSubstLogData<TFIELDID>::AppenNewLogInfo(TFIELDID  what)
+{
+    INT_PTR nCount = GetLogInfoCount();
+    tLogPos pos = (0 < nCount) ? GetLogInfoPos(nCount - 1) : 0;
+
+    return AppenNewLogInfo(what, pos);
+}
+
+template<class TFIELDID> 
+INT_PTR CSubstLogData<TFIELDID>::AppenNewLogInfo(
+    TFIELDID  what, 
+    tLogPos   pos, 
+    ESubstLogInfoKind kind)
+{
+    return AppendLogInfo(CLogInfo<TFIELDID>(what, pos, kind));
+}
+
+// Inserts the field before indexBefore, or appends it if indexBefore is out of range.
+// Returns the index of inserted field.
+template<class TFIELDID> 
+INT_PTR CSubstLogData<TFIELDID>::InsertLogInfo(
+    INT_PTR     indexBefore, 
+    CLogInfo<TFIELDID> const& logInfo)
+{
+    if ((0 <= indexBefore) && (indexBefore < GetLogInfoCount()))
     {
-        e->Delete();
-        lpLogInfo = NULL;
+        m_fieldIndex.InsertAt((size_t)indexBefore, logInfo.GetPos(), 0, 
+            StoredId(logInfo.What()), StoredTag(logInfo.GetKind()));
+        return indexBefore;
     }
-
-    return lpLogInfo;
+    return AppendLogInfo(logInfo);
 }
 
+// Inserts all the items of infos before indexBefore, at once.
 template<class TFIELDID> 
 void CSubstLogData<TFIELDID>::InsertLogInfo(
     INT_PTR     indexBefore, 
-    CLogInfo<TFIELDID>* lpLogInfo)
+    std::vector<CLogInfo<TFIELDID> > const &infos)
 {
-    if (0 <= indexBefore)
+    size_t nCount = infos.size();
+    std::vector<tLogPos> positions(nCount);
+    std::vector<CSubstFieldIndex::tStoredId>  ids(nCount);
+    std::vector<CSubstFieldIndex::tStoredTag> tags(nCount);
+
+    ASSERT((0 <= indexBefore) && (indexBefore <= GetLogInfoCount()));
+    for (size_t ii = 0; ii < nCount; ii++)
     {
-        m_logList.InsertAt(indexBefore, lpLogInfo);
+        positions[ii] = infos[ii].GetPos();
+        ids[ii] = StoredId(infos[ii].What());
+        tags[ii] = StoredTag(infos[ii].GetKind());
     }
-    else
+    if (0 < nCount)
     {
-        m_logList.Add(lpLogInfo);
+        m_fieldIndex.InsertAt((size_t)indexBefore, &positions[0], &ids[0], &tags[0], nCount);
     }
 }
 
 template<class TFIELDID> 
-void  CSubstLogData<TFIELDID>::InsertLogInfo(
-    CLogInfo<TFIELDID>* lpLogInfoBefore, 
-    CLogInfo<TFIELDID>* lpLogInfo)
+void CSubstLogData<TFIELDID>::RemoveLogInfo(INT_PTR  nIndex, INT_PTR nCount)
 {
-    if (lpLogInfoBefore)
-    {
-        InsertLogInfo(GetLogInfoIndex(lpLogInfoBefore), lpLogInfo);
+    m_fieldIndex.RemoveAt((size_t)nIndex, (size_t)nCount);
+}
+
+// Assigns the logical string and the fields of what; nothing is done if the contents match already.
+// The fingerprints what has computed are taken over, as they are valid for the contents assigned.
+template<class TFIELDID> 
+void CSubstLogData<TFIELDID>::AssignSerializableData(CSubstLogData<TFIELDID> const & what)
+{
+    if (IsEqual(what))
+        return;
+
+    ClearContentsLogical();
+    // No, m_lpMap is NOT serialized, hence it is NOT assigned here
+    /* m_lpMap   = what.m_lpMap; */
+    m_logStr   = what.m_logStr;  // assign m_logStr
+    AssignLogList(what);  // duplicate fields
+
+    // what may be rendered by other threads meanwhile, computing its fingerprints
+    std::lock_guard<std::mutex> lock(what.m_compileLock);
+
+    if (what.m_textFingerprint.bValid && (what.m_textFingerprint.nStamp == what.m_logStr.GetStamp()))
+    {   // the stamp has been copied with the string
+        m_textFingerprint = what.m_textFingerprint;
     }
-    else
+    if (what.m_fieldsFingerprint.bValid && (what.m_fieldsFingerprint.nStamp == what.m_fieldIndex.GetStamp()))
     {
-        AppendLogInfo(lpLogInfo);
+        m_fieldsFingerprint.value = what.m_fieldsFingerprint.value;
+        m_fieldsFingerprint.nStamp = m_fieldIndex.GetStamp();
+        m_fieldsFingerprint.bValid = true;
     }
 }
 
+// Duplicates the fields of what; they are not copied again if they match already.
+// The copied fields have zero physical length.
 template<class TFIELDID> 
-void CSubstLogData<TFIELDID>::RemoveLogInfo(INT_PTR  nIndex)
+void  CSubstLogData<TFIELDID>::AssignLogList(CSubstLogData<TFIELDID> const & what)
 {
-    LogList().DeleteAndRemoveAt(nIndex);
+    if (IsLogListEqual(what))
+        return;
+
+    m_fieldIndex.AssignLogical(what.m_fieldIndex);
 }
 
+// Returns TRUE if the fields match those of what ( their ids, positions and kinds )
 template<class TFIELDID> 
-BOOL  CSubstLogData<TFIELDID>::RemoveLogInfo(CLogInfo<TFIELDID> const* lpLogInfo)
+BOOL CSubstLogData<TFIELDID>::IsLogListEqual(CSubstLogData<TFIELDID> const & what) const
 {
-    INT_PTR nIndex;
-    BOOL  result = FALSE;
+    return m_fieldIndex.IsLogicalEqual(what.m_fieldIndex) ? TRUE : FALSE;
+}
 
-    if (0 <= (nIndex = GetLogInfoIndex(lpLogInfo)))
-    {
-        RemoveLogInfo(nIndex);
-        result = TRUE;
-    }
-    return result;
+// Returns the physical string, with the field texts of the substitution map.
+template<class TFIELDID> 
+CString CSubstLogData<TFIELDID>::LogStr2PhysStr(
+    CSubstLogData<TFIELDID> const & logData)
+{
+    return logData.GetRenderPlan().Render(logData.GetLogStr());
 }
 
+// Returns the physical string, with the field texts returned by lpFn.
+// The returned strings are kept until the result is composed, so it is allocated just once.
 template<class TFIELDID> 
-void CSubstLogData<TFIELDID>::AssignSerializableData(CSubstLogData<TFIELDID> const & what)
+CString CSubstLogData<TFIELDID>::LogStrToPhysStr(
+    CSubstLogData<TFIELDID> const & logData, 
+    lpfnDescrToText lpFn)
 {
-    ClearContentsLogical();
-    // No, m_lpMap is NOT serialized, hence it is NOT assigned here
-    /* m_lpMap   = what.m_lpMap; */
-    m_logStr   = what.GetLogStr();  // assign m_logStr
-    AssignLogList(what.LogListC());  // duplicate list
+    std::vector<CString>        texts;
+    CCollectedTextViews         views;
+
+    logData.CollectTextViews(lpFn, texts, views);
+    return logData.GetRenderPlan().Render(logData.GetLogStr(), views);
 }
 
+// Returns the physical string, with the field texts provided by lpFn without a copy.
 template<class TFIELDID> 
-void  CSubstLogData<TFIELDID>::AssignLogList(CPkTypedPtrArray<CObArray, CLogInfo<TFIELDID>*> const &list)
+CString CSubstLogData<TFIELDID>::LogStrToPhysStr(
+    CSubstLogData<TFIELDID> const & logData, 
+    lpfnDescrToView lpFn)
 {
-    CLogInfo<TFIELDID>*  lpTmp;
-    CLogInfo<TFIELDID>*  lpNew;
-    CRuntimeClass*    lpRt;
-    CObject*          pObj;
+    CCollectedTextViews         views;
 
-    DestroyList();
-    for(INT_PTR ii = 0, nSize = list.GetCount(); ii < nSize; ii++)
+    logData.CollectTextViews(lpFn, views);
+    return logData.GetRenderPlan().Render(logData.GetLogStr(), views);
+}
+
+// Returns the physical string, with the field texts got from the provider of the context.
+// Each distinct field is resolved at most once, and not at all if the context keeps its text already.
+template<class TFIELDID> 
+CString CSubstLogData<TFIELDID>::LogStrToPhysStr(
+    CSubstLogData<TFIELDID> const & logData, 
+    CSubstRenderContext<TFIELDID> &context)
+{
+    CCollectedTextViews         views;
+
+    logData.CollectTextViews(context, views);
+    return logData.GetRenderPlan().Render(logData.GetLogStr(), views);
+}
+
+// Returns the physical string, with the field texts returned by lpFn;
+// the string is composed only if the cache does not keep it already.
+template<class TFIELDID> 
+CString CSubstLogData<TFIELDID>::LogStrToPhysStr(
+    CSubstLogData<TFIELDID> const & logData, 
+    lpfnDescrToText lpFn,
+    CSubstRenderCache &cache)
+{
+    std::vector<CString>        texts;
+    CCollectedTextViews         views;
+
+    logData.CollectTextViews(lpFn, texts, views);
+    return logData.RenderCached(views, cache);
+}
+
+// Returns the physical string, with the field texts provided by lpFn without a copy;
+// the string is composed only if the cache does not keep it already.
+template<class TFIELDID> 
+CString CSubstLogData<TFIELDID>::LogStrToPhysStr(
+    CSubstLogData<TFIELDID> const & logData, 
+    lpfnDescrToView lpFn,
+    CSubstRenderCache &cache)
+{
+    CCollectedTextViews         views;
+
+    logData.CollectTextViews(lpFn, views);
+    return logData.RenderCached(views, cache);
+}
+
+// Returns the physical string, with the field texts got from the provider of the context;
+// the string is composed only if the cache does not keep it already.
+template<class TFIELDID> 
+CString CSubstLogData<TFIELDID>::LogStrToPhysStr(
+    CSubstLogData<TFIELDID> const & logData, 
+    CSubstRenderContext<TFIELDID> &context,
+    CSubstRenderCache &cache)
+{
+    CCollectedTextViews         views;
+
+    logData.CollectTextViews(context, views);
+    return logData.RenderCached(views, cache);
+}
+
+// Returns the physical string, with the sections and the field texts given by values.
+// Unlike other overloads, the markers of sections are interpreted, rather than left out.
+template<class TFIELDID> 
+CString CSubstLogData<TFIELDID>::LogStrToPhysStr(
+    CSubstLogData<TFIELDID> const & logData, 
+    ISubstTemplateValues<TFIELDID> &values)
+{
+    CString          strResult;
+    CSubstStringSink sink(strResult);
+
+    LogStrToPhysStr(logData, values, sink);
+    return strResult;
+}
+
+// Writes the physical string to the sink, with the field texts of the substitution map.
+// The sink gets the text in chunks of CSubstTextWriter, while it is being rendered.
+template<class TFIELDID> 
+void CSubstLogData<TFIELDID>::LogStrToPhysStr(
+    CSubstLogData<TFIELDID> const & logData, 
+    ISubstTextSink &sink)
+{
+    CSubstTextWriter writer(sink);
+
+    logData.GetRenderPlan().Write(logData.GetLogStr(), writer);
+    writer.Flush();
+}
+
+// Writes the physical string to the sink, with the field texts returned by lpFn.
+// Just one of the returned strings is kept at a time.
+template<class TFIELDID> 
+void CSubstLogData<TFIELDID>::LogStrToPhysStr(
+    CSubstLogData<TFIELDID> const & logData, 
+    lpfnDescrToText lpFn,
+    ISubstTextSink &sink)
+{
+    CSubstTextWriter  writer(sink);
+    CDescrToTextViews views(lpFn);
+
+    logData.GetRenderPlan().Write(logData.GetLogStr(), views, writer);
+    writer.Flush();
+}
+
+// Writes the physical string to the sink, with the field texts provided by lpFn without a copy.
+// The text provided needs to be valid only until the next call of lpFn.
+template<class TFIELDID> 
+void CSubstLogData<TFIELDID>::LogStrToPhysStr(
+    CSubstLogData<TFIELDID> const & logData, 
+    lpfnDescrToView lpFn,
+    ISubstTextSink &sink)
+{
+    CSubstTextWriter  writer(sink);
+    CDescrToViewViews views(lpFn);
+
+    logData.GetRenderPlan().Write(logData.GetLogStr(), views, writer);
+    writer.Flush();
+}
+
+// Writes the physical string to the sink, with the field texts got from the provider of the context.
+template<class TFIELDID> 
+void CSubstLogData<TFIELDID>::LogStrToPhysStr(
+    CSubstLogData<TFIELDID> const & logData, 
+    CSubstRenderContext<TFIELDID> &context,
+    ISubstTextSink &sink)
+{
+    CSubstTextWriter writer(sink);
+    CContextViews    views(context);
+
+    context.BeginRender();
+    logData.GetRenderPlan().Write(logData.GetLogStr(), views, writer);
+    writer.Flush();
+}
+
+// Writes the physical string to the sink, with the sections and the field texts given by values.
+// The sections repeated many times are written as they are expanded, never kept as a whole.
+template<class TFIELDID> 
+void CSubstLogData<TFIELDID>::LogStrToPhysStr(
+    CSubstLogData<TFIELDID> const & logData, 
+    ISubstTemplateValues<TFIELDID> &values,
+    ISubstTextSink &sink)
+{
+    CSubstTextWriter writer(sink);
+
+    logData.GetTemplateProgram().Execute(logData.GetLogStr(), values, writer);
+    writer.Flush();
+}
+
+// Returns the fingerprint of the logical string, computing it if the string has changed since the last call
+template<class TFIELDID> 
+CSubstHash128::tValue CSubstLogData<TFIELDID>::GetTextFingerprint() const
+{
+    std::lock_guard<std::mutex> lock(m_compileLock);
+
+    if (!m_textFingerprint.bValid || (m_textFingerprint.nStamp != m_logStr.GetStamp()))
+    {
+        CSubstHash128 hash;
+
+        hash.AddText(GetLogStr(), GetLogLength());
+        m_textFingerprint.value = hash.GetValue();
+        m_textFingerprint.nStamp = m_logStr.GetStamp();
+        m_textFingerprint.bValid = true;
+    }
+    return m_textFingerprint.value;
+}
+
+// Returns the fingerprint of the fields ( their ids, positions and kinds ), 
+// computing it if the fields have changed since the last call
+template<class TFIELDID> 
+CSubstHash128::tValue CSubstLogData<TFIELDID>::GetFieldsFingerprint() const
+{
+    std::lock_guard<std::mutex> lock(m_compileLock);
+
+    if (!m_fieldsFingerprint.bValid || (m_fieldsFingerprint.nStamp != m_fieldIndex.GetStamp()))
     {
-        VERIFY(lpTmp = list[ii]);
-        VERIFY(lpRt = lpTmp->GetRuntimeClass());
-        if (pObj = lpRt->CreateObject())
+        CSubstHash128 hash;
+        INT_PTR nCount = GetLogInfoCount();
+
+        hash.AddValue(nCount);
+        for (INT_PTR ii = 0; ii < nCount; ii++)
         {
-            VERIFY(lpNew = dynamic_cast<CLogInfo<TFIELDID>*>(pObj));
-            lpNew->Assign(lpTmp);
-            m_logList.Add(lpNew);
+            hash.AddValue(GetLogInfoWhat(ii));
+            hash.AddValue(GetLogInfoPos(ii));
+            hash.AddValue((BYTE)GetLogInfoKind(ii));
         }
+        m_fieldsFingerprint.value = hash.GetValue();
+        m_fieldsFingerprint.nStamp = m_fieldIndex.GetStamp();
+        m_fieldsFingerprint.bValid = true;
     }
+    return m_fieldsFingerprint.value;
 }
 
+// Returns the 128-bit fingerprint of the logical string and of the fields.
+// The fingerprints of the string and of the fields are kept separately, so that the edit
+// of the fields only ( like inserting a field ) does not hash the whole string again, and vice versa.
+// Equal contents have equal fingerprints, whatever the map is.
 template<class TFIELDID> 
-CString CSubstLogData<TFIELDID>::LogStr2PhysStr(
-    CSubstLogData<TFIELDID> const & logData)
+CSubstHash128::tValue CSubstLogData<TFIELDID>::GetFingerprint() const
+{
+    CSubstHash128 hash;
+
+    hash.AddFingerprint(GetTextFingerprint());
+    hash.AddFingerprint(GetFieldsFingerprint());
+    return hash.GetValue();
+}
+
+// Returns the 64-bit hash of the contents, the key of CSubstRenderCache; see GetFingerprint
+template<class TFIELDID> 
+CSubstHash64::tValue CSubstLogData<TFIELDID>::GetContentHash() const
 {
-    return LogStrToPhysStr(logData, getReplacementTextFn);
+    return GetFingerprint().nLow;
 }
 
+// Returns TRUE if rhs has the same logical string and the same fields as this; the map is not compared.
+// The contents of different fingerprints differ for sure; otherwise they are compared in full,
+// unless the text has been copied from the other one and not edited since ( it has the same stamp ).
 template<class TFIELDID> 
-CString CSubstLogData<TFIELDID>::LogStrToPhysStr(
-    CSubstLogData<TFIELDID> const & logData, 
-    fnDescrToText lpFn)
+BOOL CSubstLogData<TFIELDID>::IsEqual(CSubstLogData<TFIELDID> const &rhs) const
 {
-    size_t        itmplen;
-    CLogInfo<TFIELDID> const*  lplogInf;
-    SubstDescr<TFIELDID> const* lpDesc;
-    tLogPos       iLogPos = 0;
-    tLogPos       iLogCopied = 0;
-    LPCTSTR       lpTxt = NULL;
-    CString       strPhys, strTmp;
-    CString       strLog = logData.GetLogStr();
-    SubstMapKeeper<TFIELDID> const& mapKeeper = logData.MapKeeper();
+    size_t nLength;
 
-    for(INT_PTR ii = 0, nCount = logData.LogListC().GetCount(); ii < nCount; ii++)
+    if (this == &rhs)
+        return TRUE;
+    if (((nLength = GetLogLength()) != rhs.GetLogLength()) || (GetLogInfoCount() != rhs.GetLogInfoCount()))
+        return FALSE;
+    if ((GetTextFingerprint() != rhs.GetTextFingerprint()) || (GetFieldsFingerprint() != rhs.GetFieldsFingerprint()))
+        return FALSE;
+    if ((m_logStr.GetStamp() != rhs.m_logStr.GetStamp()) && 
+        (0 != memcmp(GetLogStr(), rhs.GetLogStr(), nLength * sizeof(TCHAR))))
     {
-        lplogInf = logData.LogListC().GetAt(ii);
-        if (lpDesc = mapKeeper.FindMapItem(lplogInf->What()))
+        return FALSE;
+    }
+    return IsLogListEqual(rhs);
+}
+
+// Collects the field texts returned by lpFn for the slots of the render plan; texts keep them
+template<class TFIELDID> 
+void CSubstLogData<TFIELDID>::CollectTextViews(
+    lpfnDescrToText       lpFn, 
+    std::vector<CString> &texts, 
+    CCollectedTextViews  &views) const
+{
+    CSubstRenderPlan<TFIELDID> const& plan = GetRenderPlan();
+    size_t                      ii, nSlots = plan.GetSlotCount();
+
+    texts.resize(nSlots);
+    views.resize(nSlots);
+    for (ii = 0; ii < nSlots; ii++)
+    {
+        if (NULL != plan.GetFieldDescr(ii))
         {
-            ASSERT(lplogInf->GetPos() <= (tLogPos)strLog.GetLength());
-            // add another piece of logical text
-            strTmp = strLog.Mid((int)iLogCopied, (int)((iLogPos = lplogInf->GetPos()) - iLogCopied));
-            strPhys += strTmp;
-            // add the field text, or generally the replacement
-            strPhys += (*lpFn)(lpDesc);
-            // update the position in logical text
-            iLogCopied = iLogPos;
+            texts[ii] = (*lpFn)(plan.GetFieldDescr(ii));
+            views[ii].lpText = texts[ii];
+            views[ii].nLength = (size_t)texts[ii].GetLength();
         }
         else
         {
-            ASSERT(FALSE);
+            views[ii].lpText = NULL;
+            views[ii].nLength = 0;
         }
     }
-    // if there is remaining logical text not copied so far
-    if ((itmplen = strLog.GetLength() - iLogCopied) > 0)
+}
+
+// Collects the field texts provided by lpFn for the slots of the render plan
+template<class TFIELDID> 
+void CSubstLogData<TFIELDID>::CollectTextViews(
+    lpfnDescrToView      lpFn, 
+    CCollectedTextViews &views) const
+{
+    CSubstRenderPlan<TFIELDID> const& plan = GetRenderPlan();
+    size_t                      ii, nSlots = plan.GetSlotCount();
+
+    views.resize(nSlots);
+    for (ii = 0; ii < nSlots; ii++)
+    {
+        views[ii].nLength = 0;
+        if (NULL != plan.GetFieldDescr(ii))
+            views[ii].lpText = (*lpFn)(plan.GetFieldDescr(ii), views[ii].nLength);
+        else
+            views[ii].lpText = NULL;
+    }
+}
+
+// Collects the field texts got from the context for the slots of the render plan; begins the render of the context
+template<class TFIELDID> 
+void CSubstLogData<TFIELDID>::CollectTextViews(
+    CSubstRenderContext<TFIELDID> &context, 
+    CCollectedTextViews           &views) const
+{
+    CSubstRenderPlan<TFIELDID> const& plan = GetRenderPlan();
+    size_t                      ii, nSlots = plan.GetSlotCount();
+
+    views.resize(nSlots);
+    context.BeginRender();
+    for (ii = 0; ii < nSlots; ii++)
     {
-        strTmp = strLog.Mid((int)iLogCopied, (int)itmplen);
-        strPhys += strTmp;
+        views[ii].nLength = 0;
+        if (NULL != plan.GetFieldDescr(ii))
+            views[ii].lpText = context.GetFieldText(plan.GetFieldDescr(ii), views[ii].nLength);
+        else
+            views[ii].lpText = NULL;
     }
+}
+
+// Returns the physical string with the field texts collected, kept by the cache.
+// The key of the string is the content hash, and the hash of the field texts.
+template<class TFIELDID> 
+CString CSubstLogData<TFIELDID>::RenderCached(
+    CCollectedTextViews const& views, 
+    CSubstRenderCache         &cache) const
+{
+    CSubstHash64::tValue nTemplate = GetContentHash();
+    CSubstHash64 values;
+    CString      strResult;
 
-    return strPhys;
+    for (size_t ii = 0, nSlots = views.size(); ii < nSlots; ii++)
+    {
+        values.AddValue(NULL != views[ii].lpText);
+        values.AddText(views[ii].lpText, views[ii].nLength);
+    }
+    if (!cache.Lookup(this, nTemplate, values.GetValue(), strResult))
+    {
+        strResult = GetRenderPlan().Render(GetLogStr(), views);
+        cache.Add(this, nTemplate, values.GetValue(), strResult);
+    }
+    return strResult;
+}
+
+// Returns the render plan of the current contents, compiling it if the logical string, 
+// the fields or the map have changed since the last call.
+// The plan is valid until the next modification of this object.
+// Several threads may call it at once; the plan is compiled just by the first of them.
+template<class TFIELDID> 
+CSubstRenderPlan<TFIELDID> const& CSubstLogData<TFIELDID>::GetRenderPlan() const
+{
+    std::lock_guard<std::mutex> lock(m_compileLock);
+    SubstDescr<TFIELDID> const* lpMap = GetSubstMap();
+
+    if (!m_renderPlan.IsCompiledOf(m_logStr.GetStamp(), m_fieldIndex.GetStamp(), lpMap))
+    {
+        SubstDescr<TFIELDID> const* lpDesc;
+        size_t  nTxtLen;
+        INT_PTR nCount = GetLogInfoCount();
+
+        m_renderPlan.BeginCompile(GetLogLength(), (size_t)nCount, m_logStr.GetStamp(), m_fieldIndex.GetStamp(), lpMap);
+        for (INT_PTR ii = 0; ii < nCount; ii++)
+        {
+            TFIELDID what = GetLogInfoWhat(ii);
+            bool     bField = (eLogInfoField == GetLogInfoKind(ii));
+
+            // the marker of a section ending it may have no text in the map
+            nTxtLen = 0;
+            lpDesc = MapKeeper().FindMapItem(what, nTxtLen);
+            ASSERT((NULL != lpDesc) || !bField);
+            m_renderPlan.AppendSlot(GetLogInfoPos(ii), what, lpDesc, nTxtLen, bField);
+        }
+        m_renderPlan.EndCompile();
+    }
+    return m_renderPlan;
+}
+
+// Returns the template program of the current contents, compiling it if the logical string 
+// or the fields have changed since the last call.
+// The program is valid until the next modification of this object.
+// Several threads may call it at once; the program is compiled just by the first of them.
+template<class TFIELDID> 
+CSubstTemplateProgram<TFIELDID> const& CSubstLogData<TFIELDID>::GetTemplateProgram() const
+{
+    std::lock_guard<std::mutex> lock(m_compileLock);
+
+    if (!m_program.IsCompiledOf(m_logStr.GetStamp(), m_fieldIndex.GetStamp()))
+    {
+        INT_PTR nCount = GetLogInfoCount();
+
+        m_program.BeginCompile(GetLogLength(), (size_t)nCount, m_logStr.GetStamp(), m_fieldIndex.GetStamp());
+        for (INT_PTR ii = 0; ii < nCount; ii++)
+        {
+            switch (GetLogInfoKind(ii))
+            {
+                case eLogInfoIf:
+                    m_program.AppendIf(GetLogInfoPos(ii), GetLogInfoWhat(ii));
+                    break;
+                case eLogInfoRepeat:
+                    m_program.AppendRepeat(GetLogInfoPos(ii), GetLogInfoWhat(ii));
+                    break;
+                case eLogInfoEnd:
+                    m_program.AppendEnd(GetLogInfoPos(ii));
+                    break;
+                default:
+                    m_program.AppendField(GetLogInfoPos(ii), GetLogInfoWhat(ii));
+                    break;
+            }
+        }
+        m_program.EndCompile();
+    }
+    return m_program;
 }
 
 template<class TFIELDID> 
@@ -377,12 +833,8 @@ void CSubstLogData<TFIELDID>::Assign(CSubstLogData<TFIELDID> const &rhs)
 /// <see cref="ReplaceLogXmlPartsBack"/>
 template<class TFIELDID> 
 void CSubstLogData<TFIELDID>::ReplaceLogXmlCharsThere()
-{   // must replace ampresands first
-    ReplaceLogTextAllThrough("&", "&amp;");   // 1.
-    ReplaceLogTextAllThrough("<", "&lt;");    // 2.
-    ReplaceLogTextAllThrough(">", "&gt;");    // 3.
-    ReplaceLogTextAllThrough("\"", "&quot;"); // 4.
-    ReplaceLogTextAllThrough("'", "&apos");   // 5.
+{
+    ReplaceLogXmlEntities(TRUE);
 }
 
 /// <summary>
@@ -392,13 +844,64 @@ void CSubstLogData<TFIELDID>::ReplaceLogXmlCharsThere()
 /// <see cref="ReplaceLogXmlCharsThere"/>
 template<class TFIELDID> 
 void CSubstLogData<TFIELDID>::ReplaceLogXmlPartsBack()
-{   // Must do replacement in reverse order than ReplaceLogXmlCharsThere();
-    // hence must replace ampresands as last
-    ReplaceLogTextAllThrough("&apos", "'");   // 5.
-    ReplaceLogTextAllThrough("&quot;", "\""); // 4.
-    ReplaceLogTextAllThrough("&gt;", ">");    // 3.
-    ReplaceLogTextAllThrough("&lt;", "<");    // 2.
-    ReplaceLogTextAllThrough("&amp;", "&");   // 1.
+{
+    ReplaceLogXmlEntities(FALSE);
+}
+
+/// <summary>
+/// Escapes ( bEscape is TRUE ) or unescapes the xml special characters of the logical string,
+/// in one pass finding all the entities, and one pass of ReplaceLogTextParts.
+/// The result is the same as of the replacement of each entity all through the text
+/// by ReplaceLogTextAllThrough, in the order of the entities table 
+/// ( ampersands first when escaping, last when unescaping ),
+/// since the entities start with '&' and contain no other special character.
+/// </summary>
+template<class TFIELDID> 
+void CSubstLogData<TFIELDID>::ReplaceLogXmlEntities(BOOL bEscape)
+{
+    LPCTSTR lpLog = GetLogStr();
+    size_t nLength = GetLogLength();
+    std::vector<tLogTextPart> parts;
+    tLogTextPart part;
+
+    for (size_t ii = 0; ii < nLength; ii += (0 < part.nOldLength) ? part.nOldLength : 1)
+    {
+        part.nOldLength = 0;
+        if (bEscape)
+        {
+            for (size_t nEntity = 0; nEntity < tXmlEntities; nEntity++)
+            {
+                if (lpLog[ii] == m_xmlChars[nEntity])
+                {
+                    part.lpNewText = m_xmlEntities[nEntity];
+                    part.nNewLength = _tcslen(part.lpNewText);
+                    part.nOldLength = 1;
+                    break;
+                }
+            }
+        }
+        else if (_T('&') == lpLog[ii])
+        {
+            for (size_t nEntity = 0; nEntity < tXmlEntities; nEntity++)
+            {
+                size_t nEntityLen = _tcslen(m_xmlEntities[nEntity]);
+
+                if ((ii + nEntityLen <= nLength) && (0 == _tcsncmp(lpLog + ii, m_xmlEntities[nEntity], nEntityLen)))
+                {
+                    part.lpNewText = &m_xmlChars[nEntity];
+                    part.nNewLength = 1;
+                    part.nOldLength = nEntityLen;
+                    break;
+                }
+            }
+        }
+        if (0 < part.nOldLength)
+        {
+            part.nStart = ii;
+            parts.push_back(part);
+        }
+    }
+    ReplaceLogTextParts(parts);
 }
 
 // Replaces the logical text part specified by startIndex and nReplacedLenght
@@ -410,51 +913,51 @@ template<class TFIELDID>
 void CSubstLogData<TFIELDID>::ReplaceLogTextPart(
     tLogPos startIndex, int nReplacedLenght, LPCTSTR szNewText)
 {
-    int nAddedLength;
-    CString strOldLog = GetLogStr();
-    CString strNewLog = strOldLog;
+    int nAddedLength, nDelta;
+    size_t nFirst, nNext;
     CString strNewText(szNewText);
+    tLogPos nOldLength = GetLogLength();
 
-    if ((startIndex < 0) || (startIndex > (tLogPos)strOldLog.GetLength()))
+    if ((startIndex < 0) || (startIndex > nOldLength))
     {
         /* throw new ArgumentException("startIndex"); */
         ASSERT(FALSE);
         return;
     }
-    if ((nReplacedLenght < 0) || (nReplacedLenght > (int)(strOldLog.GetLength() - startIndex)))
+    if ((nReplacedLenght < 0) || (nReplacedLenght > (int)(nOldLength - startIndex)))
     {
         /* throw new ArgumentException("nReplacedLenght"); */
         ASSERT(FALSE);
         return;
     }
-    // find all affected fields ( fields for which the deletion index in text preceeds the field )
-    CTypedPtrArray<CObArray, CLogInfo<TFIELDID>*> listAffected;
-    for(INT_PTR ii = 0, nSize = LogListC().GetCount(); ii < nSize; ii++)
+    // Fields located inside the replaced part or right after it ( startIndex < pos <= endIndex )
+    // are moved right after the new text; all fields located after the replaced part 
+    // are shifted by the difference of lengths, which is O(log n) regardless their count.
+    nAddedLength = strNewText.GetLength();
+    nDelta = nAddedLength - nReplacedLenght;
+    nFirst = m_fieldIndex.UpperBoundLogPos(startIndex);
+    nNext = m_fieldIndex.UpperBoundLogPos(startIndex + nReplacedLenght);
+
+    // the order of following calls keeps the fields sorted all the time
+    if (nDelta > 0)
     {
-        CLogInfo<TFIELDID>* pInfo;
-        if (startIndex < (pInfo = LogListC()[ii])->GetPos())
-        {
-            listAffected.Add(pInfo);
-        }
+        m_fieldIndex.ShiftFrom(nNext, nDelta);
+    }
+    m_fieldIndex.SetLogPosRange(nFirst, nNext - nFirst, startIndex + nAddedLength);
+    if (nDelta < 0)
+    {
+        m_fieldIndex.ShiftFrom(nNext, nDelta);
     }
 
+    // modify the text in place
     if (nReplacedLenght > 0)
     {
-        strNewLog = extractSubstr(strNewLog, startIndex, nReplacedLenght);
-        for(INT_PTR jj = 0, nSize = listAffected.GetCount(); jj < nSize; jj++)
-        {
-            listAffected.GetAt(jj)->Add2Pos(-nReplacedLenght);
-        }
+        m_logStr.Delete(startIndex, nReplacedLenght);
     }
-    if (0 < (nAddedLength = strNewText.GetLength()))
+    if (nAddedLength > 0)
     {
-        strNewLog.Insert((int)startIndex, strNewText);
-        for(INT_PTR kk = 0, nSize = listAffected.GetCount(); kk < nSize; kk++)
-        {
-            listAffected.GetAt(kk)->Add2Pos(nAddedLength);
-        }
+        m_logStr.Insert(startIndex, strNewText);
     }
-    this->SetLogStr(strNewLog);
 }
 
 /// <summary>
@@ -464,91 +967,188 @@ void CSubstLogData<TFIELDID>::ReplaceLogTextPart(
 /// </summary>
 /// <param name="strOldPart"></param>
 /// <param name="strNewPart"></param>
-/// <see cref="ReplaceLogTextPart"/>
+/// <see cref="ReplaceLogTextAll"/>
 template<class TFIELDID> 
 void CSubstLogData<TFIELDID>::ReplaceLogTextAllThrough(CString strOldPart, CString strNewPart)
 {
-    if (strOldPart.GetLength() == 0)
+    ReplaceLogTextAll(strOldPart, strNewPart);
+}
+
+/// <summary>
+/// Replaces all occurrences of szOldPart in the logical text by szNewPart, 
+/// from left to right, not overlapping; the new text is not searched again.
+/// Fields inside a replaced part move right after the new text, as with ReplaceLogTextPart.
+/// Occurrences are found by CSubstTextSearch, and replaced by ReplaceLogTextParts, 
+/// so the whole replacement takes linear time, regardless the count of matches.
+/// </summary>
+/// <returns>The count of replacements</returns>
+template<class TFIELDID> 
+INT_PTR CSubstLogData<TFIELDID>::ReplaceLogTextAll(LPCTSTR szOldPart, LPCTSTR szNewPart)
+{
+    size_t nOldPart = (NULL == szOldPart) ? 0 : _tcslen(szOldPart);
+    size_t nNewPart = (NULL == szNewPart) ? 0 : _tcslen(szNewPart);
+    LPCTSTR lpLog = GetLogStr();
+    size_t nLength = GetLogLength();
+    std::vector<tLogTextPart> parts;
+    tLogTextPart part;
+
+    if (0 == nOldPart)
     {
-        /* throw new ArgumentException("strOldPart"); */
+        /* throw new ArgumentException("szOldPart"); */
         ASSERT(FALSE);
+        return 0;
+    }
+
+    CSubstTextSearch<TCHAR> search(szOldPart, nOldPart);
+
+    part.nOldLength = nOldPart;
+    part.lpNewText = szNewPart;
+    part.nNewLength = nNewPart;
+    for (size_t nFrom = 0; CSubstTextSearch<TCHAR>::tNotFound != (part.nStart = search.Find(lpLog, nLength, nFrom)); )
+    {
+        parts.push_back(part);
+        nFrom = part.nStart + nOldPart;
+    }
+    ReplaceLogTextParts(parts);
+
+    return (INT_PTR)parts.size();
+}
+
+// Replaces the given parts of logical text ( ascending and not overlapping ) all at once,
+// building the new logical string and new positions of fields in one pass.
+// Fields are moved the same way as by ReplaceLogTextPart called for each part.
+template<class TFIELDID> 
+void CSubstLogData<TFIELDID>::ReplaceLogTextParts(std::vector<tLogTextPart> const &parts)
+{
+    if (parts.empty())
+    {
         return;
     }
 
-    int nDexFound;
-    int nOldPart = strOldPart.GetLength();
-    int nNewPart = strNewPart.GetLength();
+    LPCTSTR lpOld = GetLogStr();
+    size_t nOld = GetLogLength();
+    size_t nFields = m_fieldIndex.GetCount();
+    size_t nNew = nOld, nCopied = 0, nField = 0, ii;
+    std::vector<tLogPos> positions(nFields);
+    ptrdiff_t nDelta = 0;
+    CString strNew;
 
-    for (int nSearPos = 0;;)
+    for (ii = 0; ii < parts.size(); ii++)
     {
-        CString strOldLog(GetLogStr());
+        nNew += parts[ii].nNewLength - parts[ii].nOldLength;
+    }
+    strNew.Preallocate((int)nNew);
+
+    for (ii = 0; ii < parts.size(); ii++)
+    {
+        tLogTextPart const& part = parts[ii];
+        tLogPos nNewEnd;
 
-        if (0 <= (nDexFound = strOldLog.Find(strOldPart, nSearPos)))
+        ASSERT(nCopied <= part.nStart);
+        ASSERT(part.nStart + part.nOldLength <= nOld);
+        // fields before the part, or at its start, just move by the delta so far
+        for (; (nField < nFields) && (m_fieldIndex.GetLogPos(nField) <= part.nStart); nField++)
         {
-            ReplaceLogTextPart(nDexFound, nOldPart, strNewPart);
-            nSearPos += nNewPart; 
+            positions[nField] = (tLogPos)(m_fieldIndex.GetLogPos(nField) + nDelta);
         }
-        else
+        strNew.Append(lpOld + nCopied, (int)(part.nStart - nCopied));
+        strNew.Append(part.lpNewText, (int)part.nNewLength);
+        nNewEnd = (tLogPos)strNew.GetLength();
+        // fields inside the part, or at its end, move right after the new text
+        for (; (nField < nFields) && (m_fieldIndex.GetLogPos(nField) <= part.nStart + part.nOldLength); nField++)
         {
-            break;
+            positions[nField] = nNewEnd;
         }
+        nCopied = part.nStart + part.nOldLength;
+        nDelta += (ptrdiff_t)part.nNewLength - (ptrdiff_t)part.nOldLength;
+    }
+    strNew.Append(lpOld + nCopied, (int)(nOld - nCopied));
+    for (; nField < nFields; nField++)
+    {
+        positions[nField] = (tLogPos)(m_fieldIndex.GetLogPos(nField) + nDelta);
+    }
+
+    SetLogStr(strNew);
+    if (0 < nFields)
+    {
+        m_fieldIndex.SetAllLogPos(&positions[0], nFields);
     }
 }
 
+// Converts the plain text ( as returned by GetPlainText ) back to the logical string and fields.
+// The texts of fields, and the plain texts of the markers of sections, are recognized by CSubstRecognizer 
+// in one pass over the text; bIgnoreCase allows them to differ in case from the texts in the substitution map.
 template<class TFIELDID> 
-void CSubstLogData<TFIELDID>::AssignPlainText(LPCTSTR szText)
+void CSubstLogData<TFIELDID>::AssignPlainText(LPCTSTR szText, BOOL bIgnoreCase)
 {
     SubstDescr<TFIELDID> const* substMap = GetSubstMap();
+    SubstDescr<TFIELDID> const* descr;
+    CSubstRecognizer<TCHAR> recognizer(FALSE != bIgnoreCase);
+    std::vector<CLogInfo<TFIELDID> > patterns;
+    std::vector<TFIELDID> sections;
+    CString strLog, strPattern;
+    size_t nLength = (NULL == szText) ? 0 : _tcslen(szText);
+    size_t nFrom, nStart, nPattern, nEndNoText;
+    int    nKind;
 
     ClearContentsLogical();
-    // assing the input text as a logicl text for now; folloing code will filter it
-    SetLogStr(szText);
 
     // 1. parse the plain text and remove all known fields specification.
     // Note: Must do this BEFORE calling ReplaceLogXmlPartsBack,
     // since ReplaceLogXmlPartsBack will put back specific characters '<' '>',
     // that otherwise can mess-up with fields beggings
-    for (tLogPos nDex = 0; ; )
-    {
-        CString strLog(GetLogStr());
-        CLogInfo<TFIELDID>* lpFound = NULL;
-
-        if (nDex >= (tLogPos)strLog.GetLength())
+    for (nKind = eLogInfoField; nKind <= eLogInfoEnd; nKind++)
+    {   // the patterns of fields first, then those of the markers of sections ( see WritePlainText )
+        for (descr = substMap; kInvalidSubstElemId != descr->valId; descr++)
         {
-            break;
+            strPattern = descr->lpTxt;
+            if (eLogInfoField != nKind)
+                strPattern = m_markerPrefixes[nKind] + strPattern + m_markerSuffix;
+            recognizer.AddPattern(strPattern, (size_t)strPattern.GetLength());
+            patterns.push_back(CLogInfo<TFIELDID>(descr->valId, 0, (ESubstLogInfoKind)nKind));
         }
-
-        // enumerate known fields; check if the text on specific position matches
-        for(SubstDescr<TFIELDID> const* descr = substMap;;descr++)
+    }
+    // the end marker of the field not in the map; it ends the section begun last
+    strPattern = m_markerPrefixes[eLogInfoEnd] + CString(m_markerSuffix);
+    nEndNoText = recognizer.AddPattern(strPattern, (size_t)strPattern.GetLength());
+    recognizer.Build();
+
+    strLog.Preallocate((int)nLength);
+    for (nFrom = 0; recognizer.FindNext(szText, nLength, nFrom, nStart, nPattern); )
+    {   // match found; the text preceding it is kept, and a new field replaces the matched text
+        strLog.Append(szText + nFrom, (int)(nStart - nFrom));
+        nFrom = nStart + recognizer.GetPatternLength(nPattern);
+        if (nEndNoText == nPattern)
         {
-            if (kInvalidSubstElemId == descr->valId)
-            {
-                break;
+            if (sections.empty())
+            {   // no section to end, the text is kept
+                strLog.Append(szText + nStart, (int)(nFrom - nStart));
             }
             else
             {
-                CString strMid;
-                CString strLocal = descr->lpTxt;
-                int nLocalLength = strLocal.GetLength();
-
-                if (nDex + nLocalLength <= (size_t)strLog.GetLength())
-                {
-                    strMid = strLog.Mid((int)nDex, strLocal.GetLength());
-                    if (strMid == strLocal)
-                    {	// match found; create a new field replacing the text
-                        ReplaceLogTextPart(nDex, nLocalLength, NULL);
-                        lpFound = AppenNewLogInfo(descr->valId);
-                        lpFound->SetPos(nDex);
-                        break;
-                    }
-                }
+                AppenNewLogInfo(sections.back(), strLog.GetLength(), eLogInfoEnd);
+                sections.pop_back();
             }
+            continue;
         }
-        if (NULL == lpFound)
+        switch (patterns[nPattern].GetKind())
         {
-            nDex++;
+            case eLogInfoIf:
+            case eLogInfoRepeat:
+                sections.push_back(patterns[nPattern].What());
+                break;
+            case eLogInfoEnd:
+                if (!sections.empty())
+                    sections.pop_back();
+                break;
+            default:
+                break;
         }
+        AppenNewLogInfo(patterns[nPattern].What(), strLog.GetLength(), patterns[nPattern].GetKind());
     }
+    strLog.Append(szText + nFrom, (int)(nLength - nFrom));
+    SetLogStr(strLog);
+
     // 2. now perform the xml special chars substitution
     ReplaceLogXmlPartsBack();
 }
@@ -556,22 +1156,83 @@ void CSubstLogData<TFIELDID>::AssignPlainText(LPCTSTR szText)
 template<class TFIELDID> 
 CString CSubstLogData<TFIELDID>::GetPlainText() const
 {
-    // 1. Initialize temporary data
-    CSubstLogData tempData(*this);
-    tempData.AssignSubstMap(this->GetSubstMap());
-    // 2. Substitute special xml characters in the logical string. 
-    // See http://xml.silmaril.ie/authors/specials/
-    // Note: this may modify the length of logical string in tempData, 
-    // thus causing corresponding shift of fields positions.
-    tempData.ReplaceLogXmlCharsThere();
-    // 3. Convert current temp. logical string to physival string by inserting fields
-    return LogStr2PhysStr(tempData);
+    CString strResult;
+    CSubstStringSink sink(strResult);
+
+    WritePlainText(sink);
+    return strResult;
+}
+
+// Writes the plain text ( as returned by GetPlainText ) to the sink.
+// The special xml characters of the logical string are substituted for their entities
+// ( see ReplaceLogXmlCharsThere ), and the field texts are inserted, on the fly;
+// neither the data nor the resulting text are copied as a whole.
+// The marker of a section is written as the prefix of its kind, the text of its field and the suffix,
+// like "<?if <Year>?>"; AssignPlainText recognizes them back. The marker of a field not in the map 
+// is written without the text; of those, just "<?end ?>" is recognized back, ending the section begun last.
+template<class TFIELDID> 
+void CSubstLogData<TFIELDID>::WritePlainText(ISubstTextSink &sink) const
+{
+    CSubstTextWriter writer(sink);
+    SubstDescr<TFIELDID> const* lpDesc;
+    tLogPos iLogCopied = 0;
+    size_t  nTxtLen;
+
+    for (INT_PTR ii = 0, nCount = GetLogInfoCount(); ii < nCount; ii++)
+    {
+        ESubstLogInfoKind kind = GetLogInfoKind(ii);
+        tLogPos iLogPos = GetLogInfoPos(ii);
+
+        if ((NULL == (lpDesc = MapKeeper().FindMapItem(GetLogInfoWhat(ii), nTxtLen))) && (eLogInfoField == kind))
+        {   // unknown field is skipped; the marker of a section is written without its text
+            ASSERT(FALSE);
+            continue;
+        }
+        ASSERT(iLogPos <= GetLogLength());
+        WriteLogTextEscaped(writer, iLogCopied, iLogPos);
+        if (eLogInfoField != kind)
+            writer.Write(m_markerPrefixes[kind], _tcslen(m_markerPrefixes[kind]));
+        if (NULL != lpDesc)
+            writer.Write(lpDesc->lpTxt, nTxtLen);
+        if (eLogInfoField != kind)
+            writer.Write(m_markerSuffix, _tcslen(m_markerSuffix));
+        iLogCopied = iLogPos;
+    }
+    WriteLogTextEscaped(writer, iLogCopied, GetLogLength());
+    writer.Flush();
+}
+
+// Writes the logical text [nFrom, nTo) with the special xml characters substituted for their entities.
+// The text is read in blocks of the writer's chunk size.
+template<class TFIELDID> 
+void CSubstLogData<TFIELDID>::WriteLogTextEscaped(CSubstTextWriter &writer, tLogPos nFrom, tLogPos nTo) const
+{
+    TCHAR   block[CSubstTextWriter::tChunkSize];
+    size_t  nBlock, ii, nEntity;
+
+    for (; nFrom < nTo; nFrom += nBlock)
+    {
+        nBlock = ((nTo - nFrom) < CSubstTextWriter::tChunkSize) ? (nTo - nFrom) : CSubstTextWriter::tChunkSize;
+        m_logStr.CopyTo(nFrom, nBlock, block);
+        for (ii = 0; ii < nBlock; ii++)
+        {
+            for (nEntity = 0; nEntity < tXmlEntities; nEntity++)
+            {
+                if (block[ii] == m_xmlChars[nEntity])
+                    break;
+            }
+            if (nEntity < tXmlEntities)
+                writer.Write(m_xmlEntities[nEntity], _tcslen(m_xmlEntities[nEntity]));
+            else
+                writer.Write(block[ii]);
+        }
+    }
 }
 
 template<class TFIELDID> 
 CSubstLogData<TFIELDID> & CSubstLogData<TFIELDID>::operator = (LPCTSTR szLogStr)
 {
-    this->Clear();
+    ClearContentsLogical();
     SetLogStr(szLogStr);
     return *this;
 }
@@ -586,16 +1247,25 @@ CSubstLogData<TFIELDID> & CSubstLogData<TFIELDID>::operator = (CSubstLogData<TFI
 template<class TFIELDID> 
 void CSubstLogData<TFIELDID>::Serialize(CArchive& ar)
 {
+    // The fields are archived as the list of CLogInfo, built just for that
+    CLogInfoList<TFIELDID> list;
+
     tSubstLogDataPredecessor::Serialize(ar);
 
+    // Version 1 has the same layout; the markers of sections it may contain are kept by CLogInfo
     if (ar.IsLoading())
     {
-        ar >> m_logStr;
+        DestroyList();
     }
     else
     {
-        ar << m_logStr;
+        CopyLogList(list);
+    }
+    m_logStr.Serialize(ar);
+    list.Serialize(ar);
+    if (ar.IsLoading())
+    {
+        RebuildFieldIndex(list);
     }
-    m_logList.Serialize(ar);
 }
 
@@ -32,7 +32,9 @@ typedef size_t                    tPhysPos;
 // CLASES
 /////////////////////////////////////////////////////////////////////////////
 
-/** CPhysInfo is a physical coordinate of field
+/** CPhysInfo is a physical coordinate of field.
+    Like CLogInfo, it is just the value of a field kept by the field index, 
+    built on demand by CSubstPhysData::GetPhysInfo; the archive keeps the list of them.
 */
 template<class TFIELDID> class CPhysInfo : public tPhysInfoPredecessor
 {
@@ -46,6 +48,7 @@ public:
    CPhysInfo();
    CPhysInfo(TFIELDID what);
    CPhysInfo(TFIELDID what, tPhysPos start, tPhysPos end);
+   CPhysInfo(CPhysInfo<TFIELDID> const& rhs);
    virtual ~CPhysInfo();
 
    TFIELDID  What(void) const
@@ -87,6 +90,7 @@ public:
 
 /** CSubstPhysList teplate is just a nickname for CPkTypedPtrArray of CPhysInfo<TFIELDID>*
     Its purpose is making long syntax more simple.
+    CSubstPhysData uses it just for the serialization.
 */
 template<class TFIELDID> class CSubstPhysList : public CPkTypedPtrArray<CObArray, CPhysInfo<TFIELDID>*>
 {
@@ -96,14 +100,20 @@ template<class TFIELDID> class CSubstPhysList : public CPkTypedPtrArray<CObArray
     i.e. an internal data of CSubstEdit control used during its editing.
     Note: CSubstPhysData do not have to be serialized; 
     they all will be reconstructed from serialied CSubstLogData.
+    The fields are kept by the same field index as the logical ones; 
+    the index keeps the field lengths, hence the physical positions are derived from logical ones.
+    The field queries return the index of the field, or -1 if there is none; 
+    see also GetPhysInfo.
+    The physical data are kept composed of the logical ones by all the modifications; 
+    the inherited methods modifying single logical fields are hidden, 
+    since they do not change the physical string. Use InsertNewInfo and DeleteOneInfo instead.
 */
 template<class TFIELDID> class CSubstPhysData  : public CSubstLogData<TFIELDID>
 {
    DECLARE_DYNCREATE_T(CSubstPhysData, TFIELDID)
 
 protected:
-   CString        m_physStr;
-   CSubstPhysList<TFIELDID> m_physlist;  // list of phys. positions
+   CSubstText     m_physStr;
 private:
 
 public:
@@ -114,40 +124,48 @@ public:
    virtual ~CSubstPhysData();
 
    LPCTSTR GetPhysStr(void) const
-    { return m_physStr; }
-   CString const &StrPhysStr(void) const
-    { return m_physStr; }
+    { return m_physStr.GetString(); }
+   size_t GetPhysLength(void) const
+    { return m_physStr.GetLength(); }
+   CString GetPhysStrPart(tPhysPos start, size_t nCount) const
+    { return m_physStr.Mid(start, nCount); }
    void  SetPhysStr(LPCTSTR szstr)
-    { m_physStr = szstr; }
-
-   CSubstPhysList<TFIELDID>& PhysList(void)
-     { return m_physlist; }
-   CSubstPhysList<TFIELDID> const & PhysListC(void) const
-     { return m_physlist; }
-
-   void   ClearContentsPhys(void);
+    { m_physStr.Assign(szstr); }
+
+   INT_PTR GetPhysInfoCount(void) const
+     { return this->GetLogInfoCount(); }
+   tPhysPos GetPhysInfoStart(INT_PTR nIndex) const
+     { ASSERT((0 <= nIndex) && (nIndex < GetPhysInfoCount())); return this->m_fieldIndex.GetStart((size_t)nIndex); }
+   tPhysPos GetPhysInfoEnd(INT_PTR nIndex) const
+     { ASSERT((0 <= nIndex) && (nIndex < GetPhysInfoCount())); return this->m_fieldIndex.GetEnd((size_t)nIndex); }
+   CPhysInfo<TFIELDID> GetPhysInfo(INT_PTR nIndex) const
+     { return CPhysInfo<TFIELDID>(this->GetLogInfoWhat(nIndex), GetPhysInfoStart(nIndex), GetPhysInfoEnd(nIndex)); }
+
+   virtual void   ClearContentsLogical(void);
    virtual void   DeleteContents(void);
 
-   CPhysInfo<TFIELDID>* FindMatch(CLogInfo<TFIELDID>* logInf) const;
-   CLogInfo<TFIELDID>*  FindMatch(CPhysInfo<TFIELDID>* physInf) const;
-   CPhysInfo<TFIELDID>* FindPhysInfoBefore(tPhysPos phpos) const;
-   CPhysInfo<TFIELDID>* FindPhysInfoAfter(tPhysPos phpos) const;
-   CPhysInfo<TFIELDID>* FindPhysInfoBetween(tPhysPos start, tPhysPos end) const;
-   INT_PTR   FindPhysInfoAllBetween(tPhysPos start, tPhysPos end, 
-       CTypedPtrArray<CObArray, CPhysInfo<TFIELDID>*> &output) const;
-   CPhysInfo<TFIELDID>* FindPhysInfoPosIsIn(tPhysPos phpos) const;
+   INT_PTR FindPhysInfoBefore(tPhysPos phpos) const;
+   INT_PTR FindPhysInfoAfter(tPhysPos phpos) const;
+   INT_PTR FindPhysInfoBetween(tPhysPos start, tPhysPos end) const;
+   INT_PTR FindPhysInfoAllBetween(tPhysPos start, tPhysPos end, INT_PTR &nFirst) const;
+   INT_PTR FindPhysInfoAllOverlapping(tPhysPos start, tPhysPos end, INT_PTR &nFirst) const;
+   INT_PTR FindPhysInfoPosIsIn(tPhysPos phpos) const;
 
    //// following methods DO correct positions of other items  //////////
-   CPhysInfo<TFIELDID>*  InsertNewInfo(tPhysPos phpos, TFIELDID what);
-   CPhysInfo<TFIELDID>*  InsertNewInfo(tPhysPos phpos, CLogInfo<TFIELDID> *lpLogInfo);
+   INT_PTR      InsertNewInfo(tPhysPos phpos, TFIELDID what);
+   INT_PTR      InsertNewInfo(tPhysPos phpos, CLogInfo<TFIELDID> const& logInfo);
 
-   BOOL         DeleteOneInfo(CPhysInfo<TFIELDID>* lpInf);
+   BOOL         DeleteOneInfo(INT_PTR nIndex);
    size_t       DeleteAllBetween(tPhysPos start, tPhysPos end);
    BOOL         InsertText(tPhysPos physIndex, LPCTSTR  sztext);
-   size_t       InsertData(tPhysPos physIndex, CSubstLogData<TFIELDID> &logData);
+   size_t       InsertData(tPhysPos physIndex, CSubstLogData<TFIELDID> const &logData);
+   virtual INT_PTR ReplaceLogTextAll(LPCTSTR szOldPart, LPCTSTR szNewPart);
+   virtual void Assign(CSubstLogData<TFIELDID> const &rhs);
+   virtual void AssignPlainText(LPCTSTR szText, BOOL bIgnoreCase = FALSE);
 
    //// conversions between log and phys /////////////////////////////////
    tLogPos PhysPos2LogPos(tPhysPos ph) const;
+   tPhysPos LogPos2PhysPos(tLogPos logpos) const;
    void   AppendAsPhysInfo(CSubstLogData<TFIELDID> const & logData);
    void   AssignPhysFromLog(CSubstLogData<TFIELDID> const & logData);
    void   ExportLogListAll(CSubstLogData<TFIELDID> & logData) const;
@@ -155,6 +173,11 @@ public:
    void   ExportLogAll(CSubstLogData<TFIELDID> & logData) const;
    void   ExportLogSel(LPCCSelInfo selInf, CSubstLogData<TFIELDID> & logData) const;
 
+   //// consistency checks, used by ASSERT ////////////////////////////////
+   BOOL   IsConsistent(void) const;
+   BOOL   IsConsistentRegion(tPhysPos start, tPhysPos end) const;
+   BOOL   IsConsistentAfterEdit(tPhysPos start, tPhysPos end) const;
+
    void   AssignPhysData(CSubstPhysData<TFIELDID> const& what);
    static CString PhysStr2logStr(
        CSubstPhysData<TFIELDID> const& physData, 
@@ -166,50 +189,22 @@ public:
    CSubstPhysData<TFIELDID>& operator = (CSubstPhysData<TFIELDID> const& rhs);
 
 protected:
-   void MoveAllPhysInfoGreaterEq(tPhysPos greaterOrEq, size_t by);
+   // modify the logical fields only; see InsertNewInfo and DeleteOneInfo
+   using CSubstLogData<TFIELDID>::SetLogInfo;
+   using CSubstLogData<TFIELDID>::AppenNewLogInfo;
+   using CSubstLogData<TFIELDID>::AppendLogInfo;
+   using CSubstLogData<TFIELDID>::InsertLogInfo;
+   using CSubstLogData<TFIELDID>::RemoveLogInfo;
+
+   void ClearContentsPhys(void);
    void MoveAllInfoIfPhysGreaterEq(tPhysPos greaterOrEq, size_t by);
 
    //// following methods DO NOT correct positions of other items //////////
-   void    InsertPhysInfo(INT_PTR indexBefore, CPhysInfo<TFIELDID>* lpPhysInfo);
-   void    InsertPhysInfo(CPhysInfo<TFIELDID>* lpPhysInfoBefore, CPhysInfo<TFIELDID>* lpPhysInfo);
-
-   CPhysInfo<TFIELDID>*  AddNewPhysInfo(TFIELDID  what);
-   INT_PTR AppendPhysToList(CPhysInfo<TFIELDID>const* lpPhysInfo);
-
-   void   RemovPhysInfo(INT_PTR nIndex);
-   BOOL   RemovPhysInfo(CPhysInfo<TFIELDID>* lpPhysInfo);
-
-   void  AssignPhysList(CSubstPhysList<TFIELDID> const &list);
-
-private:
-   static BOOL CALLBACK FnPhysInfoPosLowerEq(CPhysInfo<TFIELDID>* phinf, WPARAM wParam, LPARAM lParam)
-   {
-       return (phinf->GetEnd() <= (tPhysPos)wParam);
-   }
-
-   static BOOL CALLBACK FnPhysInfoPosGreaterEq(CPhysInfo<TFIELDID>* phinf, WPARAM wParam, LPARAM lParam)
-   {
-       return (phinf->GetStart() >= (tPhysPos)wParam);
-   }
+   void   RemoveInfo(INT_PTR nIndex, INT_PTR nCount = 1);
 
-    static BOOL CALLBACK FnPhysInfoBetween(CPhysInfo<TFIELDID>* phinf, WPARAM wParam, LPARAM lParam)
-    {
-        return (phinf->GetStart() >= (tPhysPos)wParam) && (phinf->GetEnd() <= (tPhysPos)lParam);
-    }
-
-    static BOOL CALLBACK FnPhysInfoPosIsIn(CPhysInfo<TFIELDID>* phinf, WPARAM wParam, LPARAM lParam)
-    {
-        return (phinf->GetStart() < (tPhysPos)wParam) && ((tPhysPos)wParam < phinf->GetEnd());
-    }
-
-    static void CALLBACK FnMoveAllPhysInfoGreaterEq(CPhysInfo<TFIELDID>* phinf, WPARAM wParam, LPARAM lParam)
-    {
-        if (phinf->GetStart() >= (tPhysPos)wParam)
-        {
-            phinf->Add2Start(lParam);
-            phinf->Add2End(lParam);
-        }
-    }
+   void  AssignPhysList(CSubstPhysData<TFIELDID> const &what);
+   void  CopyPhysList(CSubstPhysList<TFIELDID> &list) const;
+   void  AttachPhysList(CSubstPhysList<TFIELDID> const &list);
 };
 
 #include "SubstObjectsPhysical.hpp"
@@ -53,6 +53,12 @@ CPhysInfo<TFIELDID>::CPhysInfo(
     SetEnd(end);
 }
 
+template<class TFIELDID> 
+CPhysInfo<TFIELDID>::CPhysInfo(CPhysInfo<TFIELDID> const& rhs) 
+    : tPhysInfoPredecessor(), m_what(rhs.m_what), m_start(rhs.m_start), m_end(rhs.m_end)
+{
+}
+
 template<class TFIELDID> 
 CPhysInfo<TFIELDID>::~CPhysInfo()
 {
@@ -141,7 +147,7 @@ CSubstPhysData<TFIELDID>::CSubstPhysData(CSubstLogData<TFIELDID> const & logData
 
 template<class TFIELDID> 
 CSubstPhysData<TFIELDID>::CSubstPhysData(
-    CSubstPhysData<TFIELDID> const &pattern) : CSubstLogData()
+    CSubstPhysData<TFIELDID> const &pattern) : CSubstLogData<TFIELDID>()
 {
     *this = pattern;
 }
@@ -155,192 +161,101 @@ CSubstPhysData<TFIELDID>::~CSubstPhysData()
 template<class TFIELDID> 
 void CSubstPhysData<TFIELDID>::ClearContentsPhys(void)
 {
-    PhysList().DeleteAndRemoveAll();
+    this->m_fieldIndex.ResetLengths();
     m_physStr.Empty();
 }
 
 template<class TFIELDID> 
-void CSubstPhysData<TFIELDID>::DeleteContents(void)
+void CSubstPhysData<TFIELDID>::ClearContentsLogical(void)
 {
-    CSubstLogData<TFIELDID>::DeleteContents();
+    CSubstLogData<TFIELDID>::ClearContentsLogical();
     ClearContentsPhys();
 }
 
 template<class TFIELDID> 
-CPhysInfo<TFIELDID>* CSubstPhysData<TFIELDID>::AddNewPhysInfo(TFIELDID  what)
-{
-    CPhysInfo<TFIELDID>* lpPhysInfo = NULL;
-
-    try
-    {
-        if (lpPhysInfo = new CPhysInfo<TFIELDID>(what))
-        {
-            AppendPhysToList(lpPhysInfo);
-        }
-    }
-    catch(CException *e)
-    {
-        e->Delete();
-        lpPhysInfo = NULL;
-    }
-
-    return lpPhysInfo;
-}
-
-template<class TFIELDID> 
-void CSubstPhysData<TFIELDID>::MoveAllPhysInfoGreaterEq(tPhysPos greaterOrEq, size_t by)
+void CSubstPhysData<TFIELDID>::DeleteContents(void)
 {
-    PhysList().ForEach(FnMoveAllPhysInfoGreaterEq, (WPARAM)greaterOrEq, (LPARAM)by);
+    CSubstLogData<TFIELDID>::DeleteContents();
+    ClearContentsPhys();
 }
 
+// Moves all fields starting on or after greaterOrEq, both logically and physically.
+// Since positions are gap-encoded, just one gap is updated, which takes O(log n).
 template<class TFIELDID> 
 void CSubstPhysData<TFIELDID>::MoveAllInfoIfPhysGreaterEq(tPhysPos greaterOrEq, size_t by)
 {
-    INT_PTR nDex, nSize;
-    CLogInfo<TFIELDID>*  lpLogTmp;
-    CPhysInfo<TFIELDID>* lpPhysTmp;
+    size_t nFirst = this->m_fieldIndex.LowerBoundStart(greaterOrEq);
 
-    for(nDex = 0, nSize = this->LogListC().GetSize(); nDex < nSize; nDex++)
-    {
-        VERIFY(lpLogTmp = this->LogListC().GetAt(nDex));
-        VERIFY(lpPhysTmp = PhysListC().GetAt(nDex));
-        ASSERT(lpPhysTmp->What() == lpLogTmp->What());
-        if (lpPhysTmp->GetStart() >= greaterOrEq)
-        {
-            lpPhysTmp->Add2Start(by);
-            lpPhysTmp->Add2End(by);
-            lpLogTmp->Add2Pos(by);
-        }
-    }
+    this->m_fieldIndex.ShiftFrom(nFirst, (CSubstFieldIndex::tDelta)by);
 }
 
+// finding last field located before or on given tPhysPos 
 template<class TFIELDID> 
-CPhysInfo<TFIELDID>* CSubstPhysData<TFIELDID>::FindMatch(CLogInfo<TFIELDID>* lplogInf) const
+INT_PTR CSubstPhysData<TFIELDID>::FindPhysInfoBefore(tPhysPos phpos) const
 {
-    INT_PTR nDex;
-    CPhysInfo<TFIELDID>* lpPhys = NULL;
-
-    if (0 <= (nDex = GetLogInfoIndex(lplogInf)))
-    {
-        lpPhys = PhysListC().GetAt(nDex);
-    }
-    return lpPhys;
+    return this->m_fieldIndex.FindLastEndingAtOrBefore(phpos);
 }
 
+// finding first field located after or on given tPhysPos 
 template<class TFIELDID> 
-CLogInfo<TFIELDID>* CSubstPhysData<TFIELDID>::FindMatch(CPhysInfo<TFIELDID>* physInf) const
+INT_PTR CSubstPhysData<TFIELDID>::FindPhysInfoAfter(tPhysPos phpos) const
 {
-    INT_PTR nDex;
-    CLogInfo<TFIELDID>*  lpLog = NULL;
-
-    if (0 <= (nDex = PhysListC().Find(physInf)))
-    {
-        lpLog = this->LogListC().GetAt(nDex);
-    }
-    return lpLog;
+    return this->m_fieldIndex.FindFirstStartingAtOrAfter(phpos);
 }
 
-// finding last CPhysInfo<TFIELDID>* located before or on given tPhysPos 
+// finding first field located between start and end
 template<class TFIELDID> 
-CPhysInfo<TFIELDID>* CSubstPhysData<TFIELDID>::FindPhysInfoBefore(tPhysPos phpos) const
+INT_PTR CSubstPhysData<TFIELDID>::FindPhysInfoBetween(tPhysPos start, tPhysPos end) const
 {
-    INT_PTR nDex = PhysListC().LastThat(FnPhysInfoPosLowerEq, (WPARAM)phpos);
-    return (nDex >= 0) ? PhysListC().GetAt(nDex) : NULL;
+    return this->m_fieldIndex.FindFirstInside(start, end);
 }
 
-// finding first CPhysInfo<TFIELDID>* located after or on given tPhysPos 
+// finding all fields located between start and end; 
+// returns their count, the fields are those with index in [nFirst, nFirst + count)
 template<class TFIELDID> 
-CPhysInfo<TFIELDID>* CSubstPhysData<TFIELDID>::FindPhysInfoAfter(tPhysPos phpos) const
+INT_PTR CSubstPhysData<TFIELDID>::FindPhysInfoAllBetween(tPhysPos start, tPhysPos end, INT_PTR &nFirst) const
 {
-    INT_PTR nDex = PhysListC().FirstThat(FnPhysInfoPosGreaterEq, (WPARAM)phpos);
-    return (nDex >= 0) ? PhysListC().GetAt(nDex) : NULL;
-}
+    size_t nDex;
+    size_t nCount = this->m_fieldIndex.FindRangeInside(start, end, nDex);
 
-// finding first CPhysInfo<TFIELDID>* located between start and end
-template<class TFIELDID> 
-CPhysInfo<TFIELDID>* CSubstPhysData<TFIELDID>::FindPhysInfoBetween(tPhysPos start, tPhysPos end) const
-{
-    INT_PTR nDex = PhysListC().FirstThat(FnPhysInfoBetween, (WPARAM)start, (LPARAM)end);
-    return (nDex >= 0) ? PhysListC().GetAt(nDex) : NULL;
+    nFirst = (INT_PTR)nDex;
+    return (INT_PTR)nCount;
 }
 
+// finding all fields overlapping the range [start, end); 
+// returns their count, the fields are those with index in [nFirst, nFirst + count)
 template<class TFIELDID> 
-INT_PTR CSubstPhysData<TFIELDID>::FindPhysInfoAllBetween(tPhysPos start, tPhysPos end,
-    CTypedPtrArray<CObArray, CPhysInfo<TFIELDID>*> &output) const
+INT_PTR CSubstPhysData<TFIELDID>::FindPhysInfoAllOverlapping(tPhysPos start, tPhysPos end, INT_PTR &nFirst) const
 {
-    return PhysListC().FindAllThat(FnPhysInfoBetween, output, (WPARAM)start, (LPARAM)end);
-}
+    size_t nDex;
+    size_t nCount = this->m_fieldIndex.FindRangeOverlapping(start, end, nDex);
 
-// finding first CPhysInfo<TFIELDID>* located around (containing) given tPhysPos
-template<class TFIELDID> 
-CPhysInfo<TFIELDID>* CSubstPhysData<TFIELDID>::FindPhysInfoPosIsIn(tPhysPos phpos) const
-{
-    INT_PTR nDex = PhysListC().FirstThat(FnPhysInfoPosIsIn, (WPARAM)phpos);
-    return (nDex >= 0) ? PhysListC().GetAt(nDex) : NULL;
+    nFirst = (INT_PTR)nDex;
+    return (INT_PTR)nCount;
 }
 
-//// following methods DO NOT correct positions of other items /////////////////////////////////////////////////
+// finding first field located around (containing) given tPhysPos
 template<class TFIELDID> 
-INT_PTR CSubstPhysData<TFIELDID>::AppendPhysToList(CPhysInfo<TFIELDID>const* lpPhysInfo)
+INT_PTR CSubstPhysData<TFIELDID>::FindPhysInfoPosIsIn(tPhysPos phpos) const
 {
-    return PhysList().Add(const_cast<CPhysInfo<TFIELDID>*>(lpPhysInfo));
-}
-
-template<class TFIELDID> 
-void CSubstPhysData<TFIELDID>::InsertPhysInfo(
-    INT_PTR     indexBefore, 
-    CPhysInfo<TFIELDID>* lpPhysInfo)
-{
-    if (0 <= indexBefore)
-    {
-        PhysList().InsertAt(indexBefore, lpPhysInfo);
-    }
-    else
-    {
-        PhysList().Add(lpPhysInfo);
-    }
-}
-
-template<class TFIELDID> 
-void  CSubstPhysData<TFIELDID>::InsertPhysInfo(
-    CPhysInfo<TFIELDID>* lpPhysInfoBefore, 
-    CPhysInfo<TFIELDID>* lpPhysInfo)
-{
-    if (lpPhysInfoBefore)
-    {
-        InsertPhysInfo(PhysListC().Find(lpPhysInfoBefore), lpPhysInfo);
-    }
-    else
-    {
-        AppendPhysToList(lpPhysInfo);
-    }
-}
-
-template<class TFIELDID> 
-void CSubstPhysData<TFIELDID>::RemovPhysInfo(
-    INT_PTR nIndex)
-{
-    this->PhysList().DeleteAndRemoveAt(nIndex);
+    return this->m_fieldIndex.FindContaining(phpos);
 }
 
+//// following methods DO NOT correct positions of other items /////////////////////////////////////////////////
+// Removes nCount fields, both logically and physically; 
+// removing their lengths from the field index moves all following fields physically.
 template<class TFIELDID> 
-BOOL  CSubstPhysData<TFIELDID>::RemovPhysInfo(
-    CPhysInfo<TFIELDID>* lpPhysInfo)
+void CSubstPhysData<TFIELDID>::RemoveInfo(
+    INT_PTR nIndex,
+    INT_PTR nCount)
 {
-    INT_PTR nDex;
-    BOOL    result = FALSE;
-
-    if (0 <= (nDex = PhysListC().Find(lpPhysInfo)))
-    {
-        RemovPhysInfo(nDex);
-        result = TRUE;
-    }
-    return result;
+    ASSERT((0 <= nIndex) && (nIndex + nCount <= GetPhysInfoCount()));
+    this->RemoveLogInfo(nIndex, nCount);
 }
 
 //// Following methods DO correct positions of other items //////////
 template<class TFIELDID> 
-CPhysInfo<TFIELDID>*  CSubstPhysData<TFIELDID>::InsertNewInfo(
+INT_PTR  CSubstPhysData<TFIELDID>::InsertNewInfo(
     tPhysPos  phpos, 
     TFIELDID  what)
 {
@@ -349,87 +264,64 @@ CPhysInfo<TFIELDID>*  CSubstPhysData<TFIELDID>::InsertNewInfo(
 
     if (NULL == (lpDesc = this->FindMapItem(what)))
     {
-        ASSERT(FALSE); return NULL;
+        ASSERT(FALSE); return -1;
     }
     logpos = PhysPos2LogPos(phpos);
-    return InsertNewInfo(phpos, new CLogInfo<TFIELDID>(what, logpos));
+    return InsertNewInfo(phpos, CLogInfo<TFIELDID>(what, logpos));
 }
 
+// Inserts the field logInfo on the physical position phpos; returns its index, or -1 in case of failure.
+// The marker of a section not having a text in the map takes no physical text.
 template<class TFIELDID> 
-CPhysInfo<TFIELDID>*  CSubstPhysData<TFIELDID>::InsertNewInfo(
+INT_PTR  CSubstPhysData<TFIELDID>::InsertNewInfo(
     tPhysPos      phpos, 
-    CLogInfo<TFIELDID> *lpLogInfo)
+    CLogInfo<TFIELDID> const& logInfo)
 {
-    size_t     ilen;
-    CString    strLeft, strRight, oldphysStr, newphysStr;
-    LPCTSTR    lpTxt;
-    TFIELDID   what;
+    size_t     ilen = 0;
+    LPCTSTR    lpTxt = _T("");
+    INT_PTR    nDex;
     SubstDescr<TFIELDID> const* lpDesc;
-    CPhysInfo<TFIELDID>*   lpPhysInfo;
-    CPhysInfo<TFIELDID>*   lpPhysBefore;
-    CLogInfo<TFIELDID>*    lpLogBefore;
-
-    if (NULL == (lpDesc = this->FindMapItem(what = lpLogInfo->What())))
-    {
-        ASSERT(FALSE); return NULL;
-    }
-    ilen = _tcslen(lpTxt = lpDesc->lpTxt);
 
-    try
+    if (NULL != (lpDesc = this->FindMapItem(logInfo.What(), ilen)))
     {
-        lpPhysInfo = new CPhysInfo<TFIELDID>(what, phpos, phpos + ilen);
+        lpTxt = lpDesc->lpTxt;
     }
-    catch(CException *e)
+    else if (logInfo.IsField())
     {
-        e->Delete(); 
-        return NULL;
+        ASSERT(FALSE); return -1;
     }
 
-    if (lpPhysBefore = FindPhysInfoAfter(phpos))
-    {
-        lpLogBefore = FindMatch(lpPhysBefore);
-        MoveAllPhysInfoGreaterEq(phpos, ilen);
-        this->InsertLogInfo(lpLogBefore, lpLogInfo);
-        this->InsertPhysInfo(lpPhysBefore, lpPhysInfo);
-    }
-    else
-    {
-        this->AppendLogInfo(lpLogInfo);
-        this->AppendPhysToList(lpPhysInfo);
-    }
+    // Insert before the first field located after or on phpos; 
+    // the length of the new field moves all following fields physically.
+    ASSERT(logInfo.GetPos() == PhysPos2LogPos(phpos));
+    nDex = this->InsertLogInfo((INT_PTR)this->m_fieldIndex.LowerBoundStart(phpos), logInfo);
+    this->m_fieldIndex.SetLength((size_t)nDex, ilen);
+    ASSERT(GetPhysInfoStart(nDex) == phpos);
 
-    oldphysStr = StrPhysStr();
-    strLeft  = oldphysStr.Left((int)phpos);
-    strRight = oldphysStr.Right((int)(oldphysStr.GetLength() - phpos));
-    newphysStr = strLeft + lpTxt + strRight;
-    ASSERT(newphysStr == this->LogStr2PhysStr(*this));
-    SetPhysStr(newphysStr);
+    m_physStr.Insert(phpos, lpTxt);
+    ASSERT(IsConsistentAfterEdit(phpos, phpos + ilen));
 
-    return lpPhysInfo;
+    return nDex;
 }
 
 template<class TFIELDID> 
 BOOL CSubstPhysData<TFIELDID>::DeleteOneInfo(
-    CPhysInfo<TFIELDID>* lpInf)
+    INT_PTR nIndex)
 {
     size_t     ilen;
-    CLogInfo<TFIELDID>* lpLog;
     tPhysPos   start;
-    CString    strTmp;
     BOOL       bRes   = FALSE;
 
-    if ((NULL != lpInf) && (NULL != (lpLog = FindMatch(lpInf))))
+    if ((0 <= nIndex) && (nIndex < GetPhysInfoCount()))
     {
-        start = lpInf->GetStart();
-        ilen = lpInf->GetLength();
+        start = GetPhysInfoStart(nIndex);
+        ilen = this->m_fieldIndex.GetLength((size_t)nIndex);
 
-        this->RemovPhysInfo(lpInf);
-        this->RemoveLogInfo(lpLog);
+        // removing the field length moves all following fields physically
+        RemoveInfo(nIndex);
         if (ilen > 0)
         {
-            MoveAllPhysInfoGreaterEq(start, -ilen);
-            strTmp = extractSubstr(GetPhysStr(), start, ilen);
-            SetPhysStr(strTmp);
+            m_physStr.Delete(start, ilen);
         }
         bRes = TRUE;
     }
@@ -445,36 +337,34 @@ size_t CSubstPhysData<TFIELDID>::DeleteAllBetween(
     tPhysPos      start, 
     tPhysPos      end)
 {
-    CPhysInfo<TFIELDID>* lpInf;
-    CString     strTmp, strLog, strPhys;
-    tLogPos     nStart;
-    size_t      ilen, log_dx;
+    size_t      nFirst, nCount;
+    size_t      fields_dx, log_dx;
     size_t      phys_dx = end - start;
-    tPhysPos    tempEnd   = end;
+    tLogPos     nStart = PhysPos2LogPos(start);
 
-    while (lpInf = FindPhysInfoBetween(start, tempEnd))
+    // All the fields inside are removed at once; they take fields_dx of the physical text, 
+    // the rest is the plain text present in the logical text as well.
+    nCount = this->m_fieldIndex.FindRangeInside(start, end, nFirst);
+    fields_dx = this->m_fieldIndex.GetLengthBefore(nFirst + nCount) - this->m_fieldIndex.GetLengthBefore(nFirst);
+    ASSERT(fields_dx <= phys_dx);
+    log_dx = phys_dx - fields_dx;
+
+    if (0 < nCount)
+    {   // the gaps of removed fields are merged to the next field; its physical start moves by fields_dx
+        RemoveInfo((INT_PTR)nFirst, (INT_PTR)nCount);
+    }
+    if (0 < phys_dx)
     {
-        ilen = lpInf->GetLength();
-        DeleteOneInfo(lpInf);
-        tempEnd -= ilen;
+        m_physStr.Delete(start, phys_dx);
     }
-
-    if ((log_dx = tempEnd - start) > 0)
+    if (0 < log_dx)
     {
-        strPhys = extractSubstr(GetPhysStr(), start, log_dx);
-        SetPhysStr(strPhys);
-
-        nStart = PhysPos2LogPos(start);
-        strLog = extractSubstr(this->GetLogStr(), nStart, log_dx);
-        this->SetLogStr(strLog);
+        this->m_logStr.Delete(nStart, log_dx);
         MoveAllInfoIfPhysGreaterEq(start, -log_dx);
-
-#ifdef _DEBUG
-        strTmp = this->LogStr2PhysStr(*this);
-        ASSERT(strTmp == strPhys);
-#endif
     }
 
+    ASSERT(IsConsistentAfterEdit(start, start));
+
     return phys_dx;
 }
 
@@ -485,11 +375,11 @@ BOOL CSubstPhysData<TFIELDID>::InsertText(
 {
     BOOL  res = FALSE;
 
-    if ((physIndex < 0) || (physIndex > (tPhysPos)StrPhysStr().GetLength()))
+    if ((physIndex < 0) || (physIndex > GetPhysLength()))
     {   // invalid index - out of range
         ASSERT(FALSE);
     }
-    else if (NULL != FindPhysInfoPosIsIn(physIndex))
+    else if (0 <= FindPhysInfoPosIsIn(physIndex))
     {   // invalid index - request for insertion in middle of some field ?!
         ASSERT(FALSE);
     }
@@ -501,19 +391,10 @@ BOOL CSubstPhysData<TFIELDID>::InsertText(
 
         if ((ilen = strText.GetLength()) > 0)
         {
-            CString  strPhysNew(GetPhysStr());
-            CString  strLogNew(this->GetLogStr());
-
-            strPhysNew.Insert((int)physIndex, sztext);
-            strLogNew.Insert((int)logIndex, sztext);
-
-            SetPhysStr(strPhysNew);
-            this->SetLogStr(strLogNew);
+            m_physStr.Insert(physIndex, sztext);
+            this->m_logStr.Insert(logIndex, sztext);
             MoveAllInfoIfPhysGreaterEq(physIndex, ilen);
-#ifdef DEBUG
-			CString  strTmp = PhysStr2logStr(*this, &this->MapKeeper());
-            ASSERT(strLogNew == strTmp);
-#endif // DEBUG
+            ASSERT(IsConsistentAfterEdit(physIndex, physIndex + ilen));
         }
         res = TRUE;
     }
@@ -521,88 +402,211 @@ BOOL CSubstPhysData<TFIELDID>::InsertText(
     return res;
 }
 
+// Inserts the logical text and fields of logData on the physical position physIndex.
+// Returns the total physical length inserted.
+// Note: logData does not change; its fields are copied.
 template<class TFIELDID> 
 size_t CSubstPhysData<TFIELDID>::InsertData(
-    tPhysPos physIndex, CSubstLogData<TFIELDID> &logData)
+    tPhysPos physIndex, CSubstLogData<TFIELDID> const &logData)
 {
-    LPCTSTR szLog;
-    size_t nSuma = 0;
+    LPCTSTR   szLog = logData.GetLogStr();
+    std::vector<CLogInfo<TFIELDID> > logNew;
+    std::vector<size_t> lengths;
+    SubstDescr<TFIELDID> const* lpDesc;
+    CString   strPhys;
+    tLogPos   logIndex, lastLogPos = 0;
+    size_t    ii, nDex, nLogLen = logData.GetLogLength();
+
+    if ((physIndex > GetPhysLength()) || (0 <= FindPhysInfoPosIsIn(physIndex)))
+    {   // out of range, or request for insertion in middle of some field ?!
+        ASSERT(FALSE); 
+        return 0;
+    }
+
+    // The inserted fields go before all fields located on or after physIndex, 
+    // like the inserted text does.
+    nDex = this->m_fieldIndex.LowerBoundStart(physIndex);
+    logIndex = PhysPos2LogPos(physIndex);
+
+    // Create the inserted physical text and fields, in one pass through logData
+    logNew.reserve((size_t)logData.GetLogInfoCount());
+    lengths.reserve((size_t)logData.GetLogInfoCount());
+    for (INT_PTR nField = 0, nCount = logData.GetLogInfoCount(); nField < nCount; nField++)
+    {
+        TFIELDID what = logData.GetLogInfoWhat(nField);
+        tLogPos logPos = logData.GetLogInfoPos(nField);
+        ESubstLogInfoKind kind = logData.GetLogInfoKind(nField);
+        size_t  nTxtLen = 0;
+
+        if ((NULL == (lpDesc = this->FindMapItem(what, nTxtLen))) && (eLogInfoField == kind))
+        {   // unknown field is skipped; the marker of a section takes no physical text
+            ASSERT(FALSE); 
+            continue;
+        }
+        strPhys.Append(szLog + lastLogPos, (int)(logPos - lastLogPos));
+        lastLogPos = logPos;
+        logNew.push_back(CLogInfo<TFIELDID>(what, logIndex + logPos, kind));
+        lengths.push_back(nTxtLen);
+        if (NULL != lpDesc)
+            strPhys.Append(lpDesc->lpTxt, (int)nTxtLen);
+    }
+    strPhys.Append(szLog + lastLogPos, (int)(nLogLen - lastLogPos));
 
-    if (this->InsertText(physIndex, szLog = logData.GetLogStr()))
-    { 
-        nSuma = _tcslen(szLog);
+    // Splice the texts once, shift following fields once, and merge the fields once
+    m_physStr.Insert(physIndex, strPhys);
+    this->m_logStr.Insert(logIndex, szLog);
+    if (0 < nLogLen)
+    {
+        MoveAllInfoIfPhysGreaterEq(physIndex, nLogLen);
+    }
+    this->InsertLogInfo((INT_PTR)nDex, logNew);
+    for (ii = 0; ii < lengths.size(); ii++)
+    {
+        this->m_fieldIndex.SetLength(nDex + ii, lengths[ii]);
+    }
 
-        tLogPos  const beginLogPos = PhysPos2LogPos(physIndex);
-        tPhysPos  insertPhysIndex = physIndex;
-        CLogInfoList<TFIELDID> &list = logData.LogList();
+    ASSERT(IsConsistentAfterEdit(physIndex, physIndex + strPhys.GetLength()));
+    return (size_t)strPhys.GetLength();
+}
 
-        for (tLogPos lasFieldLogPos = 0; list.GetCount() > 0; )
-        {
-            size_t nLen;
-            CPhysInfo<TFIELDID>* phInfo;
-            CLogInfo<TFIELDID>* logInfo = list.GetAt(0);
-            size_t deltaLogPos = logInfo->GetPos() - lasFieldLogPos;
+// Replaces all occurrences of szOldPart in the logical text, and rebuilds the physical string.
+// Lengths of fields do not change, so their physical positions follow the logical ones.
+template<class TFIELDID> 
+INT_PTR CSubstPhysData<TFIELDID>::ReplaceLogTextAll(LPCTSTR szOldPart, LPCTSTR szNewPart)
+{
+    INT_PTR nCount = CSubstLogData<TFIELDID>::ReplaceLogTextAll(szOldPart, szNewPart);
+
+    if (0 < nCount)
+    {
+        SetPhysStr(this->LogStr2PhysStr(*this));
+        ASSERT(IsConsistentAfterEdit(0, GetPhysLength()));
+    }
+    return nCount;
+}
+
+// Checks the consistency of the whole physical and logical data. Takes O(n).
+template<class TFIELDID> 
+BOOL CSubstPhysData<TFIELDID>::IsConsistent(void) const
+{
+    return IsConsistentRegion(0, GetPhysLength()) && (this->LogStr2PhysStr(*this) == GetPhysStr());
+}
+
+// Checks the consistency of the physical and logical data in the region [start, end) 
+// extended by CSubstValidation::GetContext() characters on both sides: 
+// the fields overlapping it, their texts, and the plain text between them.
+// Besides the global counts and lengths, takes O(region + log n).
+template<class TFIELDID> 
+BOOL CSubstPhysData<TFIELDID>::IsConsistentRegion(tPhysPos start, tPhysPos end) const
+{
+    CSubstFieldIndex const &index = this->m_fieldIndex;
+    size_t   nContext = CSubstValidation::GetContext();
+    size_t   nPhysLen = GetPhysLength();
+    size_t   nCount = index.GetCount();
+    size_t   ii, nFirst, nEnd, nPart;
+    tPhysPos winStart, winEnd, pos;
+    tLogPos  logpos;
+    SubstDescr<TFIELDID> const* lpDesc;
 
-            insertPhysIndex += deltaLogPos;
-            lasFieldLogPos = logInfo->GetPos();
-            logInfo->Add2Pos(beginLogPos);
+    if (nPhysLen != this->GetLogLength() + index.GetLengthBefore(nCount))
+        return FALSE;
+    if ((start > end) || (end > nPhysLen))
+        return FALSE;
 
-            phInfo = InsertNewInfo(insertPhysIndex, logInfo);
-            insertPhysIndex += (nLen = phInfo->GetLength());
-            nSuma += nLen;
+    // extend the region by the context, and then to whole fields touching it
+    winStart = (start > nContext) ? (start - nContext) : 0;
+    winEnd = (nPhysLen - end > nContext) ? (end + nContext) : nPhysLen;
+    nFirst = (0 < winStart) ? index.UpperBoundEnd(winStart - 1) : 0;
+    nEnd = index.LowerBoundStart(winEnd + 1);
+    if (nFirst < nEnd)
+    {
+        if (index.GetStart(nFirst) < winStart)
+            winStart = index.GetStart(nFirst);
+        if (index.GetEnd(nEnd - 1) > winEnd)
+            winEnd = index.GetEnd(nEnd - 1);
+    }
 
-            list.RemoveAt(0);
+    pos = winStart;
+    logpos = index.PhysPos2LogPos(winStart);
+    for (ii = nFirst; ii < nEnd; ii++)
+    {
+        tPhysPos fieldStart = index.GetStart(ii);
+
+        if ((fieldStart < pos) || (index.GetLogPos(ii) != logpos + (fieldStart - pos)))
+            return FALSE;
+        if (m_physStr.Mid(pos, fieldStart - pos) != this->m_logStr.Mid(logpos, fieldStart - pos))
+            return FALSE;
+
+        if (NULL != (lpDesc = this->FindMapItem(this->GetLogInfoWhat((INT_PTR)ii))))
+        {
+            if (m_physStr.Mid(fieldStart, index.GetLength(ii)) != lpDesc->lpTxt)
+                return FALSE;
         }
+        else if ((eLogInfoField == this->GetLogInfoKind((INT_PTR)ii)) || (0 != index.GetLength(ii)))
+        {   // only the marker of a section may have no text
+            return FALSE;
+        }
+
+        logpos += fieldStart - pos;
+        pos = index.GetEnd(ii);
     }
-    return nSuma;
+    nPart = winEnd - pos;
+    if (logpos + nPart > this->GetLogLength())
+        return FALSE;
+    return (m_physStr.Mid(pos, nPart) == this->m_logStr.Mid(logpos, nPart));
 }
 
+// Checks the consistency after the modification of the region [start, end),
+// as the current validation level requires. Called once per modification, so it counts the samples.
 template<class TFIELDID> 
-tLogPos CSubstPhysData<TFIELDID>::PhysPos2LogPos(tPhysPos ph) const
+BOOL CSubstPhysData<TFIELDID>::IsConsistentAfterEdit(tPhysPos start, tPhysPos end) const
 {
-    INT_PTR      nDex, nSize;
-    CPhysInfo<TFIELDID>*  lpTmp;
-    tLogPos      result = ph;
+    CSubstValidation::OnModified();
+    if (CSubstValidation::IsFullCheckDue())
+        return IsConsistent();
+    if (CSubstValidation::IsIncremental())
+        return IsConsistentRegion(start, end);
+    return TRUE;
+}
 
-    for (nDex = 0, nSize = PhysListC().GetCount(); nDex < nSize; nDex++)
-    {
-        VERIFY(lpTmp = PhysListC().GetAt(nDex));
-        if (lpTmp->GetEnd() <= ph)
-            result -= lpTmp->GetLength();
-    }
+// Converts the physical position to logical one, 
+// by subtracting lengths of all fields located before or on given position.
+template<class TFIELDID> 
+tLogPos CSubstPhysData<TFIELDID>::PhysPos2LogPos(tPhysPos ph) const
+{
+    return this->m_fieldIndex.PhysPos2LogPos(ph);
+}
 
-    return result;
+// Converts the logical position to physical one, 
+// by adding lengths of all fields located before or on given position.
+// If there are fields located exactly on logpos, the result is the position after them.
+template<class TFIELDID> 
+tPhysPos CSubstPhysData<TFIELDID>::LogPos2PhysPos(tLogPos logpos) const
+{
+    return this->m_fieldIndex.LogPos2PhysPos(logpos);
 }
 
+// Composes the fields physically, setting their lengths to those of field texts.
+// The fields of logData must match those kept by this object; 
+// actually AssignPhysFromLog calls it just for this object itself.
 template<class TFIELDID> 
 void CSubstPhysData<TFIELDID>::AppendAsPhysInfo(
     CSubstLogData<TFIELDID> const & logData)
 {
-    CLogInfo<TFIELDID>*    lplogInf;
-    CPhysInfo<TFIELDID>*   physInf;
     SubstDescr<TFIELDID> const* lpDesc;
     size_t        ilen;
     INT_PTR       nDex, nCount;    
-    tPhysPos      start, end, suma;
-    tLogPos       iLogPos = 0;
-    LPCTSTR       lpTxt = NULL;
 
-    ASSERT(PhysListC().IsEmpty());
+    ASSERT(logData.GetLogInfoCount() == this->GetLogInfoCount());
 
-    for (suma = 0, nDex = 0, nCount = logData.LogListC().GetCount(); nDex <nCount; nDex++)
+    for (nDex = 0, nCount = logData.GetLogInfoCount(); nDex < nCount; nDex++)
     {
-        VERIFY(lplogInf = logData.LogListC().GetAt(nDex));
-        if (lpDesc = this->MapKeeper().FindMapItem(lplogInf->What()))
+        if (lpDesc = this->MapKeeper().FindMapItem(logData.GetLogInfoWhat(nDex), ilen))
         {
-            ilen = _tcslen(lpTxt = lpDesc->lpTxt);
-            if (physInf = AddNewPhysInfo(lplogInf->What()))
-            {
-                start = suma + (iLogPos = lplogInf->GetPos());
-                end = start + ilen;
-                suma += ilen;
-                physInf->SetStart(start);
-                physInf->SetEnd(end);
-            }
+            this->m_fieldIndex.SetLength((size_t)nDex, ilen);
+        }
+        else
+        {   // unknown field keeps zero length, like the marker of a section not having a text
+            ASSERT(eLogInfoField != logData.GetLogInfoKind(nDex));
         }
     }
 }
@@ -636,45 +640,39 @@ template<class TFIELDID>
 void CSubstPhysData<TFIELDID>::ExportLogListSel(
     LPCCSelInfo selInf, CSubstLogData<TFIELDID> & logData) const
 {
-    CLogInfo<TFIELDID>*  logInfOld;
-    CLogInfo<TFIELDID>* logInfNew;
-    CPhysInfo<TFIELDID>*   physInf;
     SubstDescr<TFIELDID> const* lpDesc;
-    // Make followings just CTypedPtrArrayEx. 
-    // Since they share contents with PhysListC, the destructor must not delete pointent objects
-    CTypedPtrArrayEx<CObArray, CPhysInfo<TFIELDID>*> listSel;
-    CTypedPtrArrayEx<CObArray, CPhysInfo<TFIELDID>*> const*listExported;
+    INT_PTR       nFirst, nCount;
     tPhysPos      suma;
+    size_t        nTxtLen;
 
-    ASSERT(logData.LogListC().IsEmpty());
+    ASSERT(0 == logData.GetLogInfoCount());
     /* no, subst. map is not assigned here, but the caller may do it
-    logData.AssignSubstMap(this->GetSubstMap());
+    logData.AssignSubstMap(this->MapKeeper());
     */
 
     if (NULL == selInf)
     {   
-        listExported = static_cast<CPkTypedPtrArray<CObArray, CPhysInfo<TFIELDID>*> const*>(&PhysListC());
+        nFirst = 0;
+        nCount = GetPhysInfoCount();
         suma = 0;
     }
     else
     {
-        FindPhysInfoAllBetween(selInf->StartChar(), selInf->EndChar(), listSel);
-        listExported = &listSel;
+        nCount = FindPhysInfoAllBetween(selInf->StartChar(), selInf->EndChar(), nFirst);
         suma = selInf->StartChar();
     }
-    ASSERT_VALID(listExported);
 
-    for (INT_PTR nDex = 0, nSize = listExported->GetCount(); nDex < nSize; nDex++)
+    for (INT_PTR nDex = nFirst; nDex < nFirst + nCount; nDex++)
     {
-        VERIFY(physInf = listExported->GetAt(nDex));
-        VERIFY(logInfOld = FindMatch(physInf));
-        if (lpDesc = this->FindMapItem(logInfOld->What()))
-        {
-            if (logInfNew = logData.AppenNewLogInfo(physInf->What()))
+        TFIELDID what = this->GetLogInfoWhat(nDex);
+        ESubstLogInfoKind kind = this->GetLogInfoKind(nDex);
+
+        nTxtLen = 0;
+        if ((lpDesc = this->FindMapItem(what, nTxtLen)) || (eLogInfoField != kind))
+        {   // the marker of a section may have no text
+            if (0 <= logData.AppenNewLogInfo(what, GetPhysInfoStart(nDex) - suma, kind))
             {
-                ASSERT(lpDesc->lpTxt);
-                logInfNew->SetPos(physInf->GetStart() - suma);
-                suma += _tcslen(lpDesc->lpTxt);
+                suma += nTxtLen;
             }
         }
     }
@@ -688,11 +686,11 @@ void CSubstPhysData<TFIELDID>::ExportLogAll(CSubstLogData<TFIELDID> & logData) c
 {
     CString  strLog;
 
-    logData.Clear();
+    logData.DeleteContents();
     ExportLogListAll(logData);
     strLog = PhysStr2logStr(*this, NULL);
     logData.SetLogStr(strLog);
-    logData.AssignSubstMap(this->GetSubstMap());
+    logData.AssignSubstMap(this->MapKeeper());
 }
 
 template<class TFIELDID> 
@@ -714,7 +712,7 @@ void CSubstPhysData<TFIELDID>::ExportLogSel(LPCCSelInfo selInf, CSubstLogData<TF
             strLog = strLog.Mid((int)nLogSelBeg, (int)(nLogSelEnd - nLogSelBeg));
         }
         logData.SetLogStr(strLog);
-        logData.AssignSubstMap(this->GetSubstMap());
+        logData.AssignSubstMap(this->MapKeeper());
     }
 }
 
@@ -724,43 +722,81 @@ void CSubstPhysData<TFIELDID>::AssignPhysData(CSubstPhysData<TFIELDID> const& wh
     m_physStr  = what.m_physStr;
 }
 
+// Sets the lengths of fields to those of what; the logical fields must match already
+template<class TFIELDID> 
+void  CSubstPhysData<TFIELDID>::AssignPhysList(CSubstPhysData<TFIELDID> const &what)
+{
+    size_t nCount = this->m_fieldIndex.GetCount();
+
+    ASSERT(what.m_fieldIndex.GetCount() == nCount);
+    for (size_t ii = 0; ii < nCount; ii++)
+    {
+        this->m_fieldIndex.SetLength(ii, what.m_fieldIndex.GetLength(ii));
+    }
+}
+
+// Fills the ( empty ) list by new CPhysInfo objects, built of the fields composed physically; used for storing them
+template<class TFIELDID> 
+void  CSubstPhysData<TFIELDID>::CopyPhysList(CSubstPhysList<TFIELDID> &list) const
+{
+    ASSERT(list.IsEmpty());
+    list.SetSize(0, GetPhysInfoCount());
+    for (INT_PTR nDex = 0, nSize = GetPhysInfoCount(); nDex < nSize; nDex++)
+    {
+        list.Add(new CPhysInfo<TFIELDID>(this->GetLogInfoWhat(nDex), GetPhysInfoStart(nDex), GetPhysInfoEnd(nDex)));
+    }
+}
+
+// Sets the field lengths to those of list items; used for loading them. 
+// The logical fields must be already loaded.
 template<class TFIELDID> 
-void  CSubstPhysData<TFIELDID>::AssignPhysList(CSubstPhysList<TFIELDID> const &list)
+void  CSubstPhysData<TFIELDID>::AttachPhysList(CSubstPhysList<TFIELDID> const &list)
 {
-    INT_PTR          nDex, nSize;
-    CPhysInfo<TFIELDID>*      lpTmp, lpNew;
-    CRuntimeClass*   lpRt;
-    CObject*         pObj;
+    CPhysInfo<TFIELDID>*      lpTmp;
 
-    PhysList().DeleteAndRemoveAll();
-    for(nDex = 0, nSize = list.GetCount(); nDex < nSize; nDex++)
+    this->m_fieldIndex.ResetLengths();
+    ASSERT(list.GetCount() == this->GetLogInfoCount());
+    for (INT_PTR nDex = 0, nSize = list.GetCount(); nDex < nSize; nDex++)
     {
         VERIFY(lpTmp = list.GetAt(nDex));
-        VERIFY(lpRt = lpTmp->GetRuntimeClass());
-        if (pObj = lpRt->CreateObject())
-        {
-            VERIFY(lpNew = dynamic_cast<CPhysInfo *>(pObj));
-            lpNew->Assign(lpTmp);
-            PhysList().Add(lpNew);
-        }
+        ASSERT(lpTmp->GetStart() == this->m_fieldIndex.GetStart((size_t)nDex));
+        this->m_fieldIndex.SetLength((size_t)nDex, lpTmp->GetLength());
     }
 }
 
+// Assigns the logical data, and composes the physical data of them.
+// Nothing is done if the logical contents match already, since the physical data are composed of them.
 template<class TFIELDID> 
-CSubstPhysData<TFIELDID>& CSubstPhysData<TFIELDID>::operator = (CSubstLogData<TFIELDID> const & rhs)
+void CSubstPhysData<TFIELDID>::Assign(CSubstLogData<TFIELDID> const &rhs)
 {
-    CSubstLogData<TFIELDID>::operator = (rhs);
+    if (this->IsEqual(rhs))
+        return;
+
+    CSubstLogData<TFIELDID>::Assign(rhs);
     AssignPhysFromLog(*this);
+}
 
+// Recognizes the logical data in the plain text, and composes the physical data of them.
+template<class TFIELDID> 
+void CSubstPhysData<TFIELDID>::AssignPlainText(LPCTSTR szText, BOOL bIgnoreCase)
+{
+    CSubstLogData<TFIELDID>::AssignPlainText(szText, bIgnoreCase);
+    AssignPhysFromLog(*this);
+}
+
+template<class TFIELDID> 
+CSubstPhysData<TFIELDID>& CSubstPhysData<TFIELDID>::operator = (CSubstLogData<TFIELDID> const & rhs)
+{
+    Assign(rhs);
     return *this;
 }
 
 template<class TFIELDID>
 CSubstPhysData<TFIELDID>& CSubstPhysData<TFIELDID>::operator = (CSubstPhysData<TFIELDID> const& rhs)
 {
-    CSubstLogData::operator = (rhs);
+    CSubstLogData<TFIELDID>::Assign(rhs);
     AssignPhysData(rhs);
-    AssignPhysList(rhs.PhysListC());
+    AssignPhysList(rhs);
 
     return *this;
 }
@@ -770,30 +806,28 @@ CString CSubstPhysData<TFIELDID>::PhysStr2logStr(
     CSubstPhysData<TFIELDID> const& physData,
     SubstMapKeeper<TFIELDID> const* lpMapKeeper)
 {
-    CPhysInfo<TFIELDID>*   physInf;
     size_t        itmplen, istart, idone;
     INT_PTR       nDex, nSize;
     SubstDescr<TFIELDID> const* lpDesc;
     CString       strTmp, strLog;
-    CString       strPhys = physData.GetPhysStr();
-    int           physlen = strPhys.GetLength();
+    CSubstText const& strPhys = physData.m_physStr;
 
-    ASSERT(physData.PhysListC().GetCount() == physData.LogListC().GetCount());
+    ASSERT(physData.GetPhysInfoCount() == physData.GetLogInfoCount());
     if (NULL == lpMapKeeper)
     {
         lpMapKeeper = &physData.MapKeeper();
     }
-    for (idone = 0, nDex = 0, nSize = physData.PhysListC().GetCount(); nDex < nSize; nDex++)
+    for (idone = 0, nDex = 0, nSize = physData.GetPhysInfoCount(); nDex < nSize; nDex++)
     {
-        physInf = physData.PhysListC().GetAt(nDex);
-        if (lpDesc = lpMapKeeper->FindMapItem(physInf->What()))
-        {
-            if (idone < (istart = physInf->GetStart()))
+        if ((lpDesc = lpMapKeeper->FindMapItem(physData.GetLogInfoWhat(nDex))) || 
+            (eLogInfoField != physData.GetLogInfoKind(nDex)))
+        {   // the marker of a section may have no text
+            if (idone < (istart = physData.GetPhysInfoStart(nDex)))
             {
-                strTmp = strPhys.Mid((int)idone, (int)(istart - idone));
+                strTmp = strPhys.Mid(idone, istart - idone);
                 strLog += strTmp;
             }
-            idone = physInf->GetEnd();
+            idone = physData.GetPhysInfoEnd(nDex);
         }
         else
         {
@@ -802,7 +836,7 @@ CString CSubstPhysData<TFIELDID>::PhysStr2logStr(
     }
     if ((itmplen = strPhys.GetLength() - idone) > 0)
     {
-        strTmp = strPhys.Mid((int)idone, (int)itmplen);
+        strTmp = strPhys.Mid(idone, itmplen);
         strLog += strTmp;
     }
 
@@ -812,16 +846,20 @@ CString CSubstPhysData<TFIELDID>::PhysStr2logStr(
 template<class TFIELDID> 
 void CSubstPhysData<TFIELDID>::Serialize(CArchive& ar)
 {
+    // The physical fields are archived as the list of CPhysInfo, built just for that
+    CSubstPhysList<TFIELDID> list;
+
     CSubstLogData<TFIELDID>::Serialize(ar);
 
-    if (ar.IsLoading())
+    m_physStr.Serialize(ar);
+
+    if (!ar.IsLoading())
     {
-        ar >> m_physStr;
+        CopyPhysList(list);
     }
-    else
-    {
-        ar << m_physStr;
+    list.Serialize(ar);
+    if (ar.IsLoading())
+    {   // the logical data have been just re-loaded
+        AttachPhysList(list);
     }
-
-    m_physlist.Serialize(ar);
 }
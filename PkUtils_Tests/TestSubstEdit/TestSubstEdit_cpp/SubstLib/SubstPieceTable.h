@@ -0,0 +1,446 @@
+/////////////////////////////////////////////////////////////////////////////
+// SubstPieceTable.h
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef __SUBSTPIECETABLE_H__
+#define __SUBSTPIECETABLE_H__
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDE FILES
+/////////////////////////////////////////////////////////////////////////////
+// Note: This header intentionally does not depend on MFC,
+// so it can be used ( and benchmarked ) outside of the MFC build as well.
+#include <stddef.h>
+#include <assert.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/////////////////////////////////////////////////////////////////////////////
+// MANIFESTED CONSTANTS & MACROS
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef ASSERT
+#define ASSERT(f)  assert(f)
+#define __SUBSTPIECETABLE_OWN_ASSERT__
+#endif
+
+/////////////////////////////////////////////////////////////////////////////
+// CLASES
+/////////////////////////////////////////////////////////////////////////////
+
+/** CSubstPieceTable is a text buffer for long texts that are edited often.
+    All the text inserted is appended to one buffer; the current text is a sequence of pieces of that buffer.
+    Once the deleted text left in the buffer is longer than the current text, the buffer is compacted,
+    so it stays at most twice as long as the text ( see CompactIfSparse ). Pieces are kept in a treap
+    ( a randomized balanced tree ) ordered by their text position, with the subtree lengths.
+    Hence inserting or deleting text takes O(log n) expected time for n pieces,
+    regardless the text length, and the text is never copied as a whole.
+    The contiguous text is created only when GetString is called, and released by the next change.
+    Like for std::string, the const methods may be called by several threads at once,
+    while no thread modifies the table; the contiguous text is created under a lock.
+*/
+template<class TCHARTYPE> class CSubstPieceTable
+{
+public:
+    typedef std::basic_string<TCHARTYPE> tString;
+    // Index of the tree node, or -1 for none
+    typedef ptrdiff_t tIndex;
+
+protected:
+    struct tNode
+    {
+        size_t   m_nStart;    // start of the piece in m_buffer
+        size_t   m_nLength;   // length of the piece
+        size_t   m_nTotal;    // total length of pieces in the subtree
+        unsigned m_nPriority;
+        tIndex   m_nLeft;
+        tIndex   m_nRight;
+    };
+
+    // the text assigned or inserted, including the deleted one not compacted yet
+    tString m_buffer;
+    // the tree nodes, and indexes of those no longer used
+    std::vector<tNode>  m_nodes;
+    std::vector<tIndex> m_free;
+    tIndex   m_nRoot;
+    unsigned m_nSeed;
+    // the contiguous copy of the text, if valid
+    mutable tString m_flat;
+    mutable std::atomic<bool> m_bFlatValid;
+    // guards the creation of m_flat by the const GetString
+    mutable std::mutex m_flatLock;
+    // the deleted text shorter than this is never compacted
+    static const size_t m_nMinCompacted = 4096;
+
+public:
+    CSubstPieceTable() : m_nRoot(-1), m_nSeed(2463534242u), m_bFlatValid(true)
+    { }
+    CSubstPieceTable(CSubstPieceTable const &rhs) : m_bFlatValid(true)
+    { *this = rhs; }
+
+    /// Copies the text; the contiguous copy of it is not copied, but created again when needed
+    CSubstPieceTable& operator = (CSubstPieceTable const &rhs)
+    {
+        if (this != &rhs)
+        {
+            m_buffer = rhs.m_buffer;
+            m_nodes = rhs.m_nodes;
+            m_free = rhs.m_free;
+            m_nRoot = rhs.m_nRoot;
+            m_nSeed = rhs.m_nSeed;
+            m_flat.clear();
+            m_bFlatValid = (m_nRoot < 0);
+        }
+        return *this;
+    }
+
+    size_t GetLength() const
+    { return Total(m_nRoot); }
+    bool IsEmpty() const
+    { return (0 == GetLength()); }
+
+    /// Returns the count of pieces the text currently consists of
+    size_t GetPieceCount() const
+    { return m_nodes.size() - m_free.size(); }
+
+    /// Returns the length of the buffer, including the deleted text not compacted yet
+    size_t GetBufferSize() const
+    { return m_buffer.size(); }
+
+    void Empty()
+    {
+        m_buffer.clear();
+        m_nodes.clear();
+        m_free.clear();
+        m_nRoot = -1;
+        tString().swap(m_flat);
+        m_bFlatValid = true;
+    }
+
+    void Assign(TCHARTYPE const* lpText, size_t nLength)
+    {
+        Empty();
+        if (0 < nLength)
+        {
+            m_buffer.assign(lpText, nLength);
+            m_nRoot = NewNode(0, nLength);
+            ReleaseFlat();
+        }
+    }
+
+    /// Inserts nLength characters of lpText before the position nPos
+    void Insert(size_t nPos, TCHARTYPE const* lpText, size_t nLength)
+    {
+        tIndex nLeft, nRight;
+        size_t nStart = m_buffer.size();
+
+        ASSERT(nPos <= GetLength());
+        if (0 < nLength)
+        {
+            m_buffer.append(lpText, nLength);
+            Split(m_nRoot, nPos, nLeft, nRight);
+            // typing just extends the piece inserted before, instead of creating a new one
+            if (!ExtendLast(nLeft, nStart, nLength))
+            {
+                nLeft = Merge(nLeft, NewNode(nStart, nLength));
+            }
+            m_nRoot = Merge(nLeft, nRight);
+            ReleaseFlat();
+        }
+    }
+
+    /// Deletes nCount characters starting on the position nPos
+    void Delete(size_t nPos, size_t nCount)
+    {
+        tIndex nLeft, nMiddle, nRight;
+
+        ASSERT(nPos + nCount <= GetLength());
+        if (0 < nCount)
+        {
+            Split(m_nRoot, nPos, nLeft, nRight);
+            Split(nRight, nCount, nMiddle, nRight);
+            FreeTree(nMiddle);
+            m_nRoot = Merge(nLeft, nRight);
+            ReleaseFlat();
+            CompactIfSparse();
+        }
+    }
+
+    TCHARTYPE GetAt(size_t nPos) const
+    {
+        tIndex nDex = m_nRoot;
+
+        ASSERT(nPos < GetLength());
+        for (;;)
+        {
+            tNode const &node = m_nodes[nDex];
+            size_t nLeftTotal = Total(node.m_nLeft);
+
+            if (nPos < nLeftTotal)
+            {
+                nDex = node.m_nLeft;
+            }
+            else if (nPos < nLeftTotal + node.m_nLength)
+            {
+                return m_buffer[node.m_nStart + nPos - nLeftTotal];
+            }
+            else
+            {
+                nPos -= nLeftTotal + node.m_nLength;
+                nDex = node.m_nRight;
+            }
+        }
+    }
+
+    /// Appends nCount characters starting on the position nPos to the output
+    void CopyTo(size_t nPos, size_t nCount, tString &output) const
+    {
+        ASSERT(nPos + nCount <= GetLength());
+        output.reserve(output.size() + nCount);
+        CopyRange(m_nRoot, nPos, nPos + nCount, output);
+    }
+
+    /// Copies nCount characters starting on the position nPos to lpOutput ( not null-terminated )
+    void CopyTo(size_t nPos, size_t nCount, TCHARTYPE* lpOutput) const
+    {
+        ASSERT(nPos + nCount <= GetLength());
+        if (m_bFlatValid.load(std::memory_order_acquire))
+        {
+            std::copy(m_flat.begin() + nPos, m_flat.begin() + nPos + nCount, lpOutput);
+        }
+        else
+        {
+            CopyRange(m_nRoot, nPos, nPos + nCount, lpOutput);
+        }
+    }
+
+    /** Returns the contiguous null-terminated text.
+        The pointer is valid until the next modification.
+    */
+    TCHARTYPE const* GetString() const
+    {
+        if (!m_bFlatValid.load(std::memory_order_acquire))
+        {
+            std::lock_guard<std::mutex> lock(m_flatLock);
+
+            if (!m_bFlatValid.load(std::memory_order_relaxed))
+            {
+                m_flat.clear();
+                CopyTo(0, GetLength(), m_flat);
+                m_bFlatValid.store(true, std::memory_order_release);
+            }
+        }
+        return m_flat.c_str();
+    }
+
+protected:
+    size_t Total(tIndex nDex) const
+    { return (nDex < 0) ? 0 : m_nodes[nDex].m_nTotal; }
+
+    // Releases the contiguous copy of the text, after the text has changed
+    void ReleaseFlat()
+    {
+        tString().swap(m_flat);
+        m_bFlatValid = false;
+    }
+
+    /// Copies the current text to a new buffer as one piece, if the deleted text takes the most of the buffer.
+    /// The deleted text must exceed the minimum as well, so that short texts are not compacted on every delete.
+    void CompactIfSparse()
+    {
+        size_t nLength = GetLength();
+        size_t nDead = m_buffer.size() - nLength;
+
+        if ((nDead > nLength) && (nDead >= m_nMinCompacted))
+        {
+            tString buffer;
+
+            buffer.reserve(nLength);
+            CopyRange(m_nRoot, 0, nLength, buffer);
+            m_buffer.swap(buffer);
+            m_nodes.clear();
+            m_free.clear();
+            m_nRoot = (0 < nLength) ? NewNode(0, nLength) : -1;
+        }
+    }
+
+    void Update(tIndex nDex)
+    {
+        tNode &node = m_nodes[nDex];
+        node.m_nTotal = Total(node.m_nLeft) + node.m_nLength + Total(node.m_nRight);
+    }
+
+    tIndex NewNode(size_t nStart, size_t nLength)
+    {
+        tNode node = { nStart, nLength, nLength, NextPriority(), -1, -1 };
+        tIndex nDex;
+
+        if (m_free.empty())
+        {
+            nDex = (tIndex)m_nodes.size();
+            m_nodes.push_back(node);
+        }
+        else
+        {
+            nDex = m_free.back();
+            m_free.pop_back();
+            m_nodes[nDex] = node;
+        }
+        return nDex;
+    }
+
+    void FreeTree(tIndex nDex)
+    {
+        if (0 <= nDex)
+        {
+            FreeTree(m_nodes[nDex].m_nLeft);
+            FreeTree(m_nodes[nDex].m_nRight);
+            m_free.push_back(nDex);
+        }
+    }
+
+    unsigned NextPriority()
+    {   // xorshift32
+        m_nSeed ^= m_nSeed << 13;
+        m_nSeed ^= m_nSeed >> 17;
+        m_nSeed ^= m_nSeed << 5;
+        return m_nSeed;
+    }
+
+    /// Splits the tree nDex to nLeft with the first nPos characters, and nRight with the rest.
+    /// The piece containing nPos is cut into two.
+    void Split(tIndex nDex, size_t nPos, tIndex &nLeft, tIndex &nRight)
+    {
+        tIndex nTmp;
+
+        if (nDex < 0)
+        {
+            nLeft = nRight = -1;
+            return;
+        }
+
+        size_t nLeftTotal = Total(m_nodes[nDex].m_nLeft);
+        size_t nLength = m_nodes[nDex].m_nLength;
+
+        if (nPos <= nLeftTotal)
+        {
+            Split(m_nodes[nDex].m_nLeft, nPos, nLeft, nTmp);
+            m_nodes[nDex].m_nLeft = nTmp;
+            nRight = nDex;
+        }
+        else if (nPos >= nLeftTotal + nLength)
+        {
+            Split(m_nodes[nDex].m_nRight, nPos - nLeftTotal - nLength, nTmp, nRight);
+            m_nodes[nDex].m_nRight = nTmp;
+            nLeft = nDex;
+        }
+        else
+        {   // cut the piece; its tail goes to the right part
+            size_t nCut = nPos - nLeftTotal;
+            tIndex nTail = NewNode(m_nodes[nDex].m_nStart + nCut, nLength - nCut);
+
+            nTmp = m_nodes[nDex].m_nRight;
+            m_nodes[nDex].m_nLength = nCut;
+            m_nodes[nDex].m_nRight = -1;
+            nLeft = nDex;
+            nRight = Merge(nTail, nTmp);
+        }
+        Update(nDex);
+    }
+
+    tIndex Merge(tIndex nLeft, tIndex nRight)
+    {
+        if (nLeft < 0)
+        {
+            return nRight;
+        }
+        if (nRight < 0)
+        {
+            return nLeft;
+        }
+        if (m_nodes[nLeft].m_nPriority > m_nodes[nRight].m_nPriority)
+        {
+            tIndex nTmp = Merge(m_nodes[nLeft].m_nRight, nRight);
+            m_nodes[nLeft].m_nRight = nTmp;
+            Update(nLeft);
+            return nLeft;
+        }
+        else
+        {
+            tIndex nTmp = Merge(nLeft, m_nodes[nRight].m_nLeft);
+            m_nodes[nRight].m_nLeft = nTmp;
+            Update(nRight);
+            return nRight;
+        }
+    }
+
+    /// If the last piece of the tree nDex ends on nBufferPos, extends it by nLength
+    bool ExtendLast(tIndex nDex, size_t nBufferPos, size_t nLength)
+    {
+        tIndex nLast = nDex;
+
+        if (nLast < 0)
+        {
+            return false;
+        }
+        while (0 <= m_nodes[nLast].m_nRight)
+        {
+            nLast = m_nodes[nLast].m_nRight;
+        }
+        if (m_nodes[nLast].m_nStart + m_nodes[nLast].m_nLength != nBufferPos)
+        {
+            return false;
+        }
+        m_nodes[nLast].m_nLength += nLength;
+        for (; 0 <= nDex; nDex = m_nodes[nDex].m_nRight)
+        {
+            m_nodes[nDex].m_nTotal += nLength;
+        }
+        return true;
+    }
+
+    static void AppendPiece(tString &output, TCHARTYPE const* lpPiece, size_t nLength)
+    { output.append(lpPiece, nLength); }
+    static void AppendPiece(TCHARTYPE* &lpOutput, TCHARTYPE const* lpPiece, size_t nLength)
+    { lpOutput = std::copy(lpPiece, lpPiece + nLength, lpOutput); }
+
+    // Appends the range of the tree nDex to the output, which is either tString, or the pointer 
+    // to the buffer ( advanced past the copied text )
+    template<class TOUTPUT>
+    void CopyRange(tIndex nDex, size_t nFrom, size_t nTo, TOUTPUT &output) const
+    {
+        if ((nDex < 0) || (nFrom >= nTo))
+        {
+            return;
+        }
+
+        tNode const &node = m_nodes[nDex];
+        size_t nLeftTotal = Total(node.m_nLeft);
+        size_t nPieceEnd = nLeftTotal + node.m_nLength;
+
+        if (nFrom < nLeftTotal)
+        {
+            CopyRange(node.m_nLeft, nFrom, (nTo < nLeftTotal) ? nTo : nLeftTotal, output);
+        }
+        if ((nFrom < nPieceEnd) && (nLeftTotal < nTo))
+        {
+            size_t nBeg = (nFrom > nLeftTotal) ? nFrom : nLeftTotal;
+            size_t nEnd = (nTo < nPieceEnd) ? nTo : nPieceEnd;
+            AppendPiece(output, m_buffer.data() + node.m_nStart + nBeg - nLeftTotal, nEnd - nBeg);
+        }
+        if (nPieceEnd < nTo)
+        {
+            CopyRange(node.m_nRight, (nFrom > nPieceEnd) ? (nFrom - nPieceEnd) : 0, nTo - nPieceEnd, output);
+        }
+    }
+};
+
+#ifdef __SUBSTPIECETABLE_OWN_ASSERT__
+#undef ASSERT
+#undef __SUBSTPIECETABLE_OWN_ASSERT__
+#endif
+
+#endif // __SUBSTPIECETABLE_H__
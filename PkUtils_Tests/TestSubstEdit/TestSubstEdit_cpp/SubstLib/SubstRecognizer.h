@@ -0,0 +1,139 @@
+/////////////////////////////////////////////////////////////////////////////
+// SubstRecognizer.h
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef __SUBSTRECOGNIZER_H__
+#define __SUBSTRECOGNIZER_H__
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDE FILES
+/////////////////////////////////////////////////////////////////////////////
+// Note: This header intentionally does not depend on MFC,
+// so it can be used ( and benchmarked ) outside of the MFC build as well.
+#include <stddef.h>
+#include <assert.h>
+#include <ctype.h>
+#include <wctype.h>
+#include <vector>
+#include "SubstCharScanner.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// MANIFESTED CONSTANTS & MACROS
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef ASSERT
+#define ASSERT(f)  assert(f)
+#define __SUBSTRECOGNIZER_OWN_ASSERT__
+#endif
+
+/////////////////////////////////////////////////////////////////////////////
+// CLASES
+/////////////////////////////////////////////////////////////////////////////
+
+/** CSubstRecognizer is the Aho-Corasick automaton, finding the texts of fields
+    ( patterns ) in a plain text in one pass, regardless the count of patterns.
+    Patterns are identified by the order in which they have been added;
+    matching follows the rules of the original recognition in CSubstLogData::AssignPlainText:
+    the leftmost match wins, and of the patterns matching at the same position,
+    the one added first wins.
+    <br>
+    The automaton is a complete transition table over the classes of characters used by patterns,
+    so each text character costs one table lookup. After a match is found, the search continues
+    right after the matched text; the characters scanned ahead to confirm the match
+    ( at most the length of the longest pattern ) are scanned again.
+    <br>
+    Optionally, characters are compared case-insensitive ( by towlower / tolower ).
+    <br>
+    While no pattern is started, the text is skipped by CSubstCharScanner right to the next
+    character which starts some pattern ( the prefilter ). It is used if there are few such characters,
+    and, for case-insensitive matching, if they have no case ( like '<' ).
+*/
+template<class TCHARTYPE> class CSubstRecognizer
+{
+public:
+    enum { tNoPattern = (size_t)-1 };
+
+protected:
+    enum { tLowChars = 256 };
+
+    struct tNode
+    {
+        // the length of the text leading to the node
+        size_t nDepth;
+        // the node of the longest proper suffix of the node text
+        size_t nFail;
+        // the nearest node on the fail chain ending a pattern, or tNoPattern
+        size_t nOutLink;
+        // the pattern ending in this node, or tNoPattern
+        size_t nPattern;
+    };
+
+    bool  m_bIgnoreCase;
+    bool  m_bBuilt;
+    // the lengths of added patterns
+    std::vector<size_t>     m_lengths;
+    // the folded texts of added patterns, one after another
+    std::vector<TCHARTYPE>  m_texts;
+    std::vector<tNode>      m_nodes;
+    // transitions; m_delta[node * m_nClasses + class]
+    std::vector<size_t>     m_delta;
+    size_t  m_nClasses;
+    // the class of characters below tLowChars; 0 for characters not used by patterns
+    size_t  m_lowClass[tLowChars];
+    // the sorted characters above tLowChars used by patterns, and their classes
+    std::vector<TCHARTYPE>  m_highChars;
+    std::vector<size_t>     m_highClass;
+    // the first characters of patterns, if the prefilter is used
+    CSubstCharScanner<TCHARTYPE> m_scanner;
+    bool  m_bPrefilterAllowed;
+    bool  m_bPrefilter;
+
+public:
+    explicit CSubstRecognizer(bool bIgnoreCase = false);
+
+    bool IgnoresCase() const
+    { return m_bIgnoreCase; }
+    bool IsBuilt() const
+    { return m_bBuilt; }
+    size_t GetPatternCount() const
+    { return m_lengths.size(); }
+    size_t GetPatternLength(size_t nPattern) const
+    { return m_lengths[nPattern]; }
+    /// Returns true if the built automaton skips the text by the prefilter
+    bool UsesPrefilter() const
+    { return m_bPrefilter; }
+    /// Allows or disallows the prefilter ( allowed by default ); takes effect with the next Build
+    void AllowPrefilter(bool bAllow)
+    { m_bPrefilterAllowed = bAllow; }
+
+    /// Adds the pattern, returning its number. Empty patterns are never matched.
+    size_t AddPattern(TCHARTYPE const* lpText, size_t nLength);
+    /// Builds the automaton from the patterns added so far; takes O(total length of patterns * classes)
+    void Build();
+
+    /// Finds the leftmost pattern in lpText[nFrom, nLength). Returns false if there is none.
+    bool FindNext(TCHARTYPE const* lpText, size_t nLength, size_t nFrom,
+        size_t &nStart, size_t &nPattern) const;
+
+    static TCHARTYPE FoldChar(TCHARTYPE ch);
+
+protected:
+    TCHARTYPE Normalize(TCHARTYPE ch) const
+    { return m_bIgnoreCase ? FoldChar(ch) : ch; }
+    static size_t CharCode(TCHARTYPE ch)
+    { return (1 == sizeof(TCHARTYPE)) ? (size_t)(unsigned char)ch : (size_t)ch; }
+
+    size_t ClassOf(TCHARTYPE ch) const;
+    size_t AddClass(TCHARTYPE ch);
+    size_t AddNode(size_t nDepth);
+    void   BuildPrefilter();
+};
+
+#include "SubstRecognizer.hpp"
+
+#ifdef __SUBSTRECOGNIZER_OWN_ASSERT__
+#undef ASSERT
+#undef __SUBSTRECOGNIZER_OWN_ASSERT__
+#endif
+
+#endif // __SUBSTRECOGNIZER_H__
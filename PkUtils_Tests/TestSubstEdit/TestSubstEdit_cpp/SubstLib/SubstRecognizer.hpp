@@ -0,0 +1,261 @@
+// SubstRecognizer.hpp - template CSubstRecognizer<TCHARTYPE> implementation file
+//
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDE FILES
+/////////////////////////////////////////////////////////////////////////////
+#include <algorithm>
+
+/////////////////////////////////////////////////////////////////////////////
+// CLASS DEFINITIONS
+/////////////////////////////////////////////////////////////////////////////
+
+template<class TCHARTYPE>
+CSubstRecognizer<TCHARTYPE>::CSubstRecognizer(bool bIgnoreCase)
+    : m_bIgnoreCase(bIgnoreCase), m_bBuilt(false), m_nClasses(1), 
+    m_bPrefilterAllowed(true), m_bPrefilter(false)
+{
+    std::fill(m_lowClass, m_lowClass + tLowChars, (size_t)0);
+}
+
+template<class TCHARTYPE>
+/*static */ TCHARTYPE CSubstRecognizer<TCHARTYPE>::FoldChar(TCHARTYPE ch)
+{
+    if (1 == sizeof(TCHARTYPE))
+        return (TCHARTYPE)tolower((unsigned char)ch);
+    else
+        return (TCHARTYPE)towlower((wint_t)ch);
+}
+
+template<class TCHARTYPE>
+size_t CSubstRecognizer<TCHARTYPE>::AddPattern(TCHARTYPE const* lpText, size_t nLength)
+{
+    size_t nPattern = m_lengths.size();
+
+    ASSERT((NULL != lpText) || (0 == nLength));
+    m_bBuilt = false;
+    m_lengths.push_back(nLength);
+    for (size_t ii = 0; ii < nLength; ii++)
+    {
+        m_texts.push_back(Normalize(lpText[ii]));
+    }
+    return nPattern;
+}
+
+// Returns the class of the character; 0 if the character is not used by any pattern
+template<class TCHARTYPE>
+size_t CSubstRecognizer<TCHARTYPE>::ClassOf(TCHARTYPE ch) const
+{
+    size_t nCode = CharCode(ch);
+
+    if (nCode < tLowChars)
+    {
+        return m_lowClass[nCode];
+    }
+    else
+    {
+        typename std::vector<TCHARTYPE>::const_iterator it =
+            std::lower_bound(m_highChars.begin(), m_highChars.end(), ch);
+
+        if ((it != m_highChars.end()) && (*it == ch))
+        {
+            return m_highClass[it - m_highChars.begin()];
+        }
+        return 0;
+    }
+}
+
+// Assigns a new class to the character, if it has none yet
+template<class TCHARTYPE>
+size_t CSubstRecognizer<TCHARTYPE>::AddClass(TCHARTYPE ch)
+{
+    size_t nCode = CharCode(ch);
+    size_t nClass = ClassOf(ch);
+
+    if (0 == nClass)
+    {
+        nClass = m_nClasses++;
+        if (nCode < tLowChars)
+        {
+            m_lowClass[nCode] = nClass;
+        }
+        else
+        {
+            typename std::vector<TCHARTYPE>::iterator it =
+                std::lower_bound(m_highChars.begin(), m_highChars.end(), ch);
+            size_t nDex = it - m_highChars.begin();
+
+            m_highChars.insert(it, ch);
+            m_highClass.insert(m_highClass.begin() + nDex, nClass);
+        }
+    }
+    return nClass;
+}
+
+template<class TCHARTYPE>
+size_t CSubstRecognizer<TCHARTYPE>::AddNode(size_t nDepth)
+{
+    tNode node;
+
+    node.nDepth = nDepth;
+    node.nFail = 0;
+    node.nOutLink = tNoPattern;
+    node.nPattern = tNoPattern;
+    m_nodes.push_back(node);
+    m_delta.resize(m_nodes.size() * m_nClasses, 0);
+
+    return m_nodes.size() - 1;
+}
+
+template<class TCHARTYPE>
+void CSubstRecognizer<TCHARTYPE>::Build()
+{
+    std::vector<size_t> queue;
+    size_t ii, nPattern, nOffset, nClass;
+
+    // 1. classes of characters
+    m_nClasses = 1;
+    std::fill(m_lowClass, m_lowClass + tLowChars, (size_t)0);
+    m_highChars.clear();
+    m_highClass.clear();
+    for (ii = 0; ii < m_texts.size(); ii++)
+    {
+        AddClass(m_texts[ii]);
+    }
+
+    // 2. the trie of patterns; the transition to the root 0 stands for a missing edge for now
+    m_nodes.clear();
+    m_delta.clear();
+    AddNode(0);
+    for (nPattern = 0, nOffset = 0; nPattern < m_lengths.size(); nOffset += m_lengths[nPattern++])
+    {
+        size_t nNode = 0;
+
+        if (0 == m_lengths[nPattern])
+        {
+            continue;
+        }
+        for (ii = 0; ii < m_lengths[nPattern]; ii++)
+        {
+            size_t nEdge = nNode * m_nClasses + ClassOf(m_texts[nOffset + ii]);
+            if (0 == m_delta[nEdge])
+            {
+                size_t nChild = AddNode(ii + 1);
+                m_delta[nEdge] = nChild;
+            }
+            nNode = m_delta[nEdge];
+        }
+        // the pattern added first wins
+        if (tNoPattern == m_nodes[nNode].nPattern)
+        {
+            m_nodes[nNode].nPattern = nPattern;
+        }
+    }
+
+    // 3. fail links and the complete transition table, in the breadth-first order
+    queue.reserve(m_nodes.size());
+    queue.push_back(0);
+    for (size_t nHead = 0; nHead < queue.size(); nHead++)
+    {
+        size_t nNode = queue[nHead];
+        size_t nFail = m_nodes[nNode].nFail;
+
+        for (nClass = 0; nClass < m_nClasses; nClass++)
+        {
+            size_t& nNext = m_delta[nNode * m_nClasses + nClass];
+
+            if ((0 != nNext) && (0 < nClass))
+            {   // the edge of the trie
+                size_t nChildFail = (0 == nNode) ? 0 : m_delta[nFail * m_nClasses + nClass];
+                tNode& child = m_nodes[nNext];
+
+                child.nFail = nChildFail;
+                child.nOutLink = (tNoPattern != m_nodes[nChildFail].nPattern) ?
+                    nChildFail : m_nodes[nChildFail].nOutLink;
+                queue.push_back(nNext);
+            }
+            else
+            {
+                nNext = (0 == nNode) ? 0 : m_delta[nFail * m_nClasses + nClass];
+            }
+        }
+    }
+    BuildPrefilter();
+    m_bBuilt = true;
+}
+
+// Collects the first characters of patterns for the prefilter, if it can be used
+template<class TCHARTYPE>
+void CSubstRecognizer<TCHARTYPE>::BuildPrefilter()
+{
+    size_t nPattern, nOffset;
+
+    m_scanner.Clear();
+    m_bPrefilter = m_bPrefilterAllowed;
+    for (nPattern = 0, nOffset = 0; m_bPrefilter && (nPattern < m_lengths.size()); nOffset += m_lengths[nPattern++])
+    {
+        if (0 < m_lengths[nPattern])
+        {
+            TCHARTYPE ch = m_texts[nOffset];
+
+            if (m_bIgnoreCase)
+            {   // other characters folding to ch could not be found by the scanner
+                if (1 == sizeof(TCHARTYPE))
+                    m_bPrefilter = (toupper((unsigned char)ch) == (unsigned char)ch);
+                else
+                    m_bPrefilter = ((TCHARTYPE)towupper((wint_t)ch) == ch);
+            }
+            m_bPrefilter = m_bPrefilter && m_scanner.AddChar(ch);
+        }
+    }
+}
+
+// Finds the leftmost pattern in lpText[nFrom, nLength); of the patterns starting there,
+// the one added first. The scanning stops as soon as no other pattern can start before the found one.
+template<class TCHARTYPE>
+bool CSubstRecognizer<TCHARTYPE>::FindNext(
+    TCHARTYPE const* lpText,
+    size_t nLength,
+    size_t nFrom,
+    size_t &nStart,
+    size_t &nPattern) const
+{
+    size_t nState = 0;
+    bool bFound = false;
+
+    ASSERT(m_bBuilt);
+    for (size_t ii = nFrom; ii < nLength; ii++)
+    {
+        if ((0 == nState) && m_bPrefilter)
+        {   // no pattern is started ( and none found ); skip right to the next character starting one
+            if (nLength == (ii = m_scanner.Find(lpText, ii, nLength)))
+            {
+                break;
+            }
+        }
+        nState = m_delta[nState * m_nClasses + ClassOf(Normalize(lpText[ii]))];
+
+        tNode const& node = m_nodes[nState];
+        size_t nOut;
+
+        // patterns ending from now on start at ( ii + 1 - depth ) or later
+        if (bFound && (nStart + node.nDepth < ii + 1))
+        {
+            break;
+        }
+        nOut = (tNoPattern != node.nPattern) ? nState : node.nOutLink;
+        for (; tNoPattern != nOut; nOut = m_nodes[nOut].nOutLink)
+        {
+            size_t nOutStart = ii + 1 - m_nodes[nOut].nDepth;
+            size_t nOutPattern = m_nodes[nOut].nPattern;
+
+            if (!bFound || (nOutStart < nStart) || ((nOutStart == nStart) && (nOutPattern < nPattern)))
+            {
+                nStart = nOutStart;
+                nPattern = nOutPattern;
+                bFound = true;
+            }
+        }
+    }
+    return bFound;
+}
@@ -0,0 +1,253 @@
+/////////////////////////////////////////////////////////////////////////////
+// SubstRenderCache.h : interface of the class CSubstRenderCache
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef __SUBSTRENDERCACHE_H__
+#define __SUBSTRENDERCACHE_H__
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDE FILES
+/////////////////////////////////////////////////////////////////////////////
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include "SubstHash.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// CLASES
+/////////////////////////////////////////////////////////////////////////////
+
+/** CSubstRenderCache keeps the texts rendered by CSubstLogData::LogStrToPhysStr lately,
+    so that rendering the same template with the same values again ( like the preview and the sending
+    of the same message ) just returns the text kept. The key of the text is the content hash
+    of the template ( see CSubstLogData::GetContentHash ) and the hash of the field texts resolved.
+    The texts least recently used are evicted when their total size exceeds the byte budget.
+    The cache remembers the last state of each template rendered ( its owner );
+    when the template is rendered after it has been edited, the texts of its previous state are dropped at once.
+    The texts returned share the buffer with the texts kept, as CString does.
+    The cache may be used by several threads at once, and so may the templates rendered through it
+    ( their content hashes and render plans are computed under their own lock ), as long as no thread
+    modifies a template while others render it. The providers of the field texts are not shared by the cache;
+    in particular, CSubstRenderContext must not be used by several threads at once.
+*/
+class CSubstRenderCache
+{
+public:
+    typedef CSubstHash64::tValue tHash;
+
+    enum { tDefaultByteBudget = 4 * 1024 * 1024 };
+
+protected:
+    struct tKey
+    {
+        tHash nTemplate;
+        tHash nValues;
+
+        bool operator == (tKey const& rhs) const
+        { return (nTemplate == rhs.nTemplate) && (nValues == rhs.nValues); }
+    };
+
+    struct tKeyHash
+    {
+        size_t operator () (tKey const& key) const
+        { return (size_t)(key.nTemplate ^ CSubstHash64::Mix(key.nValues)); }
+    };
+
+    struct tEntry
+    {
+        tKey        key;
+        void const* lpOwner;
+        CString     strText;
+        size_t      nBytes;
+    };
+
+    // The last state of the template rendered, and the count of its texts kept
+    struct tOwner
+    {
+        tHash  nTemplate;
+        size_t nEntries;
+    };
+
+    typedef std::list<tEntry> tEntries;
+
+    mutable std::mutex m_lock;
+    // the most recently used first
+    tEntries m_entries;
+    std::unordered_map<tKey, tEntries::iterator, tKeyHash> m_index;
+    std::unordered_map<void const*, tOwner> m_owners;
+    size_t   m_nByteBudget;
+    size_t   m_nBytes;
+    // statistics
+    size_t   m_nHits;
+    size_t   m_nMisses;
+    size_t   m_nEvicted;
+    size_t   m_nInvalidated;
+
+public:
+    CSubstRenderCache(size_t nByteBudget = tDefaultByteBudget)
+        : m_nByteBudget(nByteBudget), m_nBytes(0), m_nHits(0), m_nMisses(0), m_nEvicted(0), m_nInvalidated(0)
+    { }
+
+    size_t GetByteBudget() const
+    { return m_nByteBudget; }
+    /// Assigns the byte budget, evicting the texts not fitting in it
+    void SetByteBudget(size_t nByteBudget)
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        m_nByteBudget = nByteBudget;
+        EvictOverBudget(0);
+    }
+
+    /// Returns the count of bytes taken by the texts kept, including the overhead of entries
+    size_t GetUsedBytes() const
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        return m_nBytes;
+    }
+    size_t GetCount() const
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        return m_entries.size();
+    }
+
+    size_t GetHitCount() const
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        return m_nHits;
+    }
+    size_t GetMissCount() const
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        return m_nMisses;
+    }
+    /// Returns the count of texts evicted to keep the byte budget
+    size_t GetEvictedCount() const
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        return m_nEvicted;
+    }
+    /// Returns the count of texts dropped since their template has been edited
+    size_t GetInvalidatedCount() const
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        return m_nInvalidated;
+    }
+
+    void Clear()
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        m_entries.clear();
+        m_index.clear();
+        m_owners.clear();
+        m_nBytes = 0;
+    }
+
+    /** Finds the text of the template of lpOwner in the state nTemplate, rendered with the values nValues.
+        If the template of lpOwner has been rendered in another state before, its texts are dropped first.
+    */
+    BOOL Lookup(void const* lpOwner, tHash nTemplate, tHash nValues, CString &strText)
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        std::unordered_map<void const*, tOwner>::iterator iterOwner = m_owners.find(lpOwner);
+        tKey key;
+
+        if ((m_owners.end() != iterOwner) && (iterOwner->second.nTemplate != nTemplate))
+        {
+            InvalidateOwner(lpOwner);
+        }
+
+        key.nTemplate = nTemplate;
+        key.nValues = nValues;
+        std::unordered_map<tKey, tEntries::iterator, tKeyHash>::iterator iter = m_index.find(key);
+
+        if (m_index.end() == iter)
+        {
+            m_nMisses++;
+            return FALSE;
+        }
+        m_entries.splice(m_entries.begin(), m_entries, iter->second);
+        strText = iter->second->strText;
+        m_nHits++;
+        return TRUE;
+    }
+
+    /// Keeps the text of the template of lpOwner in the state nTemplate, rendered with the values nValues
+    void Add(void const* lpOwner, tHash nTemplate, tHash nValues, CString const& strText)
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        tEntry entry;
+
+        entry.key.nTemplate = nTemplate;
+        entry.key.nValues = nValues;
+        entry.lpOwner = lpOwner;
+        entry.strText = strText;
+        entry.nBytes = sizeof(tEntry) + (size_t)(strText.GetLength() + 1) * sizeof(TCHAR);
+        if ((entry.nBytes > m_nByteBudget) || (m_index.end() != m_index.find(entry.key)))
+        {   // would not fit in at all, or it has been added by another thread meanwhile
+            return;
+        }
+        std::unordered_map<void const*, tOwner>::iterator iterOwner = m_owners.find(lpOwner);
+
+        if ((m_owners.end() != iterOwner) && (iterOwner->second.nTemplate != nTemplate))
+        {
+            InvalidateOwner(lpOwner);
+        }
+        EvictOverBudget(entry.nBytes);
+
+        tOwner& owner = m_owners[lpOwner];
+
+        if (0 == owner.nEntries)
+        {
+            owner.nTemplate = nTemplate;
+        }
+        owner.nEntries++;
+        m_entries.push_front(entry);
+        m_index[entry.key] = m_entries.begin();
+        m_nBytes += entry.nBytes;
+    }
+
+protected:
+    void Remove(tEntries::iterator iter)
+    {
+        std::unordered_map<void const*, tOwner>::iterator iterOwner = m_owners.find(iter->lpOwner);
+
+        if ((m_owners.end() != iterOwner) && (0 == --iterOwner->second.nEntries))
+        {
+            m_owners.erase(iterOwner);
+        }
+        m_index.erase(iter->key);
+        m_nBytes -= iter->nBytes;
+        m_entries.erase(iter);
+    }
+
+    // Evicts the texts least recently used, until nBytes more fit in the budget
+    void EvictOverBudget(size_t nBytes)
+    {
+        while (!m_entries.empty() && (m_nBytes + nBytes > m_nByteBudget))
+        {
+            Remove(--m_entries.end());
+            m_nEvicted++;
+        }
+    }
+
+    void InvalidateOwner(void const* lpOwner)
+    {
+        for (tEntries::iterator iter = m_entries.begin(); iter != m_entries.end(); )
+        {
+            tEntries::iterator iterNext = iter;
+
+            ++iterNext;
+            if (iter->lpOwner == lpOwner)
+            {
+                Remove(iter);
+                m_nInvalidated++;
+            }
+            iter = iterNext;
+        }
+        m_owners.erase(lpOwner);
+    }
+};
+
+#endif // __SUBSTRENDERCACHE_H__
@@ -0,0 +1,170 @@
+/////////////////////////////////////////////////////////////////////////////
+// SubstRenderContext.h : interface ISubstValueProvider,
+//                        and the class CSubstRenderContext
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef __SUBSTRENDERCONTEXT_H__
+#define __SUBSTRENDERCONTEXT_H__
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDE FILES
+/////////////////////////////////////////////////////////////////////////////
+#include <unordered_map>
+#include "SubstMapping.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// TYPES
+/////////////////////////////////////////////////////////////////////////////
+
+/// How the text provided by ISubstValueProvider may be reused by CSubstRenderContext
+enum ESubstValueKind
+{
+    /// The text of the field never changes; it is kept as long as the context is.
+    eValuePure,
+    /// The text changes in time, like the current date. It is resolved once per render,
+    /// and reused by following renders only for the time to live given by the provider.
+    eValueVolatile,
+    /// The text may change, and it is costly to get. It is reused by following renders
+    /// for the time to live given by the provider, or for the default time to live of the context.
+    eValueExpensive,
+};
+
+/** ISubstValueProvider provides the texts of fields rendered by CSubstLogData::LogStrToPhysStr,
+    through CSubstRenderContext.
+*/
+template<class TFIELDID> interface ISubstValueProvider
+{
+    /// Returns the text of the field
+    virtual CString GetFieldText(SubstDescr<TFIELDID> const* lpDescr) = 0;
+    /// Returns how the text of the field may be reused
+    virtual ESubstValueKind GetValueKind(SubstDescr<TFIELDID> const* lpDescr) const = 0;
+    /// Returns how long ( in milliseconds ) the text may be reused by following renders;
+    /// zero means the default of the value kind
+    virtual DWORD GetTimeToLive(SubstDescr<TFIELDID> const* lpDescr) const = 0;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// CLASES
+/////////////////////////////////////////////////////////////////////////////
+
+/** CSubstRenderContext keeps the field texts got from ISubstValueProvider,
+    so that each distinct field is resolved at most once per render, however many times it occurs,
+    and the texts that may be reused are kept for following renders ( see ESubstValueKind ).
+    The context is meant to live as long as the provider does, like the preview of the form view;
+    it is not thread-safe.
+*/
+template<class TFIELDID> class CSubstRenderContext
+{
+protected:
+    struct tEntry
+    {
+        CString   strText;
+        // the render the text has been resolved or reused by last
+        ULONGLONG nRender;
+        // the time the text has been resolved, and how long it may be reused
+        ULONGLONG nResolvedTick;
+        ULONGLONG nTimeToLive;
+        ESubstValueKind kind;
+    };
+
+    ISubstValueProvider<TFIELDID>* m_lpProvider;
+    std::unordered_map<SubstDescr<TFIELDID> const*, tEntry> m_entries;
+    // the count of renders so far, and the time the current one has begun
+    ULONGLONG m_nRender;
+    ULONGLONG m_nRenderTick;
+    // the time to live of expensive values, if the provider does not give its own
+    DWORD     m_dwExpensiveTimeToLive;
+    // statistics
+    size_t    m_nResolved;
+    size_t    m_nReused;
+
+public:
+    CSubstRenderContext(ISubstValueProvider<TFIELDID>* lpProvider = NULL, DWORD dwExpensiveTimeToLive = 1000)
+        : m_lpProvider(lpProvider), m_nRender(0), m_nRenderTick(0),
+          m_dwExpensiveTimeToLive(dwExpensiveTimeToLive), m_nResolved(0), m_nReused(0)
+    { }
+
+    ISubstValueProvider<TFIELDID>* GetProvider() const
+    { return m_lpProvider; }
+    /// Assigns the provider, forgetting all the texts of the previous one
+    void SetProvider(ISubstValueProvider<TFIELDID>* lpProvider)
+    {
+        m_lpProvider = lpProvider;
+        Invalidate();
+    }
+
+    DWORD GetExpensiveTimeToLive() const
+    { return m_dwExpensiveTimeToLive; }
+    void SetExpensiveTimeToLive(DWORD dwTimeToLive)
+    { m_dwExpensiveTimeToLive = dwTimeToLive; }
+
+    /// Returns the count of texts got from the provider
+    size_t GetResolvedCount() const
+    { return m_nResolved; }
+    /// Returns the count of texts not got from the provider, since they have been kept
+    size_t GetReusedCount() const
+    { return m_nReused; }
+
+    /// Forgets all the texts kept, e.g. when the data of the provider have changed
+    void Invalidate()
+    { m_entries.clear(); }
+
+    /// Begins the next render; called by CSubstLogData::LogStrToPhysStr
+    void BeginRender()
+    {
+        m_nRender++;
+        m_nRenderTick = ::GetTickCount64();
+    }
+
+    /** Returns the text of the field and its length, getting it from the provider
+        only if it has not been got by this render already, and if it may not be reused.
+        The text remains valid until the next render.
+    */
+    LPCTSTR GetFieldText(SubstDescr<TFIELDID> const* lpDescr, size_t &nLength)
+    {
+        typename std::unordered_map<SubstDescr<TFIELDID> const*, tEntry>::iterator iter = m_entries.find(lpDescr);
+        tEntry* lpEntry;
+
+        ASSERT(NULL != m_lpProvider);
+        ASSERT(0 < m_nRender);
+        if ((m_entries.end() != iter) && IsReusable(iter->second))
+        {
+            lpEntry = &iter->second;
+            if (lpEntry->nRender != m_nRender)
+            {
+                lpEntry->nRender = m_nRender;
+                m_nReused++;
+            }
+        }
+        else
+        {   // the entry is completed before it is stored, in case the provider throws
+            tEntry entry;
+
+            entry.strText = m_lpProvider->GetFieldText(lpDescr);
+            entry.kind = m_lpProvider->GetValueKind(lpDescr);
+            entry.nTimeToLive = m_lpProvider->GetTimeToLive(lpDescr);
+            if ((0 == entry.nTimeToLive) && (eValueExpensive == entry.kind))
+            {
+                entry.nTimeToLive = m_dwExpensiveTimeToLive;
+            }
+            entry.nRender = m_nRender;
+            entry.nResolvedTick = m_nRenderTick;
+            m_nResolved++;
+            lpEntry = &(m_entries[lpDescr] = entry);
+        }
+        nLength = (size_t)lpEntry->strText.GetLength();
+        return lpEntry->strText;
+    }
+
+protected:
+    bool IsReusable(tEntry const& entry) const
+    {
+        if ((entry.nRender == m_nRender) || (eValuePure == entry.kind))
+        {
+            return true;
+        }
+        return (m_nRenderTick - entry.nResolvedTick < entry.nTimeToLive);
+    }
+};
+
+#endif // __SUBSTRENDERCONTEXT_H__
@@ -0,0 +1,133 @@
+/////////////////////////////////////////////////////////////////////////////
+// SubstRenderExt.h : interface of the template CSubstRenderExt
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef __SUBSTRENDEREXT_H__
+#define __SUBSTRENDEREXT_H__
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDE FILES
+/////////////////////////////////////////////////////////////////////////////
+// Note: This header is included only by those rendering CSubstLogData on the threads of CSubstWorkPool,
+// so that the other users of CSubstLogData do not depend on the threads.
+#include <unordered_map>
+#include <vector>
+#include "SubstObjectsLogical.h"
+#include "SubstAsyncResolver.h"
+#include "SubstBatchRender.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// CLASES
+/////////////////////////////////////////////////////////////////////////////
+
+/** CSubstRenderExt renders CSubstLogData with the help of CSubstWorkPool;
+    the field texts are resolved concurrently, or the data are rendered for many records at once
+    by CSubstBatchRenderer.
+*/
+template<class TFIELDID> class CSubstRenderExt
+{
+public:
+    /// Resolves the field texts concurrently; the key of the value is the descriptor of the field
+    typedef CSubstAsyncResolver<TCHAR, SubstDescr<TFIELDID> const*> tAsyncResolver;
+    typedef CSubstRenderTemplate<TCHAR, TFIELDID> tRenderTemplate;
+
+protected:
+    // Provides the field texts for the render plan collected in advance, one per slot
+    class CCollectedTextViews : public std::vector<tSubstTextView>
+    {
+    public:
+        BOOL GetView(size_t nSlot, typename CSubstRenderPlan<TFIELDID>::tSlot const&, tSubstTextView &view) const
+        {
+            view = (*this)[nSlot];
+            return (NULL != view.lpText);
+        }
+    };
+
+public:
+    /** Returns the physical string, with the field texts resolved by the resolver concurrently.
+        Each distinct field is resolved once, by one task of the resolver's pool;
+        the fields not resolved in dwTimeout milliseconds, or not resolved at all, are rendered as szPlaceholder,
+        or as their text in the map if szPlaceholder is NULL.
+    */
+    static CString LogStrToPhysStr(
+        CSubstLogData<TFIELDID> const &logData,
+        tAsyncResolver &resolver,
+        DWORD           dwTimeout,
+        LPCTSTR         szPlaceholder = NULL)
+    {
+        CSubstRenderPlan<TFIELDID> const& plan = logData.GetRenderPlan();
+        size_t                      ii, nSlots = plan.GetSlotCount();
+        std::unordered_map<SubstDescr<TFIELDID> const*, size_t> distinct;
+        std::vector<SubstDescr<TFIELDID> const*> keys;
+        std::vector<typename tAsyncResolver::tResult> results;
+        CCollectedTextViews         views;
+        SubstDescr<TFIELDID> const* lpDesc;
+
+        // collect the distinct fields, and resolve them all at once
+        for (ii = 0; ii < nSlots; ii++)
+        {
+            if ((NULL != (lpDesc = plan.GetFieldDescr(ii))) && (distinct.end() == distinct.find(lpDesc)))
+            {
+                distinct[lpDesc] = keys.size();
+                keys.push_back(lpDesc);
+            }
+        }
+        if (!keys.empty())
+        {
+            resolver.Resolve(&keys[0], keys.size(), dwTimeout, results);
+        }
+
+        views.resize(nSlots);
+        for (ii = 0; ii < nSlots; ii++)
+        {
+            if (NULL != (lpDesc = plan.GetFieldDescr(ii)))
+            {
+                typename tAsyncResolver::tResult const& result = results[distinct[lpDesc]];
+
+                if (tAsyncResolver::eStateResolved == result.state)
+                {
+                    views[ii].lpText = result.strText.c_str();
+                    views[ii].nLength = result.strText.size();
+                }
+                else if (NULL != szPlaceholder)
+                {
+                    views[ii].lpText = szPlaceholder;
+                    views[ii].nLength = _tcslen(szPlaceholder);
+                }
+                else
+                {
+                    views[ii].lpText = lpDesc->lpTxt;
+                    views[ii].nLength = plan.GetSlot(ii).nTextLength;
+                }
+            }
+            else
+            {
+                views[ii].lpText = NULL;
+                views[ii].nLength = 0;
+            }
+        }
+        return plan.Render(logData.GetLogStr(), views);
+    }
+
+    /** Takes the snapshot of the logical string and the field positions, to be rendered by CSubstBatchRenderer.
+        The template does not refer to logData, and it is not changed by further edits of it.
+        The markers of sections are left out, as CSubstBatchRenderer renders just the fields.
+    */
+    static void GetRenderTemplate(CSubstLogData<TFIELDID> const &logData, tRenderTemplate &templ)
+    {
+        size_t  nLength = logData.GetLogLength();
+        INT_PTR nCount = logData.GetLogInfoCount();
+
+        templ.AssignText(logData.GetLogStr(), nLength);
+        templ.ReserveSlots((size_t)nCount);
+        for (INT_PTR ii = 0; ii < nCount; ii++)
+        {   // the markers of sections are not rendered
+            if (eLogInfoField == logData.GetLogInfoKind(ii))
+            {
+                templ.AppendSlot(logData.GetLogInfoPos(ii), logData.GetLogInfoWhat(ii));
+            }
+        }
+    }
+};
+
+#endif // __SUBSTRENDEREXT_H__
@@ -0,0 +1,262 @@
+/////////////////////////////////////////////////////////////////////////////
+// SubstRenderPlan.h : interface of the class CSubstRenderPlan
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef __SUBSTRENDERPLAN_H__
+#define __SUBSTRENDERPLAN_H__
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDE FILES
+/////////////////////////////////////////////////////////////////////////////
+#include <vector>
+#include "SubstMapping.h"
+#include "SubstEditStamp.h"
+#include "SubstTextSink.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// TYPES
+/////////////////////////////////////////////////////////////////////////////
+
+/** tSubstTextView is the text not owned by the holder, and its length; the text is not null-terminated.
+*/
+struct tSubstTextView
+{
+    LPCTSTR lpText;
+    size_t  nLength;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// CLASES
+/////////////////////////////////////////////////////////////////////////////
+
+/** CSubstRenderPlan is CSubstLogData compiled for rendering ( see CSubstLogData::GetRenderPlan ):
+    the flat array of field slots, each with the length of the logical text preceding it,
+    and with the descriptor of the field and the length of its text resolved already.
+    Rendering is then a loop copying the spans of logical text and the field texts,
+    with the length of the result computed in advance.
+    The slots of the markers of sections are rendered only with the texts of the map, 
+    which is the physical form of the data; renderings with other field texts skip them.
+    The plan does not keep the logical text; it is given to Render, and it must be the text
+    the plan has been compiled of. The plan keeps the stamps of the text and of the fields it has been compiled of,
+    so the owner finds whether it is still valid.
+*/
+template<class TFIELDID> class CSubstRenderPlan
+{
+public:
+    struct tSlot
+    {
+        // the length of the logical text between the previous field ( or the beginning ) and this one
+        size_t   nLiteral;
+        TFIELDID id;
+        // the descriptor of the field, or NULL if the field is not in the map
+        SubstDescr<TFIELDID> const* lpDescr;
+        // the length of lpDescr->lpTxt
+        size_t   nTextLength;
+        // false for the marker of a section
+        bool     bField;
+    };
+
+protected:
+    std::vector<tSlot> m_slots;
+    // the length of the logical text
+    size_t  m_nLogLength;
+    // the length of the logical text following the last field
+    size_t  m_nTail;
+    // the total length of the field texts of the map
+    size_t  m_nTextsLength;
+    // the logical position of the last slot appended
+    size_t  m_nLastPos;
+
+    // what the plan has been compiled of
+    bool    m_bCompiled;
+    CSubstEditStamp::tValue m_nTextStamp;
+    CSubstEditStamp::tValue m_nFieldsStamp;
+    SubstDescr<TFIELDID> const* m_lpMap;
+
+public:
+    CSubstRenderPlan()
+        : m_nLogLength(0), m_nTail(0), m_nTextsLength(0), m_nLastPos(0),
+          m_bCompiled(false), m_nTextStamp(0), m_nFieldsStamp(0), m_lpMap(NULL)
+    { }
+
+    size_t GetSlotCount() const
+    { return m_slots.size(); }
+    tSlot const& GetSlot(size_t nSlot) const
+    { return m_slots[nSlot]; }
+    size_t GetLogLength() const
+    { return m_nLogLength; }
+    /// Returns the length of the text rendered with the field texts of the map
+    size_t GetMapRenderLength() const
+    { return m_nLogLength + m_nTextsLength; }
+    /// Returns the descriptor of the field of the slot, or NULL for the marker of a section or the field not in the map
+    SubstDescr<TFIELDID> const* GetFieldDescr(size_t nSlot) const
+    { return m_slots[nSlot].bField ? m_slots[nSlot].lpDescr : NULL; }
+
+    /// Returns true if the plan has been compiled of the data in the given state
+    bool IsCompiledOf(
+        CSubstEditStamp::tValue nTextStamp,
+        CSubstEditStamp::tValue nFieldsStamp,
+        SubstDescr<TFIELDID> const* lpMap) const
+    {
+        return m_bCompiled && (m_nTextStamp == nTextStamp) && (m_nFieldsStamp == nFieldsStamp) && (m_lpMap == lpMap);
+    }
+
+    //// compilation; see CSubstLogData::GetRenderPlan ///////////////////
+    /// Starts the compilation of the data in the given state; the memory of the previous plan is reused
+    void BeginCompile(
+        size_t nLogLength,
+        size_t nSlots,
+        CSubstEditStamp::tValue nTextStamp,
+        CSubstEditStamp::tValue nFieldsStamp,
+        SubstDescr<TFIELDID> const* lpMap)
+    {
+        m_slots.clear();
+        m_slots.reserve(nSlots);
+        m_nLogLength = nLogLength;
+        m_nTail = nLogLength;
+        m_nTextsLength = 0;
+        m_nLastPos = 0;
+        m_bCompiled = false;
+        m_nTextStamp = nTextStamp;
+        m_nFieldsStamp = nFieldsStamp;
+        m_lpMap = lpMap;
+    }
+
+    /// Appends the slot of the field ( or the marker of a section, if bField is false ) on the logical position nLogPos; 
+    /// slots must be appended in the order of positions
+    void AppendSlot(size_t nLogPos, TFIELDID id, SubstDescr<TFIELDID> const* lpDescr, size_t nTextLength, bool bField = true)
+    {
+        tSlot slot;
+
+        ASSERT((m_nLastPos <= nLogPos) && (nLogPos <= m_nLogLength));
+        slot.nLiteral = nLogPos - m_nLastPos;
+        slot.id = id;
+        slot.lpDescr = lpDescr;
+        slot.nTextLength = (NULL != lpDescr) ? nTextLength : 0;
+        slot.bField = bField;
+        m_slots.push_back(slot);
+        m_nTextsLength += slot.nTextLength;
+        m_nLastPos = nLogPos;
+    }
+
+    void EndCompile()
+    {
+        m_nTail = m_nLogLength - m_nLastPos;
+        m_bCompiled = true;
+    }
+
+    //// rendering ///////////////////////////////////////////////////////
+    /// Renders the logical text lpLogText with the field texts of the map
+    CString Render(LPCTSTR lpLogText) const
+    {
+        return Compose(lpLogText, CMapViews(), GetMapRenderLength(), true);
+    }
+
+    /** Renders the logical text lpLogText with the field texts provided by views;
+        views.GetView(nSlot, slot, view) returns FALSE for the field not rendered.
+        It is called twice for each slot of a field, and must return the same view both times;
+        it is not called for the markers of sections.
+    */
+    template<class TVIEWS>
+    CString Render(LPCTSTR lpLogText, TVIEWS const &views) const
+    {
+        tSubstTextView view;
+        size_t nTotal = m_nLogLength;
+
+        for (size_t ii = 0, nSlots = m_slots.size(); ii < nSlots; ii++)
+        {
+            if (m_slots[ii].bField && views.GetView(ii, m_slots[ii], view))
+            {
+                nTotal += view.nLength;
+            }
+        }
+        return Compose(lpLogText, views, nTotal, false);
+    }
+
+    /// Writes the logical text lpLogText rendered with the field texts of the map to the writer
+    void Write(LPCTSTR lpLogText, CSubstTextWriter &writer) const
+    {
+        CMapViews views;
+
+        WriteSlots(lpLogText, views, writer, true);
+    }
+
+    /** Writes the logical text lpLogText rendered with the field texts provided by views to the writer.
+        Unlike Render, views.GetView is called just once for each slot of a field, right before its text is written;
+        so the view needs to be valid only until the next call, and it may be got lazily.
+    */
+    template<class TVIEWS>
+    void Write(LPCTSTR lpLogText, TVIEWS &views, CSubstTextWriter &writer) const
+    {
+        WriteSlots(lpLogText, views, writer, false);
+    }
+
+protected:
+    // Provides the field texts of the map, as resolved by the compilation
+    class CMapViews
+    {
+    public:
+        BOOL GetView(size_t, tSlot const& slot, tSubstTextView &view) const
+        {
+            view.lpText = (NULL != slot.lpDescr) ? slot.lpDescr->lpTxt : NULL;
+            view.nLength = slot.nTextLength;
+            return (NULL != view.lpText);
+        }
+    };
+
+    // Writes the text to the writer; the markers of sections are written only if bMarkers is true
+    template<class TVIEWS>
+    void WriteSlots(LPCTSTR lpLogText, TVIEWS &views, CSubstTextWriter &writer, bool bMarkers) const
+    {
+        tSubstTextView view;
+
+        ASSERT(m_bCompiled);
+        for (size_t ii = 0, nSlots = m_slots.size(); ii < nSlots; ii++)
+        {
+            tSlot const& slot = m_slots[ii];
+
+            writer.Write(lpLogText, slot.nLiteral);
+            lpLogText += slot.nLiteral;
+            if ((slot.bField || bMarkers) && views.GetView(ii, slot, view))
+            {
+                writer.Write(view.lpText, view.nLength);
+            }
+        }
+        writer.Write(lpLogText, m_nTail);
+    }
+
+    // Composes the text of nTotal characters; the result is allocated just once.
+    // The markers of sections are composed only if bMarkers is true.
+    template<class TVIEWS>
+    CString Compose(LPCTSTR lpLogText, TVIEWS const &views, size_t nTotal, bool bMarkers) const
+    {
+        CString        strResult;
+        tSubstTextView view;
+        LPTSTR         lpStart, lpOut;
+
+        ASSERT(m_bCompiled);
+        if (0 < nTotal)
+        {
+            lpOut = lpStart = strResult.GetBuffer((int)nTotal);
+            for (size_t ii = 0, nSlots = m_slots.size(); ii < nSlots; ii++)
+            {
+                tSlot const& slot = m_slots[ii];
+
+                memcpy(lpOut, lpLogText, slot.nLiteral * sizeof(TCHAR));
+                lpOut += slot.nLiteral;
+                lpLogText += slot.nLiteral;
+                if ((slot.bField || bMarkers) && views.GetView(ii, slot, view))
+                {
+                    memcpy(lpOut, view.lpText, view.nLength * sizeof(TCHAR));
+                    lpOut += view.nLength;
+                }
+            }
+            memcpy(lpOut, lpLogText, m_nTail * sizeof(TCHAR));
+            ASSERT(lpOut + m_nTail == lpStart + nTotal);
+            strResult.ReleaseBuffer((int)nTotal);
+        }
+        return strResult;
+    }
+};
+
+#endif // __SUBSTRENDERPLAN_H__
@@ -0,0 +1,347 @@
+/////////////////////////////////////////////////////////////////////////////
+// SubstTemplateProgram.h : interface ISubstTemplateValues,
+//                          and the class CSubstTemplateProgram
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef __SUBSTTEMPLATEPROGRAM_H__
+#define __SUBSTTEMPLATEPROGRAM_H__
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDE FILES
+/////////////////////////////////////////////////////////////////////////////
+#include <vector>
+#include "SubstEditStamp.h"
+#include "SubstTextSink.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// TYPES
+/////////////////////////////////////////////////////////////////////////////
+
+/** ISubstTemplateValues provides the values of fields rendered by CSubstTemplateProgram,
+    and the items of the repeated sections. While a section is repeated, the texts of the fields
+    are those of the current item ( see EnterItem ); the sections repeated may be nested.
+*/
+template<class TFIELDID> interface ISubstTemplateValues
+{
+    /// Returns the text of the field and its length, or NULL if the field has no text.
+    /// The text is written before the next call, so it may be overwritten then.
+    virtual LPCTSTR GetFieldText(TFIELDID id, size_t &nLength) = 0;
+    /// Returns the count of items the section of the field id is repeated for
+    virtual size_t GetItemCount(TFIELDID id) = 0;
+    /// Makes the item nItem of the field id the current one
+    virtual void EnterItem(TFIELDID id, size_t nItem) = 0;
+    /// Ends the repetition of the section of the field id; the enclosing item is the current one again
+    virtual void LeaveItems(TFIELDID id) = 0;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// CLASES
+/////////////////////////////////////////////////////////////////////////////
+
+/** CSubstTemplateProgram is CSubstLogData with sections compiled to the bytecode
+    ( see CSubstLogData::GetTemplateProgram ), executed by a small interpreter in one pass,
+    without any post-processing of the output.
+    The code is the array of words; each instruction is the opcode followed by its operands:
+      eOpText   nStart nLength  - writes nLength characters of the logical text from nStart
+      eOpField  nField          - writes the text of the field m_fields[nField]
+      eOpIf     nField nJump    - jumps to nJump if the field has no text
+      eOpRepeat nField nJump    - jumps to nJump if the field has no items,
+                                  otherwise enters the first item
+      eOpNext   nBody           - enters the next item and jumps to nBody,
+                                  or leaves the items if it was the last one
+      eOpHalt
+    Like CSubstRenderPlan, the program does not keep the logical text; it is given to Execute,
+    and it must be the text the program has been compiled of.
+*/
+template<class TFIELDID> class CSubstTemplateProgram
+{
+public:
+    typedef UINT tCode;
+
+    enum EOpCode
+    {
+        eOpText,
+        eOpField,
+        eOpIf,
+        eOpRepeat,
+        eOpNext,
+        eOpHalt,
+    };
+
+protected:
+    // The section open during the compilation
+    struct tOpenSection
+    {
+        // the position of the eOpIf or eOpRepeat
+        size_t nStart;
+        bool   bRepeat;
+    };
+
+    // The repeated section being executed
+    struct tLoop
+    {
+        TFIELDID id;
+        size_t   nItem;
+        size_t   nCount;
+    };
+
+    std::vector<tCode>    m_code;
+    // the operands nField of the code
+    std::vector<TFIELDID> m_fields;
+    // the length of the logical text, and the position the text has been compiled up to
+    size_t  m_nLogLength;
+    size_t  m_nLastPos;
+    // the maximal nesting of repeated sections
+    size_t  m_nMaxLoops;
+    // false if some section has not been closed, or some end has been without its section
+    bool    m_bBalanced;
+    std::vector<tOpenSection> m_open;
+
+    // what the program has been compiled of
+    bool    m_bCompiled;
+    CSubstEditStamp::tValue m_nTextStamp;
+    CSubstEditStamp::tValue m_nFieldsStamp;
+
+public:
+    CSubstTemplateProgram()
+        : m_nLogLength(0), m_nLastPos(0), m_nMaxLoops(0), m_bBalanced(true),
+          m_bCompiled(false), m_nTextStamp(0), m_nFieldsStamp(0)
+    { }
+
+    /// Returns the count of code words
+    size_t GetCodeSize() const
+    { return m_code.size(); }
+    tCode const* GetCode() const
+    { return m_code.empty() ? NULL : &m_code[0]; }
+    /// Returns false if the sections of the compiled data have not been nested properly;
+    /// the program is usable anyway, as the sections have been closed where it was missing
+    bool IsBalanced() const
+    { return m_bBalanced; }
+
+    /// Returns true if the program has been compiled of the data in the given state
+    bool IsCompiledOf(CSubstEditStamp::tValue nTextStamp, CSubstEditStamp::tValue nFieldsStamp) const
+    {
+        return m_bCompiled && (m_nTextStamp == nTextStamp) && (m_nFieldsStamp == nFieldsStamp);
+    }
+
+    //// compilation; see CSubstLogData::GetTemplateProgram /////////////
+    /// Starts the compilation of the data in the given state; the memory of the previous program is reused
+    void BeginCompile(
+        size_t nLogLength,
+        size_t nItems,
+        CSubstEditStamp::tValue nTextStamp,
+        CSubstEditStamp::tValue nFieldsStamp)
+    {
+        m_code.clear();
+        m_code.reserve(5 * nItems + 4);
+        m_fields.clear();
+        m_fields.reserve(nItems);
+        m_open.clear();
+        m_nLogLength = nLogLength;
+        m_nLastPos = 0;
+        m_nMaxLoops = 0;
+        m_bBalanced = true;
+        m_bCompiled = false;
+        m_nTextStamp = nTextStamp;
+        m_nFieldsStamp = nFieldsStamp;
+    }
+
+    /// Appends the field on the logical position nLogPos;
+    /// the items must be appended in the order of positions
+    void AppendField(size_t nLogPos, TFIELDID id)
+    {
+        AppendTextUpTo(nLogPos);
+        m_code.push_back(eOpField);
+        m_code.push_back(AddField(id));
+    }
+
+    /// Begins the section written only if the field id has a text
+    void AppendIf(size_t nLogPos, TFIELDID id)
+    {
+        AppendTextUpTo(nLogPos);
+        OpenSection(eOpIf, id);
+    }
+
+    /// Begins the section repeated for each item of the field id
+    void AppendRepeat(size_t nLogPos, TFIELDID id)
+    {
+        AppendTextUpTo(nLogPos);
+        OpenSection(eOpRepeat, id);
+        if (m_nMaxLoops < GetOpenLoops())
+        {
+            m_nMaxLoops = GetOpenLoops();
+        }
+    }
+
+    /// Ends the section begun last; the end without any section is ignored
+    void AppendEnd(size_t nLogPos)
+    {
+        AppendTextUpTo(nLogPos);
+        if (m_open.empty())
+        {
+            m_bBalanced = false;
+        }
+        else
+        {
+            CloseSection();
+        }
+    }
+
+    void EndCompile()
+    {
+        AppendTextUpTo(m_nLogLength);
+        if (!m_open.empty())
+        {
+            m_bBalanced = false;
+            while (!m_open.empty())
+            {
+                CloseSection();
+            }
+        }
+        m_code.push_back(eOpHalt);
+        m_bCompiled = true;
+    }
+
+    //// execution ///////////////////////////////////////////////////////
+    /// Writes the output of the program for the logical text lpLogText and the given values
+    void Execute(LPCTSTR lpLogText, ISubstTemplateValues<TFIELDID> &values, CSubstTextWriter &writer) const
+    {
+        std::vector<tLoop> loops;
+        tCode const*       lpCode = GetCode();
+        LPCTSTR            lpText;
+        size_t             nPc = 0, nLength;
+
+        ASSERT(m_bCompiled);
+        loops.reserve(m_nMaxLoops);
+        for (;;)
+        {
+            switch (lpCode[nPc])
+            {
+                case eOpText:
+                    writer.Write(lpLogText + lpCode[nPc + 1], lpCode[nPc + 2]);
+                    nPc += 3;
+                    break;
+
+                case eOpField:
+                    if (NULL != (lpText = values.GetFieldText(m_fields[lpCode[nPc + 1]], nLength)))
+                    {
+                        writer.Write(lpText, nLength);
+                    }
+                    nPc += 2;
+                    break;
+
+                case eOpIf:
+                    nLength = 0;
+                    if ((NULL == values.GetFieldText(m_fields[lpCode[nPc + 1]], nLength)) || (0 == nLength))
+                    {
+                        nPc = lpCode[nPc + 2];
+                    }
+                    else
+                    {
+                        nPc += 3;
+                    }
+                    break;
+
+                case eOpRepeat:
+                    {
+                        tLoop loop;
+
+                        loop.id = m_fields[lpCode[nPc + 1]];
+                        loop.nItem = 0;
+                        if (0 == (loop.nCount = values.GetItemCount(loop.id)))
+                        {
+                            nPc = lpCode[nPc + 2];
+                        }
+                        else
+                        {
+                            loops.push_back(loop);
+                            values.EnterItem(loop.id, 0);
+                            nPc += 3;
+                        }
+                    }
+                    break;
+
+                case eOpNext:
+                    {
+                        tLoop &loop = loops.back();
+
+                        if (++loop.nItem < loop.nCount)
+                        {
+                            values.EnterItem(loop.id, loop.nItem);
+                            nPc = lpCode[nPc + 1];
+                        }
+                        else
+                        {
+                            values.LeaveItems(loop.id);
+                            loops.pop_back();
+                            nPc += 2;
+                        }
+                    }
+                    break;
+
+                default:
+                    ASSERT(eOpHalt == lpCode[nPc]);
+                    ASSERT(loops.empty());
+                    return;
+            }
+        }
+    }
+
+protected:
+    tCode AddField(TFIELDID id)
+    {
+        m_fields.push_back(id);
+        return (tCode)(m_fields.size() - 1);
+    }
+
+    size_t GetOpenLoops() const
+    {
+        size_t nLoops = 0;
+
+        for (size_t ii = 0; ii < m_open.size(); ii++)
+        {
+            nLoops += m_open[ii].bRepeat ? 1 : 0;
+        }
+        return nLoops;
+    }
+
+    void AppendTextUpTo(size_t nLogPos)
+    {
+        ASSERT((m_nLastPos <= nLogPos) && (nLogPos <= m_nLogLength));
+        if (m_nLastPos < nLogPos)
+        {
+            m_code.push_back(eOpText);
+            m_code.push_back((tCode)m_nLastPos);
+            m_code.push_back((tCode)(nLogPos - m_nLastPos));
+            m_nLastPos = nLogPos;
+        }
+    }
+
+    // Appends eOpIf or eOpRepeat; its jump is patched by CloseSection
+    void OpenSection(EOpCode op, TFIELDID id)
+    {
+        tOpenSection section;
+
+        section.nStart = m_code.size();
+        section.bRepeat = (eOpRepeat == op);
+        m_code.push_back(op);
+        m_code.push_back(AddField(id));
+        m_code.push_back(0);
+        m_open.push_back(section);
+    }
+
+    void CloseSection()
+    {
+        tOpenSection section = m_open.back();
+
+        m_open.pop_back();
+        if (section.bRepeat)
+        {
+            m_code.push_back(eOpNext);
+            m_code.push_back((tCode)(section.nStart + 3));
+        }
+        m_code[section.nStart + 2] = (tCode)m_code.size();
+    }
+};
+
+#endif // __SUBSTTEMPLATEPROGRAM_H__
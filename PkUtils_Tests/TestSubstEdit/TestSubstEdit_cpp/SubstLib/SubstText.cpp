@@ -0,0 +1,26 @@
+// SubstText.cpp
+//
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDE FILES
+/////////////////////////////////////////////////////////////////////////////
+#include "stdafx.h"
+#include "SubstText.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// MANIFESTED CONSTANTS & MACROS
+/////////////////////////////////////////////////////////////////////////////
+#ifdef _DEBUG
+#define new DEBUG_NEW
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+/////////////////////////////////////////////////////////////////////////////
+// EXPLICIT INSTANTIATIONS
+/////////////////////////////////////////////////////////////////////////////
+
+// Both variants are compiled in every configuration, whichever of them is CSubstText,
+// so that the one not selected by SUBST_PIECE_TABLE_TEXT can not get broken unnoticed.
+template class CSubstTextT<CString>;
+template class CSubstTextT<CSubstPieceTable<TCHAR> >;
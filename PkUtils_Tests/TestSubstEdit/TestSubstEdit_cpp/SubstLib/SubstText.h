@@ -0,0 +1,180 @@
+/////////////////////////////////////////////////////////////////////////////
+// SubstText.h
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef __SUBSTTEXT_H__
+#define __SUBSTTEXT_H__
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDE FILES
+/////////////////////////////////////////////////////////////////////////////
+#include "SubstPieceTable.h"
+#include "SubstEditStamp.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// MANIFESTED CONSTANTS & MACROS
+/////////////////////////////////////////////////////////////////////////////
+
+// Define SUBST_PIECE_TABLE_TEXT in the project settings to keep the logical and physical texts
+// of substitution data in CSubstPieceTable, instead of CString.
+// This pays off for very long texts ( see SubstBench/PieceTableBench.cpp: ~9x faster edits
+// at 100k characters ); for short ones the CString is faster ( ~3x at 1k characters ).
+// Both variants of CSubstTextT are compiled by SubstText.cpp, regardless the setting.
+/* #define SUBST_PIECE_TABLE_TEXT */
+
+/////////////////////////////////////////////////////////////////////////////
+// CLASES
+/////////////////////////////////////////////////////////////////////////////
+
+/** CSubstTextT keeps the logical or physical text of substitution data.
+    It is edited in place by Insert and Delete, so the callers do not have to copy the text
+    in order to modify it. The text is kept in TBUFFER, which is either CString,
+    or CSubstPieceTable, which makes the edits O(log n) and creates the contiguous text
+    only when GetString is called.
+*/
+template<class TBUFFER> class CSubstTextT
+{
+protected:
+    TBUFFER  m_text;
+    // changes with each modification
+    CSubstEditStamp m_stamp;
+
+public:
+    CSubstTextT()
+    { }
+    CSubstTextT(LPCTSTR szText)
+    { Assign(szText); }
+
+    size_t GetLength(void) const
+    { return (size_t)m_text.GetLength(); }
+    BOOL IsEmpty(void) const
+    { return (0 == GetLength()); }
+
+    /// Returns the contiguous text; the pointer is valid until the next modification
+    LPCTSTR GetString(void) const
+    { return m_text.GetString(); }
+    operator LPCTSTR() const
+    { return GetString(); }
+
+    TCHAR GetAt(size_t nPos) const
+    { return m_text.GetAt((int)nPos); }
+
+    /// Returns the stamp of the current version of the text
+    CSubstEditStamp::tValue GetStamp(void) const
+    { return m_stamp.GetValue(); }
+
+    void Empty(void)
+    {
+        m_text.Empty();
+        m_stamp.Touch();
+    }
+
+    void Assign(LPCTSTR szText)
+    {
+        AssignBuffer(m_text, szText);
+        m_stamp.Touch();
+    }
+    CSubstTextT& operator = (LPCTSTR szText)
+    {
+        Assign(szText);
+        return *this;
+    }
+
+    /// Inserts the text before the position nPos
+    void Insert(size_t nPos, LPCTSTR szText)
+    {
+        ASSERT(nPos <= GetLength());
+        if (NULL != szText)
+        {
+            InsertBuffer(m_text, nPos, szText);
+            m_stamp.Touch();
+        }
+    }
+
+    /// Deletes nCount characters starting on the position nPos
+    void Delete(size_t nPos, size_t nCount)
+    {
+        ASSERT(nPos + nCount <= GetLength());
+        m_text.Delete((int)nPos, (int)nCount);
+        m_stamp.Touch();
+    }
+
+    /// Returns nCount characters starting on the position nPos
+    CString Mid(size_t nPos, size_t nCount) const
+    {
+        ASSERT(nPos + nCount <= GetLength());
+        return MidBuffer(m_text, nPos, nCount);
+    }
+
+    /// Copies nCount characters starting on the position nPos to lpOutput ( not null-terminated )
+    void CopyTo(size_t nPos, size_t nCount, LPTSTR lpOutput) const
+    {
+        ASSERT(nPos + nCount <= GetLength());
+        CopyBuffer(m_text, nPos, nCount, lpOutput);
+    }
+
+    void Serialize(CArchive& ar)
+    {
+        if (ar.IsLoading())
+        {
+            LoadBuffer(ar, m_text);
+            m_stamp.Touch();
+        }
+        else
+        {
+            StoreBuffer(ar, m_text);
+        }
+    }
+
+protected:
+    //// the operations that differ for CString and CSubstPieceTable ////////
+
+    static void AssignBuffer(CString &text, LPCTSTR szText)
+    { text = szText; }
+    static void AssignBuffer(CSubstPieceTable<TCHAR> &text, LPCTSTR szText)
+    { text.Assign(szText, (NULL != szText) ? _tcslen(szText) : 0); }
+
+    static void InsertBuffer(CString &text, size_t nPos, LPCTSTR szText)
+    { text.Insert((int)nPos, szText); }
+    static void InsertBuffer(CSubstPieceTable<TCHAR> &text, size_t nPos, LPCTSTR szText)
+    { text.Insert(nPos, szText, _tcslen(szText)); }
+
+    static CString MidBuffer(CString const &text, size_t nPos, size_t nCount)
+    { return text.Mid((int)nPos, (int)nCount); }
+    static CString MidBuffer(CSubstPieceTable<TCHAR> const &text, size_t nPos, size_t nCount)
+    {
+        CSubstPieceTable<TCHAR>::tString strPart;
+
+        text.CopyTo(nPos, nCount, strPart);
+        return CString(strPart.c_str(), (int)strPart.length());
+    }
+
+    static void CopyBuffer(CString const &text, size_t nPos, size_t nCount, LPTSTR lpOutput)
+    { memcpy(lpOutput, text.GetString() + nPos, nCount * sizeof(TCHAR)); }
+    static void CopyBuffer(CSubstPieceTable<TCHAR> const &text, size_t nPos, size_t nCount, LPTSTR lpOutput)
+    { text.CopyTo(nPos, nCount, lpOutput); }
+
+    static void LoadBuffer(CArchive& ar, CString &text)
+    { ar >> text; }
+    static void LoadBuffer(CArchive& ar, CSubstPieceTable<TCHAR> &text)
+    {
+        CString strTmp;
+
+        ar >> strTmp;
+        text.Assign(strTmp, (size_t)strTmp.GetLength());
+    }
+
+    static void StoreBuffer(CArchive& ar, CString const &text)
+    { ar << text; }
+    static void StoreBuffer(CArchive& ar, CSubstPieceTable<TCHAR> const &text)
+    { ar << CString(text.GetString(), (int)text.GetLength()); }
+};
+
+/// The text of substitution data, as selected by SUBST_PIECE_TABLE_TEXT
+#ifdef SUBST_PIECE_TABLE_TEXT
+typedef CSubstTextT<CSubstPieceTable<TCHAR> > CSubstText;
+#else
+typedef CSubstTextT<CString> CSubstText;
+#endif // SUBST_PIECE_TABLE_TEXT
+
+#endif // __SUBSTTEXT_H__
@@ -0,0 +1,105 @@
+/////////////////////////////////////////////////////////////////////////////
+// SubstTextSearch.h
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef __SUBSTTEXTSEARCH_H__
+#define __SUBSTTEXTSEARCH_H__
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDE FILES
+/////////////////////////////////////////////////////////////////////////////
+// Note: This header intentionally does not depend on MFC,
+// so it can be used ( and benchmarked ) outside of the MFC build as well.
+#include <stddef.h>
+#include <vector>
+#include "SubstCharScanner.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// CLASES
+/////////////////////////////////////////////////////////////////////////////
+
+/** CSubstTextSearch finds occurrences of one pattern by the Boyer-Moore-Horspool algorithm,
+    skipping up to the pattern length on each mismatch. The skip table is indexed by the low byte
+    of the character, keeping the shortest skip of all characters sharing it;
+    so it is small for wide characters as well, and still correct.
+    One-character patterns are found by CSubstCharScanner.
+*/
+template<class TCHARTYPE> class CSubstTextSearch
+{
+public:
+    enum { tNotFound = (size_t)-1 };
+
+protected:
+    enum { tTableSize = 256 };
+
+    std::vector<TCHARTYPE> m_pattern;
+    size_t  m_skip[tTableSize];
+    CSubstCharScanner<TCHARTYPE> m_scanner;
+
+public:
+    CSubstTextSearch(TCHARTYPE const* lpPattern, size_t nLength)
+        : m_pattern(lpPattern, lpPattern + nLength)
+    {
+        for (size_t ii = 0; ii < tTableSize; ii++)
+        {
+            m_skip[ii] = nLength;
+        }
+        // the last character is not included; it is where the skip is looked up
+        for (size_t ii = 0; ii + 1 < nLength; ii++)
+        {
+            m_skip[TableIndex(lpPattern[ii])] = nLength - 1 - ii;
+        }
+        if (1 == nLength)
+        {
+            m_scanner.AddChar(lpPattern[0]);
+        }
+    }
+
+    size_t GetLength() const
+    { return m_pattern.size(); }
+
+    /// Returns the index of the first occurrence in lpText[nFrom, nLength), or tNotFound
+    size_t Find(TCHARTYPE const* lpText, size_t nLength, size_t nFrom) const
+    {
+        size_t const nPattern = m_pattern.size();
+
+        if ((0 == nPattern) || (nFrom > nLength) || (nLength - nFrom < nPattern))
+        {
+            return tNotFound;
+        }
+        if (1 == nPattern)
+        {
+            size_t nFound = m_scanner.Find(lpText, nFrom, nLength);
+            return (nFound < nLength) ? nFound : tNotFound;
+        }
+
+        TCHARTYPE const* lpPattern = &m_pattern[0];
+        TCHARTYPE const chLast = lpPattern[nPattern - 1];
+
+        for (size_t ii = nFrom; ii + nPattern <= nLength; )
+        {
+            TCHARTYPE const ch = lpText[ii + nPattern - 1];
+
+            if (ch == chLast)
+            {
+                size_t jj = 0;
+                while ((jj + 1 < nPattern) && (lpText[ii + jj] == lpPattern[jj]))
+                {
+                    jj++;
+                }
+                if (jj + 1 == nPattern)
+                {
+                    return ii;
+                }
+            }
+            ii += m_skip[TableIndex(ch)];
+        }
+        return tNotFound;
+    }
+
+protected:
+    static size_t TableIndex(TCHARTYPE ch)
+    { return (size_t)ch & (tTableSize - 1); }
+};
+
+#endif // __SUBSTTEXTSEARCH_H__
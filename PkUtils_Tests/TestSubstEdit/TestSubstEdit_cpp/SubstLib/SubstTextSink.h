@@ -0,0 +1,302 @@
+/////////////////////////////////////////////////////////////////////////////
+// SubstTextSink.h : interface ISubstTextSink and its implementations,
+//                   and the class CSubstTextWriter
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef __SUBSTTEXTSINK_H__
+#define __SUBSTTEXTSINK_H__
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDE FILES
+/////////////////////////////////////////////////////////////////////////////
+#include <condition_variable>
+#include <mutex>
+#include <ostream>
+
+/////////////////////////////////////////////////////////////////////////////
+// TYPES
+/////////////////////////////////////////////////////////////////////////////
+
+/** ISubstTextSink is the destination of the text written piece by piece,
+    like the plain text exported by CSubstLogData::WritePlainText.
+*/
+interface ISubstTextSink
+{
+    /// Writes nLength characters of lpText; the text is not null-terminated
+    virtual void Write(LPCTSTR lpText, size_t nLength) = 0;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// CLASES
+/////////////////////////////////////////////////////////////////////////////
+
+/** CSubstStringSink appends the text to CString
+*/
+class CSubstStringSink : public ISubstTextSink
+{
+protected:
+    CString& m_strOutput;
+
+public:
+    CSubstStringSink(CString &strOutput) : m_strOutput(strOutput)
+    { }
+
+    virtual void Write(LPCTSTR lpText, size_t nLength)
+    { m_strOutput.Append(lpText, (int)nLength); }
+};
+
+/** CSubstFileSink writes the characters to CFile as they are, i.e. as binary data;
+    the file may be a pipe as well ( CFile attached to the handle of the pipe )
+*/
+class CSubstFileSink : public ISubstTextSink
+{
+protected:
+    CFile& m_file;
+
+public:
+    CSubstFileSink(CFile &file) : m_file(file)
+    { }
+
+    virtual void Write(LPCTSTR lpText, size_t nLength)
+    { m_file.Write(lpText, (UINT)(nLength * sizeof(TCHAR))); }
+};
+
+/** CSubstStdioFileSink writes the text by CStdioFile::WriteString,
+    i.e. with the translation of the text mode, if the file has been opened so.
+*/
+class CSubstStdioFileSink : public ISubstTextSink
+{
+protected:
+    CStdioFile& m_file;
+
+public:
+    CSubstStdioFileSink(CStdioFile &file) : m_file(file)
+    { }
+
+    virtual void Write(LPCTSTR lpText, size_t nLength)
+    {   // WriteString needs null-terminated text; the copy is of the chunk size only
+        CString strChunk(lpText, (int)nLength);
+        m_file.WriteString(strChunk);
+    }
+};
+
+/** CSubstStreamSink writes the text to the standard output stream
+*/
+class CSubstStreamSink : public ISubstTextSink
+{
+protected:
+    std::basic_ostream<TCHAR>& m_stream;
+
+public:
+    CSubstStreamSink(std::basic_ostream<TCHAR> &stream) : m_stream(stream)
+    { }
+
+    virtual void Write(LPCTSTR lpText, size_t nLength)
+    { m_stream.write(lpText, (std::streamsize)nLength); }
+};
+
+/** CSubstBufferSink writes the text to the caller's buffer of nCapacity characters,
+    keeping it null-terminated. The text not fitting in is dropped, but still counted,
+    so the caller can find the size of the buffer needed.
+*/
+class CSubstBufferSink : public ISubstTextSink
+{
+protected:
+    LPTSTR m_lpBuffer;
+    size_t m_nCapacity;
+    size_t m_nStored;
+    size_t m_nTotal;
+
+public:
+    CSubstBufferSink(LPTSTR lpBuffer, size_t nCapacity)
+        : m_lpBuffer(lpBuffer), m_nCapacity(nCapacity), m_nStored(0), m_nTotal(0)
+    {
+        if (0 < m_nCapacity)
+        {
+            m_lpBuffer[0] = _T('\0');
+        }
+    }
+
+    /// Returns the count of characters written, including those dropped
+    size_t GetTotalLength() const
+    { return m_nTotal; }
+    /// Returns the count of characters stored in the buffer
+    size_t GetStoredLength() const
+    { return m_nStored; }
+    BOOL IsTruncated() const
+    { return (m_nStored < m_nTotal); }
+
+    virtual void Write(LPCTSTR lpText, size_t nLength)
+    {
+        if (m_nStored + 1 < m_nCapacity)
+        {
+            size_t nStore = m_nCapacity - 1 - m_nStored;
+
+            if (nStore > nLength)
+            {
+                nStore = nLength;
+            }
+            memcpy(m_lpBuffer + m_nStored, lpText, nStore * sizeof(TCHAR));
+            m_nStored += nStore;
+            m_lpBuffer[m_nStored] = _T('\0');
+        }
+        m_nTotal += nLength;
+    }
+};
+
+/** CSubstRingBufferSink passes the text from the thread writing it ( e.g. rendering the template )
+    to the thread consuming it ( e.g. writing it to the disk or to the pipe ), through the ring buffer
+    provided by the caller. The consumer pulls the text by Read as soon as the first piece is written,
+    and the memory needed is just the buffer, however long the text is.
+    Write blocks while the buffer is full, and Read blocks while it is empty;
+    Read returns zero after the writer has called Close, and all the text has been read.
+    If the consumer gives up by Cancel, the text written after is dropped, so the writer finishes soon.
+*/
+class CSubstRingBufferSink : public ISubstTextSink
+{
+protected:
+    LPTSTR m_lpBuffer;
+    size_t m_nCapacity;
+    // the position of the first character not read yet, and the count of characters not read yet
+    size_t m_nHead;
+    size_t m_nCount;
+    bool   m_bClosed;
+    bool   m_bCancelled;
+    std::mutex              m_lock;
+    std::condition_variable m_cvChanged;
+
+public:
+    CSubstRingBufferSink(LPTSTR lpBuffer, size_t nCapacity)
+        : m_lpBuffer(lpBuffer), m_nCapacity(nCapacity), m_nHead(0), m_nCount(0),
+          m_bClosed(false), m_bCancelled(false)
+    {
+        ASSERT(0 < nCapacity);
+    }
+
+    virtual void Write(LPCTSTR lpText, size_t nLength)
+    {
+        std::unique_lock<std::mutex> lock(m_lock);
+
+        ASSERT(!m_bClosed);
+        while (0 < nLength)
+        {
+            m_cvChanged.wait(lock, [this] { return (m_nCount < m_nCapacity) || m_bCancelled; });
+            if (m_bCancelled)
+            {
+                break;
+            }
+
+            size_t nTail = (m_nHead + m_nCount) % m_nCapacity;
+            size_t nPart = m_nCapacity - m_nCount;
+
+            if (nPart > m_nCapacity - nTail)
+                nPart = m_nCapacity - nTail;
+            if (nPart > nLength)
+                nPart = nLength;
+            memcpy(m_lpBuffer + nTail, lpText, nPart * sizeof(TCHAR));
+            m_nCount += nPart;
+            lpText += nPart;
+            nLength -= nPart;
+            m_cvChanged.notify_all();
+        }
+    }
+
+    /// Called by the writer when all the text has been written
+    void Close()
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        m_bClosed = true;
+        m_cvChanged.notify_all();
+    }
+
+    /// Called by the consumer, when it does not want more text
+    void Cancel()
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        m_bCancelled = true;
+        m_cvChanged.notify_all();
+    }
+
+    /// Reads at most nMax characters of the text to lpOutput, waiting for some if there are none yet.
+    /// Returns the count of characters read, or zero if the text has ended ( or has been cancelled ).
+    size_t Read(LPTSTR lpOutput, size_t nMax)
+    {
+        std::unique_lock<std::mutex> lock(m_lock);
+        size_t nRead = 0;
+
+        m_cvChanged.wait(lock, [this] { return (0 < m_nCount) || m_bClosed || m_bCancelled; });
+        while ((0 < m_nCount) && (nRead < nMax) && !m_bCancelled)
+        {
+            size_t nPart = m_nCapacity - m_nHead;
+
+            if (nPart > m_nCount)
+                nPart = m_nCount;
+            if (nPart > nMax - nRead)
+                nPart = nMax - nRead;
+            memcpy(lpOutput + nRead, m_lpBuffer + m_nHead, nPart * sizeof(TCHAR));
+            m_nHead = (m_nHead + nPart) % m_nCapacity;
+            m_nCount -= nPart;
+            nRead += nPart;
+        }
+        m_cvChanged.notify_all();
+        return nRead;
+    }
+};
+
+/** CSubstTextWriter collects small pieces of the text in the chunk of fixed size,
+    passing the chunk to the sink whenever it is full.
+    Hence the sink is called rarely, and the memory needed does not depend on the text length.
+    Flush must be called at the end; it is not called by the destructor,
+    since writing to the sink may throw.
+*/
+class CSubstTextWriter
+{
+public:
+    enum { tChunkSize = 4096 };
+
+protected:
+    ISubstTextSink& m_sink;
+    TCHAR  m_chunk[tChunkSize];
+    size_t m_nUsed;
+
+public:
+    CSubstTextWriter(ISubstTextSink &sink) : m_sink(sink), m_nUsed(0)
+    { }
+
+    void Write(TCHAR ch)
+    {
+        if (tChunkSize == m_nUsed)
+        {
+            Flush();
+        }
+        m_chunk[m_nUsed++] = ch;
+    }
+
+    void Write(LPCTSTR lpText, size_t nLength)
+    {
+        if (tChunkSize - m_nUsed < nLength)
+        {
+            Flush();
+            if (tChunkSize <= nLength)
+            {   // too long to be collected; goes directly
+                m_sink.Write(lpText, nLength);
+                return;
+            }
+        }
+        memcpy(m_chunk + m_nUsed, lpText, nLength * sizeof(TCHAR));
+        m_nUsed += nLength;
+    }
+
+    void Flush()
+    {
+        if (0 < m_nUsed)
+        {
+            m_sink.Write(m_chunk, m_nUsed);
+            m_nUsed = 0;
+        }
+    }
+};
+
+#endif // __SUBSTTEXTSINK_H__
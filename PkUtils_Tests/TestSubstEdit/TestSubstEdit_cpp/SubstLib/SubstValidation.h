@@ -0,0 +1,116 @@
+/////////////////////////////////////////////////////////////////////////////
+// SubstValidation.h
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef __SUBSTVALIDATION_H__
+#define __SUBSTVALIDATION_H__
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDE FILES
+/////////////////////////////////////////////////////////////////////////////
+#include <atomic>
+
+/////////////////////////////////////////////////////////////////////////////
+// TYPES
+/////////////////////////////////////////////////////////////////////////////
+
+/** The level of consistency checks of substitution data,
+    performed ( by ASSERT ) after modifications of the data in debug builds.
+*/
+typedef enum tagSubstValidationLevel
+{
+    eValidateOff = 0,       // no checks
+    eValidateSampled,       // full check of every n-th modification only
+    eValidateIncremental,   // check of the modified region and neighbour fields; O(edit) per modification
+    eValidateFull,          // full check after every modification; O(n) per modification
+} tSubstValidationLevel;
+
+/////////////////////////////////////////////////////////////////////////////
+// MANIFESTED CONSTANTS & MACROS
+/////////////////////////////////////////////////////////////////////////////
+
+// Define SUBST_VALIDATION_DEFAULT in the project settings to change the initial validation level
+#ifndef SUBST_VALIDATION_DEFAULT
+#define SUBST_VALIDATION_DEFAULT  eValidateIncremental
+#endif
+
+/////////////////////////////////////////////////////////////////////////////
+// CLASES
+/////////////////////////////////////////////////////////////////////////////
+
+/** CSubstValidation keeps the current validation level, which can be changed at run time.
+    The level and the sample counter are atomic, as the data of different threads are checked at once.
+*/
+class CSubstValidation
+{
+public:
+    enum { tDefaultSampleRate = 64, tDefaultContext = 64 };
+
+    static tSubstValidationLevel GetLevel()
+    { return LevelRef().load(std::memory_order_relaxed); }
+    static void SetLevel(tSubstValidationLevel level)
+    { LevelRef().store(level, std::memory_order_relaxed); }
+
+    /// With eValidateSampled, the full check is performed on every nRate-th modification
+    static void SetSampleRate(unsigned nRate)
+    { SampleRateRef().store((0 < nRate) ? nRate : 1, std::memory_order_relaxed); }
+
+    /// The count of characters around the modified region, checked by eValidateIncremental
+    static size_t GetContext()
+    { return tDefaultContext; }
+
+    /// To be called once per modification of the data, before its checks; counts the samples
+    static void OnModified()
+    {
+        if (eValidateSampled == GetLevel())
+        {
+            unsigned nCount = SampleCountRef().fetch_add(1, std::memory_order_relaxed) + 1;
+
+            SampleDueRef().store(0 == (nCount % SampleRateRef().load(std::memory_order_relaxed)), std::memory_order_relaxed);
+        }
+    }
+
+    /** Returns true if the full check should be performed now.
+        With eValidateSampled, that is the case after every n-th modification counted by OnModified;
+        the checks themselves do not count, so any number of them may be performed per modification.
+    */
+    static bool IsFullCheckDue()
+    {
+        switch (GetLevel())
+        {
+        case eValidateFull:
+            return true;
+        case eValidateSampled:
+            return SampleDueRef().load(std::memory_order_relaxed);
+        default:
+            return false;
+        }
+    }
+
+    static bool IsIncremental()
+    { return (eValidateIncremental == GetLevel()); }
+
+protected:
+    static std::atomic<tSubstValidationLevel>& LevelRef()
+    {
+        static std::atomic<tSubstValidationLevel> s_level(SUBST_VALIDATION_DEFAULT);
+        return s_level;
+    }
+    static std::atomic<unsigned>& SampleRateRef()
+    {
+        static std::atomic<unsigned> s_nRate(tDefaultSampleRate);
+        return s_nRate;
+    }
+    static std::atomic<unsigned>& SampleCountRef()
+    {
+        static std::atomic<unsigned> s_nCount(0);
+        return s_nCount;
+    }
+    static std::atomic<bool>& SampleDueRef()
+    {
+        static std::atomic<bool> s_bDue(false);
+        return s_bDue;
+    }
+};
+
+#endif // __SUBSTVALIDATION_H__
@@ -0,0 +1,204 @@
+/////////////////////////////////////////////////////////////////////////////
+// SubstWorkPool.h : interface of the class CSubstWorkPool
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef __SUBSTWORKPOOL_H__
+#define __SUBSTWORKPOOL_H__
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDE FILES
+/////////////////////////////////////////////////////////////////////////////
+// Note: This header intentionally does not depend on MFC,
+// so it can be used ( and benchmarked ) outside of the MFC build as well.
+#include <stddef.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/////////////////////////////////////////////////////////////////////////////
+// CLASES
+/////////////////////////////////////////////////////////////////////////////
+
+/** CSubstWorkPool runs tasks on a fixed set of worker threads, with work stealing.
+    Each worker has its own queue; a task submitted by the worker goes to its own queue,
+    a task submitted from outside goes to the queues in turn.
+    The worker takes the newest task of its own queue first ( it is likely still in the cache ),
+    and when its queue is empty, it steals the oldest task of another worker.
+    Hence the load is balanced even if the tasks differ in duration a lot.
+    Tasks must not throw; the pool does not wait for anything but the tasks submitted
+    ( the caller synchronizes on the results itself ).
+*/
+class CSubstWorkPool
+{
+public:
+    typedef std::function<void()> tTask;
+
+protected:
+    // The queue of one worker
+    struct tWorkerQueue
+    {
+        std::mutex        m_lock;
+        std::deque<tTask> m_tasks;
+    };
+
+    std::vector<std::unique_ptr<tWorkerQueue> > m_queues;
+    std::vector<std::thread> m_threads;
+    // the count of tasks submitted and not taken yet; changed under m_lockIdle
+    size_t                   m_nPending;
+    bool                     m_bStop;
+    std::mutex               m_lockIdle;
+    std::condition_variable  m_cvIdle;
+    std::atomic<size_t>      m_nNextQueue;
+    std::atomic<size_t>      m_nExecuted;
+    std::atomic<size_t>      m_nStolen;
+
+public:
+    /// Starts nThreads workers; 0 means one per hardware thread
+    explicit CSubstWorkPool(size_t nThreads = 0)
+        : m_nPending(0), m_bStop(false), m_nNextQueue(0), m_nExecuted(0), m_nStolen(0)
+    {
+        if (0 == nThreads)
+        {
+            nThreads = std::thread::hardware_concurrency();
+        }
+        if (0 == nThreads)
+        {
+            nThreads = 1;
+        }
+        for (size_t ii = 0; ii < nThreads; ii++)
+        {
+            m_queues.push_back(std::unique_ptr<tWorkerQueue>(new tWorkerQueue()));
+        }
+        for (size_t ii = 0; ii < nThreads; ii++)
+        {
+            m_threads.push_back(std::thread(&CSubstWorkPool::WorkerMain, this, ii));
+        }
+    }
+
+    /// Finishes the tasks submitted, and stops the workers
+    ~CSubstWorkPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_lockIdle);
+            m_bStop = true;
+        }
+        m_cvIdle.notify_all();
+        for (size_t ii = 0; ii < m_threads.size(); ii++)
+        {
+            m_threads[ii].join();
+        }
+    }
+
+    size_t GetThreadCount() const
+    { return m_threads.size(); }
+    /// Returns the count of tasks executed so far
+    size_t GetExecutedCount() const
+    { return m_nExecuted.load(); }
+    /// Returns the count of tasks executed by another worker than the one they were queued for
+    size_t GetStolenCount() const
+    { return m_nStolen.load(); }
+
+    /// Returns the index of the worker calling, or -1 if not called by a worker of this pool
+    ptrdiff_t GetWorkerIndex() const
+    { return (this == CurrentPool()) ? (ptrdiff_t)CurrentWorker() : -1; }
+
+    /// Queues the task, to be run by any of the workers
+    void Submit(tTask task)
+    {
+        ptrdiff_t nWorker = GetWorkerIndex();
+        size_t nQueue = (0 <= nWorker) ? (size_t)nWorker : (m_nNextQueue++ % m_queues.size());
+
+        {
+            std::lock_guard<std::mutex> lock(m_queues[nQueue]->m_lock);
+            m_queues[nQueue]->m_tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_lockIdle);
+            m_nPending++;
+        }
+        m_cvIdle.notify_one();
+    }
+
+protected:
+    static CSubstWorkPool*& CurrentPool()
+    {
+        static thread_local CSubstWorkPool* s_lpPool = NULL;
+        return s_lpPool;
+    }
+    static size_t& CurrentWorker()
+    {
+        static thread_local size_t s_nWorker = 0;
+        return s_nWorker;
+    }
+
+    // Takes the newest task of the own queue, or steals the oldest one of another queue
+    bool TakeTask(size_t nWorker, tTask &task)
+    {
+        size_t const nQueues = m_queues.size();
+
+        for (size_t ii = 0; ii < nQueues; ii++)
+        {
+            size_t nQueue = (nWorker + ii) % nQueues;
+            tWorkerQueue &queue = *m_queues[nQueue];
+            std::lock_guard<std::mutex> lock(queue.m_lock);
+
+            if (!queue.m_tasks.empty())
+            {
+                if (0 == ii)
+                {
+                    task = std::move(queue.m_tasks.back());
+                    queue.m_tasks.pop_back();
+                }
+                else
+                {
+                    task = std::move(queue.m_tasks.front());
+                    queue.m_tasks.pop_front();
+                    m_nStolen++;
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void WorkerMain(size_t nWorker)
+    {
+        tTask task;
+
+        CurrentPool() = this;
+        CurrentWorker() = nWorker;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_lockIdle);
+
+                m_cvIdle.wait(lock, [this] { return (0 < m_nPending) || m_bStop; });
+                if (0 == m_nPending)
+                {   // stopping, and nothing is left
+                    break;
+                }
+                // one task is reserved now; since a task is queued before it is counted,
+                // the queues hold at least one task for each worker having reserved one
+                m_nPending--;
+            }
+            while (!TakeTask(nWorker, task))
+            {   // the queues scanned so far got the task only after they have been scanned
+                std::this_thread::yield();
+            }
+            task();
+            task = nullptr;
+            m_nExecuted++;
+        }
+    }
+
+private:
+    CSubstWorkPool(CSubstWorkPool const&);
+    CSubstWorkPool& operator = (CSubstWorkPool const&);
+};
+
+#endif // __SUBSTWORKPOOL_H__
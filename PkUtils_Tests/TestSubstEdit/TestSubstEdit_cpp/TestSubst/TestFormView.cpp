@@ -38,6 +38,7 @@ CTestFormView::CTestFormView()
     : CFormView(CTestFormView::IDD)
 {
     m_pOldFoc = NULL;
+    m_previewContext.SetProvider(this);
 }
 
 CTestFormView::~CTestFormView()
@@ -63,17 +64,25 @@ void CTestFormView::DoDataExchange(CDataExchange* pDX)
 
     CFormView::DoDataExchange(pDX);
     DDX_Control(pDX, IDC_EDIT_SAMPLE, m_editSample);
+    // The data are exchanged only if they differ; comparing them is cheap, 
+    // as their fingerprints differ unless the contents match
     if (pDX->m_bSaveAndValidate)
     {
-        pDoc->Data1st() = this->m_editSample.PhysData();
+        if (pDoc->Data1st() != this->m_editSample.PhysData())
+        {
+            pDoc->Data1st() = this->m_editSample.PhysData();
+        }
     }
     else
     {
-        this->m_editSample.PhysData() = pDoc->Data1st();
-        /* following coukd be called instead of previous assignment operator
-        this->m_editSample.PhysData().Assign(pDoc->Data1st());
-        */
-        this->m_editSample.InitializeText();
+        if (this->m_editSample.PhysData() != pDoc->Data1st())
+        {
+            this->m_editSample.PhysData() = pDoc->Data1st();
+            /* following coukd be called instead of previous assignment operator
+            this->m_editSample.PhysData().Assign(pDoc->Data1st());
+            */
+            this->m_editSample.InitializeText();
+        }
         this->UpdatePreview();
     }
     DDX_Control(pDX, IDC_EDIT_PREVIEW, m_editPreview);
@@ -113,7 +122,8 @@ void CTestFormView::UpdatePreview()
     }
 }
 
-static CString CALLBACK fieldPreviewVal(SubstDescr<tagMyFields> const* lpDesc)
+// implements ISubstValueProvider
+CString CTestFormView::GetFieldText(SubstDescr<tagMyFields> const* lpDesc)
 {
     COleDateTime now = COleDateTime::GetCurrentTime();
     CString strNewPart = lpDesc->lpTxt;
@@ -139,10 +149,27 @@ static CString CALLBACK fieldPreviewVal(SubstDescr<tagMyFields> const* lpDesc)
     return strNewPart;
 }
 
-CString CTestFormView::GetPreviewText(CSubstLogData<tagMyFields> const &logData) const
+ESubstValueKind CTestFormView::GetValueKind(SubstDescr<tagMyFields> const* lpDesc) const
+{
+    switch (lpDesc->valId)
+    {
+        case IdField_Year:
+        case IdField_Month:
+        case IdField_DayoftheWeek:
+            return eValueVolatile;
+    }
+    return eValuePure;
+}
+
+DWORD CTestFormView::GetTimeToLive(SubstDescr<tagMyFields> const* /*lpDesc*/) const
+{   // the date shown by the preview may be late by a second at most
+    return 1000;
+}
+
+CString CTestFormView::GetPreviewText(CSubstLogData<tagMyFields> const &logData)
 {
     int nDex;
-    CString strTmp = CSubstLogData<tagMyFields>::LogStrToPhysStr(logData, fieldPreviewVal);
+    CString strTmp = CSubstLogData<tagMyFields>::LogStrToPhysStr(logData, m_previewContext, m_previewCache);
     if (0 <= (nDex = strTmp.Find('\n')))
         strTmp = strTmp.Left(nDex);
     if (0 <= (nDex = strTmp.Find('\r')))
@@ -150,7 +177,7 @@ CString CTestFormView::GetPreviewText(CSubstLogData<tagMyFields> const &logData)
     return strTmp;
 }
 
-CString CTestFormView::GetPreviewText() const
+CString CTestFormView::GetPreviewText()
 {
     return GetPreviewText(this->m_editSample.RFPhysDataC());
 }
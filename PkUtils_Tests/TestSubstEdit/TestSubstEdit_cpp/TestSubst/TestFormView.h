@@ -5,7 +5,8 @@
 
 class CTestSubstEditDoc; // forward decl.
 
-class CTestFormView : public CFormView, public ISubstDescrProvider<tagMyFields>
+class CTestFormView : public CFormView, public ISubstDescrProvider<tagMyFields>, 
+    public ISubstValueProvider<tagMyFields>
 {
     DECLARE_DYNCREATE(CTestFormView)
 
@@ -13,6 +14,10 @@ private:
     CWnd *m_pOldFoc;
     CSubstEdit<tagMyFields> m_editSample;
     CEdit m_editPreview;
+    // keeps the field values of the preview between renders
+    CSubstRenderContext<tagMyFields> m_previewContext;
+    // keeps the preview texts rendered lately, so that an unchanged preview is not composed again
+    CSubstRenderCache m_previewCache;
 
 protected:
     CTestFormView();           // protected constructor used by dynamic creation
@@ -28,14 +33,18 @@ public:
 #endif
     // implementation of ISubstDescrProvider
     virtual SubstDescr<tagMyFields> const* GetSubstDescr() const;
+    // implementation of ISubstValueProvider
+    virtual CString GetFieldText(SubstDescr<tagMyFields> const* lpDescr);
+    virtual ESubstValueKind GetValueKind(SubstDescr<tagMyFields> const* lpDescr) const;
+    virtual DWORD GetTimeToLive(SubstDescr<tagMyFields> const* lpDescr) const;
     CTestSubstEditDoc* GetSubstDocument();
 
 protected:
     virtual void DoDataExchange(CDataExchange* pDX);    // DDX/DDV support
     void RestoreFocus();
     void UpdatePreview();
-    CString GetPreviewText(CSubstLogData<tagMyFields> const &logData) const;
-    CString GetPreviewText() const;
+    CString GetPreviewText(CSubstLogData<tagMyFields> const &logData);
+    CString GetPreviewText();
 
 	//{{AFX_MSG(CTestFormView)
     afx_msg void OnFileSave();
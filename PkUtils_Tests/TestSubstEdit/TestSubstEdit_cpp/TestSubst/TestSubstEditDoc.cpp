@@ -24,6 +24,11 @@ SubstDescr<tagMyFields> const CTestSubstEditDoc::m_myDesctpts[] =
     { IdField_NONE,			NULL     },
 };
 
+#ifdef SUBST_HAS_CONST_MAP
+// the lookup table of m_myDesctpts, used by m_data1st
+static SubstConstMap<tagMyFields, IdField_Dog> const s_myTable(CTestSubstEditDoc::m_myDesctpts);
+#endif // SUBST_HAS_CONST_MAP
+
 IMPLEMENT_DYNCREATE(CTestSubstEditDoc, CDocument)
 
 BEGIN_MESSAGE_MAP(CTestSubstEditDoc, CDocument)
@@ -38,7 +43,11 @@ END_MESSAGE_MAP()
 
 CTestSubstEditDoc::CTestSubstEditDoc()
 {
+#ifdef SUBST_HAS_CONST_MAP
+    m_data1st.AssignSubstMap(s_myTable);
+#else
     m_data1st.AssignSubstMap((SubstDescr<tagMyFields> const*)m_myDesctpts);
+#endif // SUBST_HAS_CONST_MAP
     m_data2nd.AssignSubstMap(m_myDesctpts);
 }
 
@@ -223,9 +232,9 @@ BOOL CTestSubstEditDoc::SerializeTextFile(BOOL bOpening, CStdioFile* pFile)
         AssignPlainText(strContents);
     }
     else
-    {
-        strContents = GetPlainText();
-        pFile->WriteString(strContents);
+    {   // the text is written in chunks, without creating the whole plain text
+        CSubstStdioFileSink sink(*pFile);
+        m_data1st.WritePlainText(sink);
     }
     return bRes; 
 }